@@ -33,14 +33,17 @@ void setup(void)
 
     motors.begin();
 
-    delay(1000);
-
     val = 0;
     dir = +1;
 }
 
 void loop(void)
 {
+    // Wait for ESCs to arm
+    if (!motors.ready()) {
+        return;
+    }
+
     motors.writeMotor(0, val);
 
     val += dir * .001;
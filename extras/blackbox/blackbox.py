@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+'''
+blackbox.py : Loads blackbox logs exported by the decode tool
+
+Usage as a script:  blackbox.py test_columns | test.csv
+
+From Python:
+
+    import blackbox
+    log = blackbox.load('test_columns')
+    plot(log['time'], log['angularVel.x'])
+
+Requires: numpy
+
+Copyright (C) Simon D. Levy 2020
+
+This file is part of Hackflight.
+
+Hackflight is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as 
+published by the Free Software Foundation, either version 3 of the 
+License, or (at your option) any later version.
+This code is distributed in the hope that it will be useful,     
+but WITHOUT ANY WARRANTY without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License 
+along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+'''
+
+import os
+import numpy as np
+
+def load(path):
+    '''
+    Returns a dictionary of numpy arrays, one per field, from a column directory or CSV file.
+    Columns are memory-mapped, so even multi-hour logs load instantly.
+    '''
+
+    if os.path.isdir(path):
+
+        with open(os.path.join(path, 'fields.txt')) as f:
+            names = f.read().split()
+
+        return {name: np.memmap(os.path.join(path, name + '.f64'), dtype='<f8', mode='r') for name in names}
+
+    data = np.genfromtxt(path, delimiter=',', names=True, deletechars='')
+
+    return {name: data[name] for name in data.dtype.names}
+
+if __name__ == '__main__':
+
+    from sys import argv
+
+    if len(argv) < 2:
+        print('Usage: %s COLUMN_DIRECTORY | CSV_FILE' % argv[0])
+        exit(1)
+
+    log = load(argv[1])
+
+    time = log['time']
+
+    print('%d frames over %.1f seconds' % (len(time), time[-1] - time[0] if len(time) else 0))
+
+    for name, values in log.items():
+        print('%-16s min %+10.4f  max %+10.4f' % (name, values.min(), values.max()))
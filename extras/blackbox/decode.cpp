@@ -0,0 +1,631 @@
+/*
+   Blackbox log decoder
+
+   Memory-maps a log written by the flight controller's Blackbox (see
+   src/blackbox.hpp), decodes its blocks in parallel, and exports the result
+   as CSV and/or as binary columns: one file of little-endian doubles per
+   field, plus fields.txt listing the field names in order.  Corrupt blocks
+   are skipped and counted.
+
+   Usage: decode [-j threads] [-c out.csv] [-b outdir] log.hfbb
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as 
+   published by the Free Software Foundation, either version 3 of the 
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,     
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License 
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t MAGIC   = 0x42424648; // "HFBB"
+static const uint16_t VERSION = 1;
+
+static const uint8_t FIELD_UNSIGNED = 0x01;
+
+static const uint8_t BLOCK_HEADER_SIZE = 8;
+
+typedef struct {
+
+    std::string name;
+    uint8_t     flags;
+    double      scale;
+
+    // Digits after the decimal point when scale is a power of ten, else -1
+    int         decimals;
+
+} field_t;
+
+typedef struct {
+
+    size_t   offset;  // of payload
+    uint16_t payloadSize;
+    uint16_t frameCount;
+    uint16_t checksum;
+    size_t   firstRow;
+    bool     valid;
+
+} block_t;
+
+class Log {
+
+    private:
+
+        const uint8_t * _data = NULL;
+        size_t _size = 0;
+
+        size_t _headerSize = 0;
+
+        static uint16_t get16(const uint8_t * p)
+        {
+            return p[0] | (p[1] << 8);
+        }
+
+        static uint16_t fletcher16(const uint8_t * data, uint16_t count)
+        {
+            uint32_t a = 0, b = 0;
+
+            for (uint16_t k=0; k<count; ++k) {
+                a = (a + data[k]) % 255;
+                b = (b + a) % 255;
+            }
+
+            return (b << 8) | a;
+        }
+
+        bool readHeader(void)
+        {
+            if (_size < 9 || *(const uint32_t *)_data != MAGIC || get16(&_data[4]) != VERSION) {
+                return false;
+            }
+
+            _headerSize = 8 + get16(&_data[6]);
+
+            if (_headerSize > _size) {
+                return false;
+            }
+
+            size_t p = 9;
+
+            for (uint8_t k=0; k<_data[8]; ++k) {
+
+                const uint8_t * end = (const uint8_t *)memchr(&_data[p], 0, _headerSize - p);
+
+                if (!end || (size_t)(end - _data) + 6 > _headerSize) {
+                    return false;
+                }
+
+                field_t field;
+                field.name = (const char *)&_data[p];
+                field.flags = end[1];
+
+                float scale = 0;
+                memcpy(&scale, &end[2], sizeof(float));
+                field.scale = scale;
+
+                double digits = log10(field.scale);
+                field.decimals = (digits >= 0 && digits < 10 && fabs(digits - round(digits)) < 1e-6) ? (int)round(digits) : -1;
+
+                fields.push_back(field);
+
+                p = (end - _data) + 6;
+            }
+
+            return true;
+        }
+
+        bool plausibleBlock(size_t p)
+        {
+            return p + BLOCK_HEADER_SIZE <= _size && _data[p] == 'H' && _data[p+1] == 'B' &&
+                p + BLOCK_HEADER_SIZE + get16(&_data[p+2]) <= _size;
+        }
+
+        // Blocks are found by hopping from header to header; after corruption we search for the next block whose checksum is good
+        void indexBlocks(void)
+        {
+            size_t p = _headerSize;
+
+            size_t rows = 0;
+
+            while (p + BLOCK_HEADER_SIZE <= _size) {
+
+                if (!plausibleBlock(p)) {
+
+                    skippedBytes++;
+                    p++;
+
+                    while (p + BLOCK_HEADER_SIZE <= _size && !(plausibleBlock(p) && 
+                                fletcher16(&_data[p+BLOCK_HEADER_SIZE], get16(&_data[p+2])) == get16(&_data[p+6]))) {
+                        skippedBytes++;
+                        p++;
+                    }
+
+                    continue;
+                }
+
+                block_t block = {p + BLOCK_HEADER_SIZE, get16(&_data[p+2]), get16(&_data[p+4]), get16(&_data[p+6]), rows, true};
+
+                blocks.push_back(block);
+
+                rows += block.frameCount;
+
+                p += BLOCK_HEADER_SIZE + block.payloadSize;
+            }
+
+            // Partly-written block at the end of the log
+            skippedBytes += _size - p;
+
+            rowCount = rows;
+        }
+
+        void decodeBlock(block_t & block)
+        {
+            const uint8_t * payload = &_data[block.offset];
+
+            if (fletcher16(payload, block.payloadSize) != block.checksum) {
+                block.valid = false;
+                return;
+            }
+
+            size_t fieldCount = fields.size();
+
+            std::vector<uint32_t> previous(fieldCount);
+
+            size_t q = 0;
+
+            for (uint16_t frame=0; frame<block.frameCount; ++frame) {
+
+                for (size_t k=0; k<fieldCount; ++k) {
+
+                    uint32_t value = 0;
+                    uint8_t shift = 0;
+
+                    while (true) {
+
+                        if (q >= block.payloadSize || shift > 28) {
+                            block.valid = false;
+                            return;
+                        }
+
+                        uint8_t c = payload[q++];
+
+                        value |= (uint32_t)(c & 0x7F) << shift;
+                        shift += 7;
+
+                        if (c < 0x80) {
+                            break;
+                        }
+                    }
+
+                    uint32_t delta = (value >> 1) ^ -(value & 1);
+
+                    uint32_t quantized = frame == 0 ? delta : previous[k] + delta;
+
+                    previous[k] = quantized;
+
+                    columns[k][block.firstRow + frame] = (fields[k].flags & FIELD_UNSIGNED) ? 
+                        (int64_t)quantized : (int64_t)(int32_t)quantized;
+                }
+            }
+
+            block.valid = q == block.payloadSize;
+        }
+
+        // Unsigned counters (time) wrap around; carry the wraps across rows in order
+        void unwrap(void)
+        {
+            for (size_t k=0; k<fields.size(); ++k) {
+
+                if (!(fields[k].flags & FIELD_UNSIGNED)) {
+                    continue;
+                }
+
+                int64_t offset = 0;
+                int64_t previous = -1;
+
+                for (size_t b=0; b<blocks.size(); ++b) {
+
+                    if (!blocks[b].valid) {
+                        continue;
+                    }
+
+                    for (size_t row=blocks[b].firstRow; row<blocks[b].firstRow + blocks[b].frameCount; ++row) {
+
+                        int64_t value = columns[k][row];
+
+                        if (value < previous) {
+                            offset += 1LL << 32;
+                        }
+
+                        previous = value;
+
+                        columns[k][row] = value + offset;
+                    }
+                }
+            }
+        }
+
+        // Split the blocks into runs of roughly equal size, one per thread
+        std::vector<size_t> partition(unsigned threadCount)
+        {
+            std::vector<size_t> bounds(1, 0);
+
+            size_t total = _size - _headerSize;
+            size_t bytes = 0;
+
+            for (size_t b=0; b<blocks.size(); ++b) {
+
+                bytes += blocks[b].payloadSize + BLOCK_HEADER_SIZE;
+
+                if (bytes * threadCount >= total * bounds.size() && bounds.size() < threadCount) {
+                    bounds.push_back(b+1);
+                }
+            }
+
+            bounds.push_back(blocks.size());
+
+            return bounds;
+        }
+
+        static char * formatValue(char * out, int64_t value, const field_t & field)
+        {
+            if (field.decimals < 0) {
+                return out + sprintf(out, "%.9g", value / field.scale);
+            }
+
+            if (value < 0) {
+                *out++ = '-';
+                value = -value;
+            }
+
+            int64_t divisor = 1;
+            for (int k=0; k<field.decimals; ++k) {
+                divisor *= 10;
+            }
+
+            out += sprintf(out, "%lld", (long long)(value / divisor));
+
+            if (field.decimals > 0) {
+                *out++ = '.';
+                int64_t fraction = value % divisor;
+                for (int k=field.decimals-1; k>=0; --k) {
+                    out[k] = '0' + fraction % 10;
+                    fraction /= 10;
+                }
+                out += field.decimals;
+            }
+
+            return out;
+        }
+
+        void formatRows(size_t firstBlock, size_t lastBlock, std::string & text)
+        {
+            char line[4096];
+
+            for (size_t b=firstBlock; b<lastBlock; ++b) {
+
+                if (!blocks[b].valid) {
+                    continue;
+                }
+
+                for (size_t row=blocks[b].firstRow; row<blocks[b].firstRow + blocks[b].frameCount; ++row) {
+
+                    char * p = line;
+
+                    for (size_t k=0; k<fields.size(); ++k) {
+                        if (k > 0) {
+                            *p++ = ',';
+                        }
+                        p = formatValue(p, columns[k][row], fields[k]);
+                    }
+
+                    *p++ = '\n';
+
+                    text.append(line, p - line);
+                }
+            }
+        }
+
+    public:
+
+        std::vector<field_t> fields;
+        std::vector<block_t> blocks;
+
+        // Quantized values, one vector per field
+        std::vector<std::vector<int64_t>> columns;
+
+        size_t rowCount = 0;
+        size_t skippedBytes = 0;
+
+        ~Log(void)
+        {
+            if (_data) {
+                munmap((void *)_data, _size);
+            }
+        }
+
+        bool open(const char * path)
+        {
+            int fd = ::open(path, O_RDONLY);
+
+            if (fd < 0) {
+                return false;
+            }
+
+            struct stat st;
+            fstat(fd, &st);
+            _size = st.st_size;
+
+            void * data = _size ? mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+
+            close(fd);
+
+            if (data == MAP_FAILED) {
+                return false;
+            }
+
+            _data = (const uint8_t *)data;
+
+            madvise(data, _size, MADV_SEQUENTIAL);
+
+            return readHeader();
+        }
+
+        void decode(unsigned threadCount)
+        {
+            indexBlocks();
+
+            columns.assign(fields.size(), std::vector<int64_t>(rowCount));
+
+            std::vector<size_t> bounds = partition(threadCount);
+
+            std::vector<std::thread> threads;
+
+            for (size_t t=0; t+1<bounds.size(); ++t) {
+                threads.push_back(std::thread([this, &bounds, t]() {
+                    for (size_t b=bounds[t]; b<bounds[t+1]; ++b) {
+                        decodeBlock(blocks[b]);
+                    }
+                }));
+            }
+
+            for (auto & thread : threads) {
+                thread.join();
+            }
+
+            unwrap();
+        }
+
+        size_t invalidBlockCount(void)
+        {
+            size_t count = 0;
+
+            for (auto & block : blocks) {
+                count += !block.valid;
+            }
+
+            return count;
+        }
+
+        size_t validRowCount(void)
+        {
+            size_t count = 0;
+
+            for (auto & block : blocks) {
+                count += block.valid ? block.frameCount : 0;
+            }
+
+            return count;
+        }
+
+        bool writeCsv(const char * path, unsigned threadCount)
+        {
+            FILE * fp = fopen(path, "w");
+
+            if (!fp) {
+                return false;
+            }
+
+            for (size_t k=0; k<fields.size(); ++k) {
+                fprintf(fp, "%s%s", k ? "," : "", fields[k].name.c_str());
+            }
+            fprintf(fp, "\n");
+
+            std::vector<size_t> bounds = partition(threadCount);
+
+            std::vector<std::string> texts(bounds.size()-1);
+
+            std::vector<std::thread> threads;
+
+            for (size_t t=0; t+1<bounds.size(); ++t) {
+                threads.push_back(std::thread([this, &bounds, &texts, t]() {
+                    formatRows(bounds[t], bounds[t+1], texts[t]);
+                }));
+            }
+
+            for (size_t t=0; t<threads.size(); ++t) {
+                threads[t].join();
+                fwrite(texts[t].data(), 1, texts[t].size(), fp);
+                std::string().swap(texts[t]);
+            }
+
+            return fclose(fp) == 0;
+        }
+
+        bool writeColumns(const char * directory, unsigned threadCount)
+        {
+            mkdir(directory, 0755);
+
+            std::string listPath = std::string(directory) + "/fields.txt";
+
+            FILE * list = fopen(listPath.c_str(), "w");
+
+            if (!list) {
+                return false;
+            }
+
+            for (auto & field : fields) {
+                fprintf(list, "%s\n", field.name.c_str());
+            }
+
+            fclose(list);
+
+            // One byte per field: vector<bool> packs fields into shared words, which the threads would race on
+            std::vector<uint8_t> ok(fields.size(), true);
+
+            std::vector<std::thread> threads;
+
+            for (unsigned t=0; t<threadCount; ++t) {
+
+                threads.push_back(std::thread([this, directory, threadCount, t, &ok]() {
+
+                    std::vector<double> values;
+
+                    for (size_t k=t; k<fields.size(); k+=threadCount) {
+
+                        values.clear();
+
+                        for (auto & block : blocks) {
+                            if (block.valid) {
+                                for (size_t row=block.firstRow; row<block.firstRow+block.frameCount; ++row) {
+                                    values.push_back(columns[k][row] / fields[k].scale);
+                                }
+                            }
+                        }
+
+                        std::string path = std::string(directory) + "/" + fields[k].name + ".f64";
+
+                        FILE * fp = fopen(path.c_str(), "wb");
+
+                        ok[k] = fp && fwrite(values.data(), sizeof(double), values.size(), fp) == values.size();
+
+                        if (fp) {
+                            fclose(fp);
+                        }
+                    }
+                }));
+            }
+
+            for (auto & thread : threads) {
+                thread.join();
+            }
+
+            for (size_t k=0; k<fields.size(); ++k) {
+                if (!ok[k]) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+}; // class Log
+
+static void usage(const char * name)
+{
+    fprintf(stderr, "Usage: %s [-j threads] [-c out.csv] [-b outdir] log.hfbb\n", name);
+    exit(1);
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned threadCount = std::thread::hardware_concurrency();
+    const char * csvPath = NULL;
+    const char * columnDirectory = NULL;
+
+    int c = 0;
+
+    while ((c = getopt(argc, argv, "j:c:b:")) != -1) {
+        switch (c) {
+            case 'j':
+                threadCount = atoi(optarg);
+                break;
+            case 'c':
+                csvPath = optarg;
+                break;
+            case 'b':
+                columnDirectory = optarg;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+    }
+
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+
+    Log log;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (!log.open(argv[optind])) {
+        fprintf(stderr, "%s: not a blackbox log (version %d)\n", argv[optind], VERSION);
+        return 1;
+    }
+
+    log.decode(threadCount);
+
+    fprintf(stderr, "%zu fields, %zu rows in %zu blocks decoded in %.3f sec with %u threads\n", 
+            log.fields.size(), log.validRowCount(), log.blocks.size(), seconds(start), threadCount);
+
+    if (log.invalidBlockCount() || log.skippedBytes) {
+        fprintf(stderr, "skipped %zu corrupt blocks and %zu stray bytes\n", log.invalidBlockCount(), log.skippedBytes);
+    }
+
+    if (csvPath) {
+
+        start = std::chrono::steady_clock::now();
+
+        if (!log.writeCsv(csvPath, threadCount)) {
+            fprintf(stderr, "Failed to write %s\n", csvPath);
+            return 1;
+        }
+
+        fprintf(stderr, "wrote %s in %.3f sec\n", csvPath, seconds(start));
+    }
+
+    if (columnDirectory) {
+
+        start = std::chrono::steady_clock::now();
+
+        if (!log.writeColumns(columnDirectory, threadCount)) {
+            fprintf(stderr, "Failed to write columns to %s\n", columnDirectory);
+            return 1;
+        }
+
+        fprintf(stderr, "wrote columns to %s in %.3f sec\n", columnDirectory, seconds(start));
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+   Writes a synthetic blackbox log, for trying out the decoder
+
+   Usage: simulate [-f] log.hfbb [minutes]
+
+   With -f, the store refuses some writes and takes only part of others, as a
+   busy SD card might; the log should come out the same.
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as 
+   published by the Free Software Foundation, either version 3 of the 
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,     
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License 
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "blackbox.hpp"
+#include "blackboxstores/file.hpp"
+
+static const float PID_FREQ = 300;
+
+// The microsecond clock starts a minute before it wraps around
+static const uint32_t START_USEC = 0xFFFFFFFF - 60000000;
+
+// When flaky, refuses every fifth write and takes half of every third
+class SimulatedStore : public hf::FileBlackboxStore {
+
+    private:
+
+        bool _flaky = false;
+
+        uint32_t _writeCount = 0;
+
+    protected:
+
+        virtual uint16_t write(const uint8_t * data, uint16_t count) override
+        {
+            if (!_flaky) {
+                return hf::FileBlackboxStore::write(data, count);
+            }
+
+            _writeCount++;
+
+            if (_writeCount % 5 == 0) {
+                return 0;
+            }
+
+            return hf::FileBlackboxStore::write(data, _writeCount % 3 == 0 ? count / 2 : count);
+        }
+
+    public:
+
+        SimulatedStore(const char * path, bool flaky) : hf::FileBlackboxStore(path), _flaky(flaky) { }
+};
+
+// Stands in for the PID task
+class SimulatedBlackbox : public hf::Blackbox {
+
+    private:
+
+        float _motors[4] = {};
+
+    public:
+
+        SimulatedBlackbox(hf::BlackboxStore * store)
+            : Blackbox(store)
+        {
+            useMotors(_motors, 4);
+        }
+
+        void tick(uint32_t k)
+        {
+            float time = k / PID_FREQ;
+
+            hf::state_t state = {};
+            hf::demands_t rcDemands = {};
+            hf::demands_t pidDemands = {};
+
+            state.armed = true;
+
+            float yaw = 0.1f * time;
+            state.quaternion[0] = cosf(yaw/2);
+            state.quaternion[3] = sinf(yaw/2);
+
+            for (uint8_t axis=0; axis<3; ++axis) {
+                state.angularVel[axis] = 0.2f * sinf(0.5f * time + axis) + 0.01f * (rand() % 100 - 50) / 50;
+                state.bodyAccel[axis] = (axis == 2 ? 1 : 0) + 0.02f * (rand() % 100 - 50) / 50;
+            }
+
+            state.location[2] = 1 + 0.5f * sinf(0.05f * time);
+
+            rcDemands.throttle = 0.1f * sinf(0.05f * time);
+            rcDemands.yaw = 0.1f;
+
+            pidDemands.throttle = rcDemands.throttle;
+            pidDemands.roll = 0.5f * state.angularVel[0];
+            pidDemands.pitch = 0.5f * state.angularVel[1];
+            pidDemands.yaw = 0.5f * state.angularVel[2];
+
+            for (uint8_t m=0; m<4; ++m) {
+                _motors[m] = 0.5f + 0.5f * pidDemands.throttle + 0.1f * (m & 1 ? pidDemands.roll : -pidDemands.roll);
+            }
+
+            record(START_USEC + (uint32_t)((uint64_t)k * 1000000 / (uint32_t)PID_FREQ), &state, rcDemands, pidDemands);
+
+            drain();
+        }
+
+}; // class SimulatedBlackbox
+
+int main(int argc, char ** argv)
+{
+    bool flaky = argc > 1 && !strcmp(argv[1], "-f");
+
+    if (flaky) {
+        argc--;
+        argv++;
+    }
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s [-f] log.hfbb [minutes]\n", argv[0]);
+        return 1;
+    }
+
+    float minutes = argc > 2 ? atof(argv[2]) : 60;
+
+    SimulatedStore store(argv[1], flaky);
+
+    SimulatedBlackbox * blackbox = new SimulatedBlackbox(&store);
+
+    uint32_t frameCount = (uint32_t)(minutes * 60 * PID_FREQ);
+
+    for (uint32_t k=0; k<frameCount; ++k) {
+        blackbox->tick(k);
+    }
+
+    blackbox->flush();
+
+    printf("%u frames, %u bytes, %u dropped frames, %u failed writes\n", blackbox->getFrameCount(),
+            blackbox->getBytesWritten(), blackbox->getDroppedFrameCount(), blackbox->getFailedWriteCount());
+
+    bool ok = blackbox->getDroppedFrameCount() == 0;
+
+    delete blackbox;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+/*
+   Host test for IMU polling traffic
+
+   Runs the USFS and MPU9250 polling code against a MockBus and checks the
+   number of bus transactions and bytes transferred when no new data is
+   ready (a miss) and when it is (an event), along with the decoded values,
+   and that a failed burst read isn't reported as new data.  With a
+   data-ready pin, checks that the bus is left alone until an interrupt, and
+   that the interrupt stays pending until a read succeeds.
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "buses/mock.hpp"
+#include "imus/usfs.hpp"
+#include "imus/softquats/mpu9250.hpp"
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+// Exposes the MPU9250 polling methods
+class TestMPU9250 : public hf::MPU9250SoftwareQuaternionIMU {
+
+    public:
+
+        bool ready(void)
+        {
+            return imuReady();
+        }
+
+        void readAccelGyro(float & ax, float & ay, float & az, float & gx, float & gy, float & gz)
+        {
+            imuReadAccelGyro(ax, ay, az, gx, gy, gz);
+        }
+};
+
+// Fails multi-byte reads while failing is set, as after a bus error partway through a burst
+class FlakyBus : public hf::MockBus {
+
+    protected:
+
+        virtual bool readRegisters(uint8_t address, uint8_t reg, uint8_t count, uint8_t * dst) override
+        {
+            return (failing && count > 1) ? false : hf::MockBus::readRegisters(address, reg, count, dst);
+        }
+
+    public:
+
+        bool failing = false;
+
+        FlakyBus(uint8_t address) : hf::MockBus(address) { }
+};
+
+static bool _ok = true;
+
+static void check(const char * name, bool result)
+{
+    printf("%-48s %s\n", name, result ? "ok" : "FAILED");
+
+    _ok = _ok && result;
+}
+
+static bool traffic(hf::MockBus & bus, uint32_t transactions, uint32_t bytes)
+{
+    bool ok = bus.getTransactionCount() == transactions && bus.getByteCount() == bytes;
+
+    if (!ok) {
+        printf("    expected %u transactions / %u bytes, got %u / %u\n",
+                transactions, bytes, bus.getTransactionCount(), bus.getByteCount());
+    }
+
+    bus.resetCounts();
+
+    return ok;
+}
+
+static bool near(float a, float b)
+{
+    return fabsf(a - b) < 1e-4f;
+}
+
+static void testUSFS(void)
+{
+    // EM7180 SENtral registers
+    static const uint8_t REG_QX           = 0x00;
+    static const uint8_t REG_GX           = 0x22;
+    static const uint8_t REG_EVENT_STATUS = 0x35;
+
+    FlakyBus bus(0x28);
+    hf::USFS usfs;
+    usfs.useBus(&bus);
+
+    // Little-endian floats and int16s
+    float q[4] = {0.1f, 0.2f, 0.3f, 0.9f};
+    memcpy(&bus.registers[REG_QX], q, sizeof(q));
+    int16_t g[3] = {100, -200, 300};
+    memcpy(&bus.registers[REG_GX], g, sizeof(g));
+
+    float gx = 0, gy = 0, gz = 0, qw = 0, qx = 0, qy = 0, qz = 0;
+
+    // Miss: event status only
+    bus.registers[REG_EVENT_STATUS] = 0x00;
+    check("USFS miss returns no gyro", !usfs.getGyrometer(gx, gy, gz));
+    check("USFS miss: 1 transaction, 1 byte", traffic(bus, 1, 1));
+
+    // Gyro event: status, then the gyro registers
+    bus.registers[REG_EVENT_STATUS] = 0x20;
+    check("USFS gyro event returns gyro", usfs.getGyrometer(gx, gy, gz));
+    check("USFS gyro event: 2 transactions, 7 bytes", traffic(bus, 2, 7));
+    check("USFS gyro decoded", near(gx, radians(100*0.153f)) && near(gy, radians(-200*0.153f)) &&
+            near(gz, radians(300*0.153f)));
+    check("USFS gyro event returns no quaternion", !usfs.getQuaternion(qw, qx, qy, qz, 0));
+
+    // Gyro and quaternion event: status, then one burst through the gyro registers
+    bus.registers[REG_EVENT_STATUS] = 0x24;
+    check("USFS quaternion event returns gyro", usfs.getGyrometer(gx, gy, gz));
+    check("USFS quaternion event: 2 transactions, 41 bytes", traffic(bus, 2, 1 + REG_GX + 6));
+    check("USFS quaternion event returns quaternion", usfs.getQuaternion(qw, qx, qy, qz, 0));
+    check("USFS quaternion decoded", near(qx, 0.1f) && near(qy, 0.2f) && near(qz, 0.3f) && near(qw, 0.9f));
+    check("USFS quaternion reported once", !usfs.getQuaternion(qw, qx, qy, qz, 0));
+    check("USFS getQuaternion() uses no bus", traffic(bus, 0, 0));
+
+    // Failed burst: the previous sample's bytes must not come back as new readings
+    bus.failing = true;
+    check("USFS failed burst returns no gyro", !usfs.getGyrometer(gx, gy, gz));
+    check("USFS failed burst returns no quaternion", !usfs.getQuaternion(qw, qx, qy, qz, 0));
+    bus.failing = false;
+    bus.resetCounts();
+
+    // Data-ready pin: no traffic without an interrupt, and a failed read leaves the interrupt pending
+    usfs.useDataReadyPin();
+    check("USFS without interrupt returns no gyro", !usfs.getGyrometer(gx, gy, gz));
+    check("USFS without interrupt: no transactions", traffic(bus, 0, 0));
+
+    usfs.handleDataReadyInterrupt();
+    bus.failing = true;
+    check("USFS failed read after interrupt returns no gyro", !usfs.getGyrometer(gx, gy, gz));
+    bus.failing = false;
+    check("USFS interrupt kept until a read succeeds", usfs.getGyrometer(gx, gy, gz));
+    check("USFS interrupt handled after a read", !usfs.getGyrometer(gx, gy, gz));
+    bus.resetCounts();
+}
+
+static void testMPU9250(void)
+{
+    // MPU9250 registers
+    static const uint8_t REG_INT_STATUS   = 0x3A;
+    static const uint8_t REG_ACCEL_XOUT_H = 0x3B;
+    static const uint8_t REG_GYRO_XOUT_H  = 0x43;
+
+    FlakyBus bus(0x68);
+    TestMPU9250 mpu;
+    mpu.useBus(&bus);
+
+    // Big-endian int16s: accel X = 0x4000 (1 g at 2 g full scale), gyro Z = 0x1000
+    bus.registers[REG_ACCEL_XOUT_H]   = 0x40;
+    bus.registers[REG_GYRO_XOUT_H+4]  = 0x10;
+
+    // Miss: status byte only
+    bus.registers[REG_INT_STATUS] = 0x00;
+    check("MPU9250 miss returns not ready", !mpu.ready());
+    check("MPU9250 miss: 1 transaction, 1 byte", traffic(bus, 1, 1));
+
+    // Event: status byte, then accel, temperature and gyro in one burst
+    bus.registers[REG_INT_STATUS] = 0x01;
+    check("MPU9250 event returns ready", mpu.ready());
+    check("MPU9250 event: 2 transactions, 15 bytes", traffic(bus, 2, 15));
+
+    float ax = 0, ay = 0, az = 0, gx = 0, gy = 0, gz = 0;
+    mpu.readAccelGyro(ax, ay, az, gx, gy, gz);
+    check("MPU9250 accel/gyro decoded", near(ax, 1) && near(ay, 0) && near(az, 0) &&
+            near(gx, 0) && near(gy, 0) && near(gz, radians(0x1000 * 250.f / 32768)));
+    check("MPU9250 decoding uses no bus", traffic(bus, 0, 0));
+
+    // Data-ready pin, through getGyrometer(): a failed burst leaves the interrupt pending
+    mpu.useDataReadyPin();
+    check("MPU9250 without interrupt returns no gyro", !mpu.getGyrometer(gx, gy, gz));
+    check("MPU9250 without interrupt: no transactions", traffic(bus, 0, 0));
+
+    mpu.handleDataReadyInterrupt();
+    bus.failing = true;
+    check("MPU9250 failed read after interrupt returns no gyro", !mpu.getGyrometer(gx, gy, gz));
+    bus.failing = false;
+    check("MPU9250 interrupt kept until a read succeeds", mpu.getGyrometer(gx, gy, gz));
+    check("MPU9250 interrupt handled after a read", !mpu.getGyrometer(gx, gy, gz));
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    testUSFS();
+    testMPU9250();
+
+    printf("%s\n", _ok ? "PASSED" : "FAILED");
+
+    return _ok ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/*
+   Host test for the asynchronous VL53L1X rangefinder driver
+
+   Runs the driver's state machine against a SimulatedBus standing in for a
+   sensor that produces a new range every 40 msec, at several bus latencies.
+   Checks that every range is read promptly and its interrupt cleared, and
+   that the driver recovers from failed transactions.
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+#include "buses/simulated.hpp"
+#include "sensors/rangefinders/vl53l1x.hpp"
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+// VL53L1X registers
+static const uint8_t  ADDRESS                = 0x29;
+static const uint16_t REG_GPIO_HV_MUX_CTRL   = 0x0030;
+static const uint16_t REG_GPIO_TIO_HV_STATUS = 0x0031;
+static const uint16_t REG_INTERRUPT_CLEAR    = 0x0086;
+static const uint16_t REG_RANGE_MM           = 0x0096;
+
+static const float MEASUREMENT_PERIOD = 0.040;  // sec
+static const float UPDATE_PERIOD      = 0.0001; // sec
+static const float RUN_TIME           = 2;      // sec
+
+// Reading must arrive within this long after the sensor has it, plus the transactions needed to get it
+static const float MAX_LAG = 0.002;
+
+// Exposes the driver's ready() and distance, bypassing Sensor's polling policy so that every update advances it
+class TestRangefinder : public hf::VL53L1X_Rangefinder {
+
+    public:
+
+        bool update(float time, float & distance)
+        {
+            if (!ready(time)) {
+                return false;
+            }
+
+            hf::state_t state = {};
+            state.setQuaternion(1, 0, 0, 0);
+            modifyState(state, time);
+            distance = state.location[2];
+
+            return true;
+        }
+};
+
+// The simulated sensor: a new range every measurement period, held until the interrupt is cleared
+class Device {
+
+    private:
+
+        hf::SimulatedBus & _bus;
+
+        float _nextTime = 0;
+        uint16_t _rangeMm = 1000;
+
+    public:
+
+        float measurementTime = -1;
+        uint16_t measuredMm = 0;
+        uint32_t measurementCount = 0;
+        uint32_t clearCount = 0;
+
+        Device(hf::SimulatedBus & bus) : _bus(bus)
+        {
+            // Active-high interrupt
+            _bus.registers[REG_GPIO_HV_MUX_CTRL] = 0x01;
+        }
+
+        void update(float time)
+        {
+            if (_bus.registers[REG_INTERRUPT_CLEAR]) {
+                _bus.registers[REG_INTERRUPT_CLEAR] = 0;
+                _bus.registers[REG_GPIO_TIO_HV_STATUS] = 0;
+                clearCount++;
+            }
+
+            if (time >= _nextTime) {
+                _nextTime += MEASUREMENT_PERIOD;
+                _rangeMm += 7;
+                _bus.registers[REG_RANGE_MM]   = _rangeMm >> 8;
+                _bus.registers[REG_RANGE_MM+1] = _rangeMm & 0xFF;
+                _bus.registers[REG_GPIO_TIO_HV_STATUS] = 1;
+                measurementTime = time;
+                measuredMm = _rangeMm;
+                measurementCount++;
+            }
+        }
+};
+
+static bool _ok = true;
+
+static void check(const char * name, bool result)
+{
+    printf("%-60s %s\n", name, result ? "ok" : "FAILED");
+
+    _ok = _ok && result;
+}
+
+static void testLatency(float latency, float latencyPerByte)
+{
+    hf::SimulatedBus bus(ADDRESS, latency, latencyPerByte);
+    Device device(bus);
+    TestRangefinder rangefinder;
+    rangefinder.useBus(&bus);
+
+    uint32_t readings = 0;
+    uint32_t wrongDistances = 0;
+    float maxLag = 0;
+
+    for (float time=0; time<RUN_TIME; time+=UPDATE_PERIOD) {
+
+        device.update(time);
+
+        float distance = 0;
+
+        if (rangefinder.update(time, distance)) {
+
+            readings++;
+
+            if (fabsf(distance - device.measuredMm / 1000.f) > 1e-4f) {
+                wrongDistances++;
+            }
+
+            if (time - device.measurementTime > maxLag) {
+                maxLag = time - device.measurementTime;
+            }
+        }
+    }
+
+    char name[100];
+
+    printf("Latency %.1f msec + %.2f msec/byte: %u readings, max lag %.2f msec, %u transactions\n",
+            latency*1000, latencyPerByte*1000, readings, maxLag*1000, bus.getCompletedCount());
+
+    // The last measurement may still be in flight
+    snprintf(name, sizeof(name), "  every measurement read");
+    check(name, readings + 1 >= device.measurementCount && readings <= device.measurementCount);
+
+    snprintf(name, sizeof(name), "  distances match the sensor");
+    check(name, wrongDistances == 0);
+
+    snprintf(name, sizeof(name), "  interrupt cleared once per reading");
+    check(name, device.clearCount >= readings && device.clearCount <= readings + 1);
+
+    snprintf(name, sizeof(name), "  readings arrive within %.0f msec plus bus time", MAX_LAG*1000);
+    check(name, maxLag <= MAX_LAG + latency * 4 + latencyPerByte * 5);
+}
+
+// Fails every transaction while failing is set
+class FlakyBus : public hf::SimulatedBus {
+
+    protected:
+
+        virtual bool transferDone(transaction_t * t, float time) override
+        {
+            if (!hf::SimulatedBus::transferDone(t, time)) {
+                return false;
+            }
+
+            if (failing) {
+                t->status = FAILED;
+            }
+
+            return true;
+        }
+
+    public:
+
+        bool failing = true;
+
+        FlakyBus(void) : hf::SimulatedBus(ADDRESS, 0.0002f) { }
+};
+
+static void testRecovery(void)
+{
+    FlakyBus bus;
+    Device device(bus);
+    TestRangefinder rangefinder;
+    rangefinder.useBus(&bus);
+
+    float distance = 0, time = 0;
+    uint32_t readings = 0;
+
+    for (; time<0.1f; time+=UPDATE_PERIOD) {
+        device.update(time);
+        readings += rangefinder.update(time, distance);
+    }
+
+    check("Failed transactions yield no readings", readings == 0);
+
+    bus.failing = false;
+
+    for (; time<0.2f; time+=UPDATE_PERIOD) {
+        device.update(time);
+        readings += rangefinder.update(time, distance);
+    }
+
+    check("Driver restarts after failed transactions", readings > 0);
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    testLatency(0, 0);
+    testLatency(0.0001f, 0.00002f);
+    testLatency(0.0005f, 0.0001f);
+    testLatency(0.002f, 0.0005f);
+
+    testRecovery();
+
+    printf("%s\n", _ok ? "PASSED" : "FAILED");
+
+    return _ok ? 0 : 1;
+}
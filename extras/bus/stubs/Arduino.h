@@ -0,0 +1,18 @@
+/*
+   Minimal Arduino declarations for building IMU drivers on the host
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+inline float radians(float degrees) { return degrees * (float)M_PI / 180; }
+
+struct HardwareSerial {
+    void println(const char * s) { puts(s); }
+};
+
+extern HardwareSerial Serial;
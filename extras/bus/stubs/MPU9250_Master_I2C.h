@@ -0,0 +1,23 @@
+/*
+   Stand-in for the MPU9250 library, which the driver uses only for startup
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct MPUIMU {
+    enum Ascale_t { AFS_2G, AFS_4G, AFS_8G, AFS_16G };
+    enum Gscale_t { GFS_250DPS, GFS_500DPS, GFS_1000DPS, GFS_2000DPS };
+    enum { ERROR_NONE, ERROR_IMU_ID, ERROR_MAG_ID, ERROR_SELFTEST };
+};
+
+struct MPU9250 : MPUIMU {
+    enum Mscale_t { MFS_14BITS, MFS_16BITS };
+    enum Mmode_t { M_8Hz, M_100Hz };
+};
+
+struct MPU9250_Master_I2C : MPU9250 {
+    MPU9250_Master_I2C(Ascale_t, Gscale_t, Mscale_t, Mmode_t, uint8_t) { }
+    int begin(void) { return ERROR_NONE; }
+};
@@ -0,0 +1,13 @@
+/*
+   Stand-in for the USFS library, which the driver uses only for startup
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct USFS_Master {
+    USFS_Master(uint8_t, uint16_t, uint16_t, uint8_t, uint8_t) { }
+    bool begin(void) { return true; }
+    const char * getErrorString(void) { return ""; }
+};
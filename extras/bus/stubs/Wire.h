@@ -0,0 +1,17 @@
+/*
+   Stand-in for the Arduino Wire library; the host test routes polling through a MockBus instead
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+struct TwoWire {
+    void beginTransmission(uint8_t) { }
+    size_t write(uint8_t) { return 1; }
+    uint8_t endTransmission(bool = true) { return 4; }
+    uint8_t requestFrom(uint8_t, uint8_t) { return 0; }
+    int read(void) { return 0; }
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,250 @@
+/*
+   Host stress test for the lock-free handoff primitives
+
+   Runs a producer and a consumer on separate threads for SpscRing (single
+   and bulk transfers), LatestValue and Snapshot.  Checks that ring items
+   arrive complete and in order with none lost, and that latest-value reads
+   are never torn, never go backwards, and report new values correctly.
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include "spscring.hpp"
+#include "latestvalue.hpp"
+#include "snapshot.hpp"
+
+// Enough for the uint16_t ring indices to wrap many times.  Both sides yield when they can't make progress, so the
+// test also runs on a single core.
+static const uint32_t ITEM_COUNT = 2000000;
+
+static const uint32_t WRITE_COUNT = 2000000;
+
+// Large enough that a copy takes many instructions, so a torn read would be likely
+typedef struct {
+
+    uint32_t sequence;
+    uint32_t words[15];
+
+} record_t;
+
+static record_t makeRecord(uint32_t sequence)
+{
+    record_t record = {};
+
+    record.sequence = sequence;
+
+    for (uint8_t k=0; k<15; ++k) {
+        record.words[k] = sequence * (k + 3);
+    }
+
+    return record;
+}
+
+static bool isTorn(const record_t & record)
+{
+    for (uint8_t k=0; k<15; ++k) {
+        if (record.words[k] != record.sequence * (k + 3)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool _ok = true;
+
+static void check(const char * name, bool result)
+{
+    printf("%-48s %s\n", name, result ? "ok" : "FAILED");
+
+    _ok = _ok && result;
+}
+
+static void testRing(void)
+{
+    static hf::SpscRing<record_t, 64> ring;
+
+    uint32_t failedPushes = 0;
+
+    std::thread producer([&]() {
+        for (uint32_t k=0; k<ITEM_COUNT; ) {
+            if (ring.push(makeRecord(k))) {
+                k++;
+            }
+            else {
+                failedPushes++;
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t outOfOrder = 0, torn = 0;
+
+    for (uint32_t expected=0; expected<ITEM_COUNT; ) {
+
+        record_t record;
+
+        if (ring.pop(record)) {
+            outOfOrder += record.sequence != expected;
+            torn += isTorn(record);
+            expected = record.sequence + 1;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    printf("SpscRing: %u items, %u pushes refused while full\n", ITEM_COUNT, failedPushes);
+
+    check("  items arrive in order, none lost", outOfOrder == 0);
+    check("  no torn items", torn == 0);
+    check("  refused pushes counted as drops", ring.getDropCount() == failedPushes);
+    check("  ring empty at end", ring.available() == 0);
+}
+
+static void testBulkRing(void)
+{
+    static hf::SpscRing<uint32_t, 256> ring;
+
+    std::thread producer([&]() {
+
+        uint32_t batch[37];
+        uint32_t next = 0;
+
+        for (uint16_t count=1; next<ITEM_COUNT; count=count%37+1) {
+
+            if (next + count > ITEM_COUNT) {
+                count = ITEM_COUNT - next;
+            }
+
+            for (uint16_t k=0; k<count; ++k) {
+                batch[k] = next + k;
+            }
+
+            // All or nothing, so retry the same batch until it fits
+            while (!ring.push(batch, count)) {
+                std::this_thread::yield();
+            }
+
+            next += count;
+        }
+    });
+
+    uint32_t outOfOrder = 0;
+    uint32_t expected = 0;
+
+    for (uint16_t count=1; expected<ITEM_COUNT; count=count%53+1) {
+
+        uint32_t batch[53];
+
+        uint16_t popped = ring.pop(batch, count);
+
+        if (popped == 0) {
+            std::this_thread::yield();
+        }
+
+        for (uint16_t k=0; k<popped; ++k) {
+            outOfOrder += batch[k] != expected;
+            expected = batch[k] + 1;
+        }
+    }
+
+    producer.join();
+
+    printf("SpscRing bulk: %u items in batches of 1-37, popped in batches of 1-53\n", ITEM_COUNT);
+
+    check("  items arrive in order, none lost", outOfOrder == 0);
+}
+
+// Works for LatestValue and Snapshot, which have the same interface
+template <typename Slot>
+static void testLatest(const char * name)
+{
+    static Slot slot;
+
+    std::atomic<bool> done(false);
+
+    std::thread writer([&]() {
+        for (uint32_t k=1; k<=WRITE_COUNT; ++k) {
+            slot.write(makeRecord(k));
+            if (k % 16 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    });
+
+    uint32_t reads = 0, newReads = 0, torn = 0, backwards = 0, wrongNew = 0;
+    uint32_t last = 0;
+
+    while (true) {
+
+        bool finished = done;
+
+        record_t record;
+        bool isNew = slot.read(record);
+
+        reads++;
+        newReads += isNew;
+        torn += isTorn(record);
+        backwards += record.sequence < last;
+
+        // New exactly when the value differs from the previous read
+        wrongNew += isNew != (record.sequence != last);
+
+        last = record.sequence;
+
+        if (reads % 16 == 0) {
+            std::this_thread::yield();
+        }
+
+        // One more read after the writer finishes must see its final value
+        if (finished) {
+            break;
+        }
+    }
+
+    writer.join();
+
+    printf("%s: %u writes, %u reads, %u new\n", name, WRITE_COUNT, reads, newReads);
+
+    check("  no torn reads", torn == 0);
+    check("  values never go backwards", backwards == 0);
+    check("  read() reports new values correctly", wrongNew == 0);
+    check("  final value seen", last == WRITE_COUNT);
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    testRing();
+    testBulkRing();
+    testLatest<hf::LatestValue<record_t>>("LatestValue");
+    testLatest<hf::Snapshot<record_t>>("Snapshot");
+
+    printf("%s\n", _ok ? "PASSED" : "FAILED");
+
+    return _ok ? 0 : 1;
+}
@@ -1,8 +1,8 @@
 /*
    Example of parsing MSPPG messages with Java
 
-   Mocks up an STATE message response from the flight controller
-   and uses the Parser object to parse the response bytes
+   Subscribes to STATE messages pushed by the flight controller, then mocks
+   up a pushed STATE message and uses the Parser object to parse its bytes
 
    Copyright (C) Simon D. Levy 2018
 
@@ -33,9 +33,22 @@ public class StateParser extends Parser {
 
     }
 
+    // Pushes per second requested from flight controller
+    static final int STATE_RATE_HZ = 10;
+
     public static void main(String [] argv) {
 
-        // Fake response from flight controller
+        StateParser parser = new StateParser();
+
+        // Subscription to send to flight controller
+        byte [] subscription = parser.serialize_SET_TELEMETRY_SUBSCRIPTION(112, STATE_RATE_HZ);
+
+        for (byte b : subscription) {
+            System.out.printf("%02x ", b);
+        }
+        System.out.println();
+
+        // Fake pushed message from flight controller
         byte [] buf = {(byte)0x24, (byte)0x4d, (byte)0x3e, (byte)0x1c,
             (byte)0x70, (byte)0x00, (byte)0x00, (byte)0x80, (byte)0x3f,
             (byte)0x00, (byte)0x00, (byte)0x00, (byte)0x40, (byte)0x00,
@@ -44,8 +57,6 @@ public class StateParser extends Parser {
             (byte)0x40, (byte)0x00, (byte)0x00, (byte)0xc0, (byte)0x40,
             (byte)0x00, (byte)0x00, (byte)0xe0, (byte)0x40, (byte)0x93};
 
-        StateParser parser = new StateParser();
-
         for (byte b : buf) {
 
             parser.parse(b);
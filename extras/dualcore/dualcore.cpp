@@ -0,0 +1,310 @@
+/*
+   Host test and benchmark for Hackflight's dual-core split
+
+   Runs updateInnerLoop() and updateOuterLoops() on two threads, standing in
+   for the two cores of an ESP32, with a scripted receiver:
+
+     0.0 - 0.1 sec: disarmed, GCS spins motor 1
+     0.1 - 0.2 sec: arm with throttle down
+     0.2 - 0.5 sec: fly
+     0.5 sec:       receiver loses signal (failsafe)
+
+   Checks that only the inner-loop thread writes to the motors, that the GCS
+   motor test and flight both reach the motors, and that the failsafe cut
+   reaches them and keeps them stopped.  Then reports update rates for the
+   split and for the single-core update().
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "hackflight.hpp"
+#include "actuators/mixers/quadxcf.hpp"
+#include "pidcontrollers/rate.hpp"
+#include "pidcontrollers/level.hpp"
+
+static const float ARM_TIME      = 0.1;
+static const float FLY_TIME      = 0.2;
+static const float FAILSAFE_TIME = 0.5;
+static const float END_TIME      = 0.8;
+
+// Time for a cut to reach the motors: one stale rate-loop run may still be in progress when it's published
+static const float CUT_LATENCY = 0.005;
+
+static const float GCS_MOTOR_VALUE = 0.25;
+
+static std::chrono::steady_clock::time_point _startTime;
+
+static float seconds(void)
+{
+    return std::chrono::duration<float>(std::chrono::steady_clock::now() - _startTime).count();
+}
+
+void hf::Board::outbuf(char * buf)
+{
+    fputs(buf, stdout);
+}
+
+class HostBoard : public hf::Board {
+
+    protected:
+
+        virtual float getTime(void) override
+        {
+            return seconds();
+        }
+};
+
+// Follows the script in the header comment; touched only by the outer-loop thread
+class ScriptedReceiver : public hf::Receiver {
+
+    private:
+
+        static constexpr uint8_t CHANNEL_MAP[6] = {0, 1, 2, 3, 4, 5};
+
+    protected:
+
+        virtual bool gotNewFrame(void) override
+        {
+            return true;
+        }
+
+        virtual void readRawvals(void) override
+        {
+            float time = seconds();
+
+            rawvals[0] = time < FLY_TIME ? -1 : 0.2f;   // throttle
+            rawvals[4] = time < ARM_TIME ? -1 : +1;     // aux1 (arm)
+        }
+
+        virtual bool lostSignal(void) override
+        {
+            return seconds() >= FAILSAFE_TIME;
+        }
+
+    public:
+
+        ScriptedReceiver(void)
+            : hf::Receiver(CHANNEL_MAP)
+        {
+        }
+};
+
+constexpr uint8_t ScriptedReceiver::CHANNEL_MAP[6];
+
+// A new gyrometer reading on every call, and level attitude
+class HostIMU : public hf::IMU {
+
+    public:
+
+        virtual bool getGyrometer(float & gx, float & gy, float & gz) override
+        {
+            gx = 0.01f;
+            gy = -0.01f;
+            gz = 0;
+
+            return true;
+        }
+
+        virtual bool getQuaternion(float & qw, float & qx, float & qy, float & qz, float time) override
+        {
+            (void)time;
+
+            qw = 1;
+            qx = 0;
+            qy = 0;
+            qz = 0;
+
+            return true;
+        }
+};
+
+// Lets the outer-loop thread set motor values the way the GCS does
+class HostMixer : public hf::MixerQuadXCF {
+
+    public:
+
+        void setDisarmedValue(uint8_t index, float value)
+        {
+            motorsDisarmed[index] = value;
+        }
+};
+
+// Records who writes to the motor, what, and when
+class RecordingMotor : public hf::Motor {
+
+    public:
+
+        std::thread::id writer;
+
+        std::atomic<uint32_t> wrongThreadWrites;
+        std::atomic<uint32_t> gcsWrites;
+        std::atomic<uint32_t> flightWrites;
+        std::atomic<uint32_t> lateWrites;
+        std::atomic<float> value;
+
+        RecordingMotor(void)
+            : hf::Motor(0), wrongThreadWrites(0), gcsWrites(0), flightWrites(0), lateWrites(0), value(0)
+        {
+        }
+
+        virtual void write(float v) override
+        {
+            float time = seconds();
+
+            wrongThreadWrites += std::this_thread::get_id() != writer;
+
+            gcsWrites += time < ARM_TIME && v == GCS_MOTOR_VALUE;
+
+            flightWrites += time >= FLY_TIME && time < FAILSAFE_TIME && v > 0;
+
+            lateWrites += time > FAILSAFE_TIME + CUT_LATENCY && v != 0;
+
+            value = v;
+        }
+};
+
+static bool _ok = true;
+
+static void check(const char * name, bool result)
+{
+    printf("%-48s %s\n", name, result ? "ok" : "FAILED");
+
+    _ok = _ok && result;
+}
+
+static void testDualCore(void)
+{
+    static hf::Hackflight h;
+    static HostBoard board;
+    static HostIMU imu;
+    static ScriptedReceiver receiver;
+    static HostMixer mixer;
+
+    static RecordingMotor motor1, motor2, motor3, motor4;
+    static RecordingMotor * recordingMotors[4] = {&motor1, &motor2, &motor3, &motor4};
+    static hf::Motor * motors[4] = {&motor1, &motor2, &motor3, &motor4};
+
+    static hf::RatePid ratePid(0.05f, 0.00f, 0.00f, 0.10f, 0.01f);
+    static hf::LevelPid levelPid(0.20f);
+
+    _startTime = std::chrono::steady_clock::now();
+
+    // The motors are initialized here, before any thread is started
+    h.init(&board, &imu, &receiver, &mixer, motors);
+    h.addPidController(&levelPid);
+    h.addPidController(&ratePid);
+    h.useDualCore();
+
+    std::atomic<bool> done(false);
+    uint32_t outerCount = 0;
+
+    std::thread outer([&]() {
+
+        while (!done) {
+
+            mixer.setDisarmedValue(0, seconds() < ARM_TIME - 0.02f ? GCS_MOTOR_VALUE : 0);
+
+            h.updateOuterLoops();
+
+            outerCount++;
+
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    for (uint8_t k=0; k<4; ++k) {
+        recordingMotors[k]->writer = std::this_thread::get_id();
+    }
+
+    uint32_t innerCount = 0;
+
+    while (seconds() < END_TIME) {
+        h.updateInnerLoop();
+        innerCount++;
+    }
+
+    done = true;
+    outer.join();
+
+    printf("Dual core: inner loop %.0f Hz, outer loops %.0f Hz, rate PID %u computes, level PID %u computes\n",
+            innerCount / END_TIME, outerCount / END_TIME, ratePid.getComputeCount(), levelPid.getComputeCount());
+
+    uint32_t wrongThreadWrites = 0, flightWrites = 0, lateWrites = 0;
+    bool stopped = true;
+
+    for (uint8_t k=0; k<4; ++k) {
+        wrongThreadWrites += recordingMotors[k]->wrongThreadWrites;
+        flightWrites += recordingMotors[k]->flightWrites;
+        lateWrites += recordingMotors[k]->lateWrites;
+        stopped = stopped && recordingMotors[k]->value == 0;
+    }
+
+    check("  only the inner-loop thread writes motors", wrongThreadWrites == 0);
+    check("  GCS motor test reaches the motor", motor1.gcsWrites > 0 && motor2.gcsWrites == 0);
+    check("  flight demands reach the motors", flightWrites > 0);
+    check("  failsafe cut keeps motors stopped", lateWrites == 0);
+    check("  motors stopped at end", stopped);
+}
+
+// The same vehicle with everything in update(), for comparison
+static void benchmarkSingleCore(void)
+{
+    static hf::Hackflight h;
+    static HostBoard board;
+    static HostIMU imu;
+    static ScriptedReceiver receiver;
+    static HostMixer mixer;
+
+    static RecordingMotor motor1, motor2, motor3, motor4;
+    static hf::Motor * motors[4] = {&motor1, &motor2, &motor3, &motor4};
+
+    static hf::RatePid ratePid(0.05f, 0.00f, 0.00f, 0.10f, 0.01f);
+    static hf::LevelPid levelPid(0.20f);
+
+    _startTime = std::chrono::steady_clock::now();
+
+    h.init(&board, &imu, &receiver, &mixer, motors);
+    h.addPidController(&levelPid);
+    h.addPidController(&ratePid);
+
+    uint32_t count = 0;
+
+    while (seconds() < END_TIME) {
+        h.update();
+        count++;
+    }
+
+    printf("Single core: update() %.0f Hz, rate PID %u computes, level PID %u computes\n",
+            count / END_TIME, ratePid.getComputeCount(), levelPid.getComputeCount());
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    testDualCore();
+    benchmarkSingleCore();
+
+    printf("%s\n", _ok ? "PASSED" : "FAILED");
+
+    return _ok ? 0 : 1;
+}
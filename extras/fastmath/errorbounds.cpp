@@ -0,0 +1,160 @@
+/*
+   Host test for the FastMath kernels
+
+   Sweeps each kernel over its input range, measures the worst-case error
+   against the double-precision C library, and fails if it exceeds the bound
+   documented in fastmath.hpp
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as 
+   published by the Free Software Foundation, either version 3 of the 
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,     
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License 
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fastmath.hpp"
+
+using hf::FastMath;
+
+// Documented in fastmath.hpp
+static const double ATAN2_BOUND  = 2.0e-6;
+static const double ASIN_BOUND   = 6.8e-5;
+static const double SINCOS_BOUND = 2.0e-7;
+static const double RSQRT_BOUND  = 4.8e-6;
+
+static bool report(const char * name, double maxError, double bound, float worstInput)
+{
+    bool ok = maxError <= bound;
+
+    printf("%-7s max error %.3e (bound %.1e) at x=%+.7g: %s\n", name, maxError, bound, worstInput, ok ? "ok" : "EXCEEDED");
+
+    return ok;
+}
+
+static float uniform(float lo, float hi)
+{
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+static bool testAtan2(void)
+{
+    double maxError = 0;
+    float worst = 0;
+
+    // Every direction, at radii from tiny to large
+    for (uint32_t k=0; k<2000000; ++k) {
+
+        double angle = -M_PI + 2 * M_PI * k / 2000000.;
+        float radius = powf(10, uniform(-20, 20));
+
+        float y = (float)(radius * sin(angle));
+        float x = (float)(radius * cos(angle));
+
+        double error = fabs(FastMath::fastAtan2(y, x) - atan2((double)y, (double)x));
+
+        // The two results can straddle the branch cut at +/-pi
+        if (error > M_PI) {
+            error = fabs(error - 2 * M_PI);
+        }
+
+        if (error > maxError) {
+            maxError = error;
+            worst = y / x;
+        }
+    }
+
+    return report("atan2", maxError, ATAN2_BOUND, worst);
+}
+
+static bool testAsin(void)
+{
+    double maxError = 0;
+    float worst = 0;
+
+    for (int32_t k=-2000000; k<=2000000; ++k) {
+
+        float x = k / 2000000.f;
+
+        double error = fabs(FastMath::fastAsin(x) - asin((double)x));
+
+        if (error > maxError) {
+            maxError = error;
+            worst = x;
+        }
+    }
+
+    return report("asin", maxError, ASIN_BOUND, worst);
+}
+
+static bool testSincos(void)
+{
+    double maxError = 0;
+    float worst = 0;
+
+    for (uint32_t k=0; k<4000000; ++k) {
+
+        // Dense near zero, where attitude angles live, and sparse out to the documented limit
+        float x = (k & 1) ? uniform(-10, 10) : uniform(-1e4f, 1e4f);
+
+        float s = 0, c = 0;
+        FastMath::fastSincos(x, s, c);
+
+        double error = fmax(fabs(s - sin((double)x)), fabs(c - cos((double)x)));
+
+        if (error > maxError) {
+            maxError = error;
+            worst = x;
+        }
+    }
+
+    return report("sincos", maxError, SINCOS_BOUND, worst);
+}
+
+static bool testRsqrt(void)
+{
+    double maxError = 0;
+    float worst = 0;
+
+    // Relative error repeats with each factor of four, but sweep the whole normal range anyway
+    for (uint32_t k=0; k<4000000; ++k) {
+
+        float x = powf(2, -126 + 253 * (k / 4000000.f));
+
+        double exact = 1 / sqrt((double)x);
+
+        double error = fabs(FastMath::fastRsqrt(x) - exact) / exact;
+
+        if (error > maxError) {
+            maxError = error;
+            worst = x;
+        }
+    }
+
+    return report("rsqrt", maxError, RSQRT_BOUND, worst);
+}
+
+int main(void)
+{
+    bool ok = true;
+
+    ok &= testAtan2();
+    ok &= testAsin();
+    ok &= testSincos();
+    ok &= testRsqrt();
+
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+
+    return ok ? 0 : 1;
+}
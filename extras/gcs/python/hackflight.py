@@ -30,6 +30,12 @@ CONNECTION_DELAY_MSEC  = 4000
 
 USB_UPDATE_MSEC = 200
 
+# Telemetry pushed by the flight controller, as MSP message ID and rate in Hz
+ATTITUDE_RADIANS_ID = 122
+ATTITUDE_RATE_HZ    = 30
+RC_NORMAL_ID        = 121
+RC_RATE_HZ          = 20
+
 from comms import Comms
 from serial.tools.list_ports import comports
 import os
@@ -128,10 +134,6 @@ class GCS(msppg.Parser):
         # Create a message parser 
         #self.parser = msppg.Parser()
 
-        # Set up parser's request strings
-        self.attitude_request = msppg.serialize_ATTITUDE_RADIANS_Request()
-        self.rc_request = msppg.serialize_RC_NORMAL_Request()
-
         # No messages yet
         self.roll_pitch_yaw = [0]*3
         self.rxchannels = [0]*6
@@ -185,10 +187,6 @@ class GCS(msppg.Parser):
         # Display throttle as [0,1], other channels as [-1,+1]
         self.rxchannels = c1/2.+.5, c2, c3, c4, c5, c6
 
-        # As soon as we handle the callback from one request, send another request, if receiver dialog is running
-        if self.receiver.running:
-            self._send_rc_request()
-
         #self.messages.setCurrentMessage('Receiver: %04d %04d %04d %04d %04d' % (c1, c2, c3, c4, c5))
 
     def handle_ATTITUDE_RADIANS(self, x, y, z):
@@ -199,9 +197,6 @@ class GCS(msppg.Parser):
 
         #self.messages.setCurrentMessage('Roll/Pitch/Yaw: %+3.3f %+3.3f %+3.3f' % self.roll_pitch_yaw)
 
-        # As soon as we handle the callback from one request, send another request, if IMU dialog is running
-        if self.imu.running:
-            self._send_attitude_request()
 
     def _add_pane(self):
 
@@ -226,12 +221,13 @@ class GCS(msppg.Parser):
         #self.messages.stop()
         #self.maps.stop()
 
-        self._send_attitude_request()
+        self._subscribe(RC_NORMAL_ID, 0)
+        self._subscribe(ATTITUDE_RADIANS_ID, ATTITUDE_RATE_HZ)
         self.imu.start()
 
     def _start(self):
 
-        self._send_attitude_request()
+        self._subscribe(ATTITUDE_RADIANS_ID, ATTITUDE_RATE_HZ)
         self.imu.start()
 
         self.gotimu = False
@@ -248,15 +244,10 @@ class GCS(msppg.Parser):
             self._disable_button(self.button_motors)
             self._disable_button(self.button_receiver)
 
-    # Sends Attitude request to FC
-    def _send_attitude_request(self):
+    # Asks FC to push a message at a given rate; zero rate stops it
+    def _subscribe(self, message_id, rate):
 
-        self.comms.send_request(self.attitude_request)
-
-    # Sends RC request to FC
-    def _send_rc_request(self):
-
-        self.comms.send_request(self.rc_request)
+        self.comms.send_message(msppg.serialize_SET_TELEMETRY_SUBSCRIPTION, (message_id, rate))
 
     # Callback for Motors button
     def _motors_button_callback(self):
@@ -267,6 +258,9 @@ class GCS(msppg.Parser):
         self.receiver.stop()
         #self.messages.stop()
         #self.maps.stop()
+
+        self._subscribe(ATTITUDE_RADIANS_ID, 0)
+        self._subscribe(RC_NORMAL_ID, 0)
         self.motors.start()
 
     def _clear(self):
@@ -283,7 +277,8 @@ class GCS(msppg.Parser):
         #self.messages.stop()
         #self.maps.stop()
 
-        self._send_rc_request()
+        self._subscribe(ATTITUDE_RADIANS_ID, 0)
+        self._subscribe(RC_NORMAL_ID, RC_RATE_HZ)
         self.receiver.start()
 
     # Callback for Messages button
@@ -296,6 +291,8 @@ class GCS(msppg.Parser):
         #self.maps.stop()
         self.receiver.stop()
 
+        self._subscribe(ATTITUDE_RADIANS_ID, 0)
+        self._subscribe(RC_NORMAL_ID, 0)
         self.messages.start()
 
     def _getting_messages(self):
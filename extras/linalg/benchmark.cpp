@@ -0,0 +1,298 @@
+/*
+   Host benchmark for the optical-flow EKF linear algebra
+
+   Runs the EKF's covariance updates (two scalar flow measurements and the
+   attitude-error rotation) with the fixed-size kernels in linalg.hpp, and
+   with the generic triple-loop products they replaced, checking that both
+   give the same covariance and reporting microseconds per update
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as 
+   published by the Free Software Foundation, either version 3 of the 
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,     
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License 
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "sensors/opticalflow/linalg.hpp"
+
+void hf::Board::outbuf(char * buf)
+{
+    fputs(buf, stdout);
+}
+
+static const uint8_t N = 9;
+
+// The EKF's previous matrix support: always 10 x 10, multiplied with a generic triple loop
+class GenericMatrix {
+
+    public:
+
+        static const uint8_t MAXSIZE = 10;
+
+        uint8_t _rows = 0;
+        uint8_t _cols = 0;
+
+        float _vals[MAXSIZE][MAXSIZE];
+
+        GenericMatrix(uint8_t rows, uint8_t cols)
+        {
+            _rows = rows;
+            _cols = cols;
+            memset(_vals, 0, sizeof(_vals));
+        }
+
+        static void trans(GenericMatrix & a, GenericMatrix & at)
+        {
+            for (uint8_t j=0; j<a._rows; ++j) {
+                for (uint8_t k=0; k<a._cols; ++k) {
+                    at._vals[k][j] = a._vals[j][k];
+                }
+            }
+        }
+
+        static void mult(GenericMatrix & a, GenericMatrix & b, GenericMatrix & c)
+        {
+            for(uint8_t i=0; i<a._rows; ++i) {
+                for(uint8_t j=0; j<b._cols; ++j) {
+                    c._vals[i][j] = 0;
+                    for(uint8_t k=0; k<a._cols; ++k) {
+                        c._vals[i][j] += a._vals[i][k] *b._vals[k][j];
+                    }
+                }
+            }
+        }
+
+}; // class GenericMatrix
+
+// Inputs for one EKF update
+typedef struct {
+
+    float hx[2];  // nonzero entries of the X and Y measurement rows
+    float hy[2];
+    float d[3];   // attitude error
+
+} step_t;
+
+static const uint8_t STATE_Z  = 2;
+static const uint8_t STATE_PX = 3;
+static const uint8_t STATE_PY = 4;
+static const uint8_t STATE_D0 = 6;
+
+static const float R = 0.25f * 0.25f;
+
+static const float Q = 1e-3f;
+
+static float uniform(float lo, float hi)
+{
+    return lo + (hi - lo) * rand() / (float)RAND_MAX;
+}
+
+static void fillRotation(const float d[3], float a[3][3])
+{
+    float d0 = d[0], d1 = d[1], d2 = d[2];
+
+    a[0][0] = 1 - d1*d1/2 - d2*d2/2; a[0][1] =  d2 + d0*d1/2;        a[0][2] = -d1 + d0*d2/2;
+    a[1][0] = -d2 + d0*d1/2;         a[1][1] = 1 - d0*d0/2 - d2*d2/2; a[1][2] =  d0 + d1*d2/2;
+    a[2][0] =  d1 + d0*d2/2;         a[2][1] = -d0 + d1*d2/2;        a[2][2] = 1 - d0*d0/2 - d1*d1/2;
+}
+
+static void genericScalarUpdate(GenericMatrix & P, uint8_t j1, float h1, uint8_t j2, float h2)
+{
+    static GenericMatrix H(1, N), HT(N, 1), PHT(N, 1), K(N, 1);
+    static GenericMatrix tmp1(N, N), tmp2(N, N), tmp3(N, N);
+
+    H = GenericMatrix(1, N);
+    H._vals[0][j1] = h1;
+    H._vals[0][j2] = h2;
+
+    GenericMatrix::trans(H, HT);
+    GenericMatrix::mult(P, HT, PHT);
+
+    float s = R;
+    for (uint8_t i=0; i<N; ++i) {
+        s += H._vals[0][i] * PHT._vals[i][0];
+    }
+
+    for (uint8_t i=0; i<N; ++i) {
+        K._vals[i][0] = PHT._vals[i][0] / s;
+    }
+
+    GenericMatrix::mult(K, H, tmp1);
+    for (uint8_t i=0; i<N; ++i) {
+        tmp1._vals[i][i] -= 1;
+    }
+    GenericMatrix::trans(tmp1, tmp2);
+    GenericMatrix::mult(tmp1, P, tmp3);
+    GenericMatrix::mult(tmp3, tmp2, P);
+
+    for (uint8_t i=0; i<N; ++i) {
+        for (uint8_t j=i; j<N; ++j) {
+            float p = 0.5f*P._vals[i][j] + 0.5f*P._vals[j][i] + K._vals[i][0] * R * K._vals[j][0];
+            P._vals[i][j] = p;
+            P._vals[j][i] = p;
+        }
+    }
+}
+
+static void genericUpdate(GenericMatrix & P, const step_t & step)
+{
+    static GenericMatrix A(N, N), AT(N, N), tmp(N, N);
+
+    genericScalarUpdate(P, STATE_Z, step.hx[0], STATE_PX, step.hx[1]);
+    genericScalarUpdate(P, STATE_Z, step.hy[0], STATE_PY, step.hy[1]);
+
+    float a[3][3];
+    fillRotation(step.d, a);
+
+    for (uint8_t i=0; i<N; ++i) {
+        A._vals[i][i] = 1;
+    }
+    for (uint8_t i=0; i<3; ++i) {
+        for (uint8_t j=0; j<3; ++j) {
+            A._vals[STATE_D0+i][STATE_D0+j] = a[i][j];
+        }
+    }
+
+    GenericMatrix::trans(A, AT);
+    GenericMatrix::mult(A, P, tmp);
+    GenericMatrix::mult(tmp, AT, P);
+
+    for (uint8_t i=0; i<N; ++i) {
+        for (uint8_t j=i; j<N; ++j) {
+            float p = 0.5f*P._vals[i][j] + 0.5f*P._vals[j][i];
+            P._vals[i][j] = p;
+            P._vals[j][i] = p;
+        }
+        P._vals[i][i] += Q;
+    }
+}
+
+static void scalarUpdate(hf::SymmetricMatrix<N> & P, uint8_t j1, float h1, uint8_t j2, float h2)
+{
+    hf::Matrix<1,N> H;
+    H.set(0, j1, h1);
+    H.set(0, j2, h2);
+
+    hf::Matrix<N,1> PHT;
+    P.mult(H, PHT);
+
+    float hph = 0;
+    for (uint8_t i=0; i<N; ++i) {
+        hph += H.get(0,i) * PHT.get(i,0);
+    }
+
+    hf::Matrix<N,1> K;
+    for (uint8_t i=0; i<N; ++i) {
+        K.set(i, 0, PHT.get(i,0) / (hph + R));
+    }
+
+    P.josephUpdate(K, PHT, hph, R);
+}
+
+static void update(hf::SymmetricMatrix<N> & P, const step_t & step)
+{
+    scalarUpdate(P, STATE_Z, step.hx[0], STATE_PX, step.hx[1]);
+    scalarUpdate(P, STATE_Z, step.hy[0], STATE_PY, step.hy[1]);
+
+    float a[3][3];
+    fillRotation(step.d, a);
+
+    hf::Matrix<3,3> A;
+    for (uint8_t i=0; i<3; ++i) {
+        for (uint8_t j=0; j<3; ++j) {
+            A.set(i, j, a[i][j]);
+        }
+    }
+
+    P.transform(STATE_D0, A);
+
+    for (uint8_t i=0; i<N; ++i) {
+        P.set(i, i, P.get(i, i) + Q);
+    }
+}
+
+int main(void)
+{
+    static const uint32_t STEPS = 200000;
+
+    // Small cross-covariances decay into subnormals, which are slow on x86 but not on the flight controller's FPU
+#if defined(__SSE__)
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+#endif
+
+    std::vector<step_t> steps(STEPS);
+
+    for (uint32_t k=0; k<STEPS; ++k) {
+        step_t & step = steps[k];
+        step.hx[0] = uniform(-2, 2);
+        step.hx[1] = uniform(1, 10);
+        step.hy[0] = uniform(-2, 2);
+        step.hy[1] = uniform(1, 10);
+        for (uint8_t j=0; j<3; ++j) {
+            step.d[j] = uniform(-0.01, 0.01);
+        }
+    }
+
+    // Same positive-definite starting covariance for both
+    GenericMatrix generic(N, N);
+    hf::SymmetricMatrix<N> symmetric;
+    for (uint8_t i=0; i<N; ++i) {
+        for (uint8_t j=i; j<N; ++j) {
+            float p = (i == j) ? 1 : uniform(-0.1, 0.1);
+            generic._vals[i][j] = generic._vals[j][i] = p;
+            symmetric.set(i, j, p);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t k=0; k<STEPS; ++k) {
+        genericUpdate(generic, steps[k]);
+    }
+    double genericTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t k=0; k<STEPS; ++k) {
+        update(symmetric, steps[k]);
+    }
+    double fixedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    float maxDiff = 0;
+    float maxVal = 0;
+    for (uint8_t i=0; i<N; ++i) {
+        for (uint8_t j=0; j<N; ++j) {
+            float diff = fabsf(generic._vals[i][j] - symmetric.get(i, j));
+            if (diff > maxDiff) maxDiff = diff;
+            if (fabsf(generic._vals[i][j]) > maxVal) maxVal = fabsf(generic._vals[i][j]);
+        }
+    }
+
+    printf("generic: %3.3f usec/update\n", 1e6 * genericTime / STEPS);
+    printf("fixed:   %3.3f usec/update (%2.1fx)\n", 1e6 * fixedTime / STEPS, genericTime / fixedTime);
+    printf("storage: %u bytes for P, was %u\n", (unsigned)sizeof(symmetric), (unsigned)sizeof(GenericMatrix));
+    printf("max difference %g (largest entry %g)\n", maxDiff, maxVal);
+
+    bool ok = maxDiff <= 1e-4f * (maxVal > 1 ? maxVal : 1);
+
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/*
+   Host test for serial receive under a GCS flood
+
+   Runs a LoopbackVehicle while the simulated GCS floods its port with
+   commands, attitude requests and line noise, first at 115200 baud and then
+   far faster than the serial task can parse.  Each byte parsed is charged
+   CPU time on the simulated clock.  Checks that each serial tick parses at
+   most its budget and writes at most one output queue, that the rate PID
+   controller keeps its schedule, that received bytes the ring can't hold are
+   counted, that every reply is well formed, and that the vehicle answers
+   promptly once the flood stops.
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "loopbackboard.hpp"
+
+static const float FLOOD_TIME = 1.0; // sec
+
+// Roughly what parsing a byte costs a 100 MHz microcontroller
+static const float COST_PER_BYTE = 2e-6; // sec
+
+// Must match SerialTask and MspParser
+static const uint16_t PARSE_BUDGET = 256;
+static const uint16_t OUTBUF_SIZE  = 256;
+
+static const float PID_PERIOD = 1 / hf::Pid::TUNED_FREQ;
+
+// Longest a reply may take once the flood has drained: two ticks of the 66 Hz serial task
+static const float REPLY_LATENCY = 2 / 66.f;
+
+static bool _ok = true;
+
+static void check(const char * name, bool result)
+{
+    printf("%-56s %s\n", name, result ? "ok" : "FAILED");
+
+    _ok = _ok && result;
+}
+
+// Commands, with an attitude request every tenth frame and a few bytes of noise after each; returns the bytes sent
+static uint32_t flood(LoopbackBoard & board, uint32_t size, uint32_t & requests)
+{
+    uint32_t sent = 0;
+
+    for (uint32_t k=0; sent<size; ++k) {
+
+        uint8_t bytes[64];
+        uint16_t count = 0;
+
+        if (k % 10 == 9) {
+            count = k % 20 == 9 ?
+                hf::MspParser::serialize_ATTITUDE_RADIANS_Request_V2(bytes) :
+                hf::MspParser::serialize_ATTITUDE_RADIANS_Request(bytes);
+            requests++;
+        }
+        else {
+            count = k % 2 ?
+                hf::MspParser::serialize_SET_RC_NORMAL_V2(bytes, -1, 0, 0, 0, -1, 0) :
+                hf::MspParser::serialize_SET_RC_NORMAL(bytes, -1, 0, 0, 0, -1, 0);
+        }
+
+        // Noise never contains a frame start, so it can't swallow the frame after it
+        for (uint8_t j=0; j<3; ++j) {
+            uint8_t noise = rand() & 0xFF;
+            bytes[count++] = noise == '$' ? 0 : noise;
+        }
+
+        board.send(bytes, count);
+        sent += count;
+    }
+
+    return sent;
+}
+
+static void testFlood(float baud)
+{
+    LoopbackVehicle vehicle(baud);
+    LoopbackBoard & board = vehicle.board;
+
+    vehicle.start();
+
+    uint32_t requests = 0;
+    uint32_t size = flood(board, (uint32_t)(FLOOD_TIME * baud / 10), requests);
+
+    ResponseDecoder decoder;
+    response_t response = {};
+    uint32_t replies = 0, errors = 0;
+
+    uint32_t maxParsed = 0, maxWritten = 0;
+    float maxPidGap = 0;
+
+    uint32_t pidCount = vehicle.ratePid.getComputeCount();
+    float pidTime = board.time;
+
+    // Run until the flood has arrived and been parsed or dropped
+    float end = board.time + FLOOD_TIME + 0.5f;
+
+    while (board.time < end) {
+
+        uint32_t parsed = board.bytesParsed;
+        size_t written = board.received.size();
+
+        vehicle.update();
+
+        parsed = board.bytesParsed - parsed;
+        written = board.received.size() - written;
+
+        board.time += parsed * COST_PER_BYTE;
+
+        maxParsed  = parsed  > maxParsed  ? parsed  : maxParsed;
+        maxWritten = written > maxWritten ? written : maxWritten;
+
+        if (vehicle.ratePid.getComputeCount() != pidCount) {
+            pidCount = vehicle.ratePid.getComputeCount();
+            maxPidGap = board.time - pidTime > maxPidGap ? board.time - pidTime : maxPidGap;
+            pidTime = board.time;
+        }
+
+        while (decoder.next(board.received, response)) {
+            replies++;
+            errors += response.error;
+        }
+    }
+
+    uint32_t dropped = board.getSerialDropCount();
+
+    printf("%.0f baud: %u bytes sent, %u parsed, %u dropped; %u of %u requests answered\n",
+            baud, size, board.bytesParsed, dropped, replies, requests);
+    printf("  at most %u bytes parsed and %u written per update; PID period at most %.2f msec\n",
+            maxParsed, maxWritten, maxPidGap * 1000);
+
+    check("  parsing stays within budget", maxParsed <= PARSE_BUDGET);
+    check("  output stays within one queue", maxWritten <= OUTBUF_SIZE);
+    check("  rate PID keeps its schedule",
+            maxPidGap <= PID_PERIOD + LoopbackVehicle::UPDATE_PERIOD + PARSE_BUDGET * COST_PER_BYTE);
+    check("  every byte parsed or counted as dropped", board.bytesParsed + dropped == size);
+    check("  replies well formed", decoder.badFrames == 0 && decoder.leftover(board.received) == 0 && errors == 0);
+
+    if (dropped == 0) {
+        check("  every request answered", replies == requests);
+    }
+    else {
+        check("  drops counted when flood outruns parsing", replies < requests);
+    }
+
+    // After the flood, a request gets a prompt reply
+    uint8_t bytes[16];
+    board.send(bytes, hf::MspParser::serialize_ATTITUDE_RADIANS_Request(bytes));
+
+    float sendTime = board.time;
+    bool answered = false;
+
+    while (!answered && board.time < sendTime + 1) {
+        vehicle.update();
+        answered = decoder.next(board.received, response);
+    }
+
+    check("  prompt reply after the flood", answered && board.time - sendTime <= REPLY_LATENCY);
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    srand(0);
+
+    testFlood(115200);
+    testFlood(921600);
+
+    printf("%s\n", _ok ? "PASSED" : "FAILED");
+
+    return _ok ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+/*
+   Host test for pipelined MSP requests over a serial loopback
+
+   Runs a LoopbackVehicle and has the simulated GCS send hundreds of
+   requests at 115200 baud, mixing MSPv1 and MSPv2 framing and two message
+   types, keeping up to a fixed number outstanding.  Checks that
+   every request gets exactly one well-formed reply, in order and in the
+   request's framing, with the right payload and no received bytes dropped,
+   and that pipelining raises throughput over one request at a time.  Then
+   checks that subscribed telemetry is pushed at the requested rate, or as
+   fast as the port's baud rate allows in the client's framing, and that a
+   bad subscription gets an error response.
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "loopbackboard.hpp"
+
+static const float    BAUD          = 115200;
+static const uint16_t REQUEST_COUNT = 500;
+static const float    TIME_LIMIT    = 20;     // sec
+
+static const uint8_t ATTITUDE_RADIANS = 122;
+static const uint8_t LOAD_SHEDDING    = 123;
+static const uint8_t SET_TELEMETRY_SUBSCRIPTION = 218;
+
+static const uint16_t SUBSCRIPTION_RATE = 100; // Hz
+static const float    SUBSCRIPTION_TIME = 2;   // sec
+
+// Pushes are counted after this, once the budget saved up before subscribing is spent
+static const float SUBSCRIPTION_WARMUP = 0.5; // sec
+
+static bool _ok = true;
+
+static void check(const char * name, bool result)
+{
+    printf("%-48s %s\n", name, result ? "ok" : "FAILED");
+
+    _ok = _ok && result;
+}
+
+// Every third request asks for load shedding; framing alternates between versions
+static uint8_t requestCommand(uint16_t k)
+{
+    return k % 3 == 2 ? LOAD_SHEDDING : ATTITUDE_RADIANS;
+}
+
+static uint8_t requestVersion(uint16_t k)
+{
+    return k % 2 ? 2 : 1;
+}
+
+static void sendRequest(LoopbackBoard & board, uint16_t k)
+{
+    uint8_t bytes[16];
+    uint16_t size = 0;
+
+    if (requestCommand(k) == LOAD_SHEDDING) {
+        size = requestVersion(k) == 2 ?
+            hf::MspParser::serialize_LOAD_SHEDDING_Request_V2(bytes) :
+            hf::MspParser::serialize_LOAD_SHEDDING_Request(bytes);
+    }
+    else {
+        size = requestVersion(k) == 2 ?
+            hf::MspParser::serialize_ATTITUDE_RADIANS_Request_V2(bytes) :
+            hf::MspParser::serialize_ATTITUDE_RADIANS_Request(bytes);
+    }
+
+    board.send(bytes, size);
+}
+
+static bool payloadOk(const response_t & response)
+{
+    if (response.command == LOAD_SHEDDING) {
+        return response.size == 20;
+    }
+
+    float attitude[3] = {};
+    memcpy(attitude, response.payload, sizeof(attitude));
+
+    return response.size == 12 && fabsf(attitude[0] - ROLL) < 1e-4f && fabsf(attitude[1]) < 1e-4f;
+}
+
+// Returns replies per second
+static float pipeline(uint16_t window)
+{
+    LoopbackVehicle vehicle(BAUD);
+    LoopbackBoard & board = vehicle.board;
+
+    vehicle.start();
+
+    ResponseDecoder decoder;
+
+    uint16_t sent = 0, replies = 0;
+    uint32_t wrongOrder = 0, wrongVersion = 0, wrongPayload = 0, errors = 0;
+
+    float start = board.time;
+
+    while (replies < REQUEST_COUNT && board.time < start + TIME_LIMIT) {
+
+        while (sent < REQUEST_COUNT && sent - replies < window) {
+            sendRequest(board, sent++);
+        }
+
+        vehicle.update();
+
+        response_t response = {};
+
+        while (decoder.next(board.received, response)) {
+
+            if (replies < REQUEST_COUNT) {
+                wrongOrder   += response.command != requestCommand(replies);
+                wrongVersion += response.version != requestVersion(replies);
+                wrongPayload += !payloadOk(response);
+                errors       += response.error;
+            }
+
+            replies++;
+        }
+    }
+
+    float elapsed = board.time - start;
+
+    // Any stray replies would show up by now
+    for (float end=board.time+0.1f; board.time<end; ) {
+        vehicle.update();
+    }
+
+    response_t response = {};
+
+    while (decoder.next(board.received, response)) {
+        replies++;
+    }
+
+    printf("Window %u: %u requests, %u replies in %.2f sec (%.0f/sec)\n",
+            window, REQUEST_COUNT, replies, elapsed, replies / elapsed);
+
+    check("  one reply per request", replies == REQUEST_COUNT);
+    check("  replies in request order", wrongOrder == 0);
+    check("  replies in the request's MSP version", wrongVersion == 0);
+    check("  framing and checksums valid", decoder.badFrames == 0 && decoder.leftover(board.received) == 0);
+    check("  no error replies", errors == 0);
+    check("  payloads correct", wrongPayload == 0);
+    check("  no received bytes dropped", board.getSerialDropCount() == 0);
+
+    return replies / elapsed;
+}
+
+static void subscribe(LoopbackBoard & board, uint8_t version, int32_t messageId, int32_t rate)
+{
+    uint8_t bytes[32];
+
+    board.send(bytes, version == 2 ?
+            hf::MspParser::serialize_SET_TELEMETRY_SUBSCRIPTION_V2(bytes, messageId, rate) :
+            hf::MspParser::serialize_SET_TELEMETRY_SUBSCRIPTION(bytes, messageId, rate));
+}
+
+static void testSubscription(float baud, uint8_t version)
+{
+    LoopbackVehicle vehicle(baud);
+    LoopbackBoard & board = vehicle.board;
+
+    vehicle.start();
+
+    subscribe(board, version, ATTITUDE_RADIANS, SUBSCRIPTION_RATE);
+
+    // A command, not a response, so it can't be pushed
+    subscribe(board, version, SET_TELEMETRY_SUBSCRIPTION, SUBSCRIPTION_RATE);
+
+    ResponseDecoder decoder;
+    response_t response = {};
+    uint32_t pushes = 0, wrongVersion = 0, wrongPayload = 0, refusals = 0, others = 0;
+
+    float start = board.time + SUBSCRIPTION_WARMUP;
+
+    for (float end=start+SUBSCRIPTION_TIME; board.time<end; ) {
+
+        vehicle.update();
+
+        while (decoder.next(board.received, response)) {
+
+            wrongVersion += response.version != version;
+
+            if (response.error && response.command == SET_TELEMETRY_SUBSCRIPTION) {
+                refusals++;
+            }
+            else if (response.command == ATTITUDE_RADIANS) {
+                pushes += board.time >= start;
+                wrongPayload += !payloadOk(response);
+            }
+            else {
+                others++;
+            }
+        }
+    }
+
+    // The frame around a 12-byte payload
+    float frameSize = 12 + (version == 2 ? 9 : 6);
+
+    float linkRate = baud / 10 / frameSize;
+
+    float expected = linkRate < SUBSCRIPTION_RATE ? linkRate : SUBSCRIPTION_RATE;
+
+    float rate = pushes / SUBSCRIPTION_TIME;
+
+    printf("Subscription at %.0f baud, MSPv%u: %.0f pushes/sec, expected %.0f\n", baud, version, rate, expected);
+
+    check("  pushed at the expected rate", fabsf(rate - expected) < 0.1f * expected);
+    check("  pushed in the client's MSP version", wrongVersion == 0 && decoder.badFrames == 0);
+    check("  payloads correct", wrongPayload == 0 && others == 0);
+    check("  bad subscription refused", refusals == 1);
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    float single = pipeline(1);
+    float pipelined = pipeline(8);
+    float deep = pipeline(32);
+
+    check("Pipelining raises throughput fivefold", pipelined > 5 * single && deep >= pipelined);
+
+    testSubscription(BAUD, 1);
+    testSubscription(BAUD, 2);
+    testSubscription(9600, 1);
+    testSubscription(9600, 2);
+
+    printf("%s\n", _ok ? "PASSED" : "FAILED");
+
+    return _ok ? 0 : 1;
+}
@@ -0,0 +1,381 @@
+/*
+   RealBoard whose USB port is wired to a simulated ground-control station,
+   on a simulated clock, for host tests of MSP over serial
+
+   Bytes from the GCS arrive at the line rate; replies reach the GCS as soon
+   as the board writes them.  Also decodes the replies, checking framing and
+   checksums independently of MspParser, and puts Hackflight on the board as
+   a LoopbackVehicle.
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <deque>
+#include <vector>
+
+// RealBoard's Arduino calls; the board below supplies its own clock
+static uint32_t micros(void) { return 0; }
+static void delay(uint32_t msec) { (void)msec; }
+
+#include "hackflight.hpp"
+#include "boards/realboard.hpp"
+#include "actuators/mixers/quadxcf.hpp"
+#include "pidcontrollers/rate.hpp"
+
+void hf::Board::outbuf(char * buf)
+{
+    fputs(buf, stdout);
+}
+
+class LoopbackBoard : public hf::RealBoard {
+
+    private:
+
+        typedef struct {
+
+            uint8_t value;
+            float   arrival;
+
+        } byte_t;
+
+        // Sent by the GCS, not yet read from the port
+        std::deque<byte_t> _line;
+
+        // When the line finishes sending the last byte queued on it
+        float _lineBusyUntil = 0;
+
+        float _baud = 0;
+
+    protected:
+
+        virtual void setLed(bool isOn) override
+        {
+            (void)isOn;
+        }
+
+        virtual float getTime(void) override
+        {
+            return time;
+        }
+
+        virtual uint32_t serialBaud(uint8_t port) override
+        {
+            (void)port;
+
+            return (uint32_t)_baud;
+        }
+
+        virtual uint16_t serialPortAvailable(uint8_t port) override
+        {
+            (void)port;
+
+            uint16_t count = 0;
+
+            for (const byte_t & b : _line) {
+                if (b.arrival > time || count == 0xFFFF) {
+                    break;
+                }
+                count++;
+            }
+
+            return count;
+        }
+
+        virtual uint16_t serialPortRead(uint8_t port, uint8_t * buf, uint16_t count) override
+        {
+            (void)port;
+
+            for (uint16_t k=0; k<count; ++k) {
+                buf[k] = _line.front().value;
+                _line.pop_front();
+            }
+
+            return count;
+        }
+
+        virtual void serialPortWrite(uint8_t port, const uint8_t * buf, uint16_t count) override
+        {
+            (void)port;
+
+            received.insert(received.end(), buf, buf+count);
+        }
+
+        virtual uint16_t serialRead(uint8_t port, uint8_t * buf, uint16_t count) override
+        {
+            uint16_t read = hf::RealBoard::serialRead(port, buf, count);
+
+            bytesParsed += read;
+
+            return read;
+        }
+
+    public:
+
+        float time = 0;
+
+        // Replies to the GCS, in the order written
+        std::vector<uint8_t> received;
+
+        // Bytes handed from the receive ring to the serial task
+        uint32_t bytesParsed = 0;
+
+        LoopbackBoard(float baud)
+            : _baud(baud)
+        {
+            RealBoard::init();
+        }
+
+        // Queues bytes from the GCS; each takes ten bit times on the line
+        void send(const uint8_t * buf, uint16_t count)
+        {
+            float start = _lineBusyUntil > time ? _lineBusyUntil : time;
+
+            for (uint16_t k=0; k<count; ++k) {
+                start += 10 / _baud;
+                _line.push_back({buf[k], start});
+            }
+
+            _lineBusyUntil = start;
+        }
+
+}; // class LoopbackBoard
+
+// A reply as the GCS sees it
+typedef struct {
+
+    uint8_t  version;
+    bool     error;
+    uint16_t command;
+    uint16_t size;
+    uint8_t  payload[256];
+
+} response_t;
+
+class ResponseDecoder {
+
+    private:
+
+        size_t _offset = 0;
+
+        static uint8_t crc8(uint8_t crc, uint8_t a)
+        {
+            crc ^= a;
+
+            for (uint8_t k=0; k<8; ++k) {
+                crc = (crc & 0x80) ? (crc << 1) ^ 0xD5 : crc << 1;
+            }
+
+            return crc;
+        }
+
+    public:
+
+        uint32_t badFrames = 0;
+
+        // Takes the next complete reply from the bytes received so far; skips past a malformed one, counting it
+        bool next(const std::vector<uint8_t> & bytes, response_t & response)
+        {
+            while (true) {
+
+                size_t count = bytes.size() - _offset;
+
+                if (count < 6) {
+                    return false;
+                }
+
+                const uint8_t * buf = &bytes[_offset];
+
+                bool v2 = buf[1] == 'X';
+
+                if (buf[0] != '$' || (buf[1] != 'M' && !v2) || (buf[2] != '>' && buf[2] != '!')) {
+                    badFrames++;
+                    _offset++;
+                    continue;
+                }
+
+                uint16_t headerSize = v2 ? 8 : 5;
+
+                if (count < headerSize) {
+                    return false;
+                }
+
+                response.version = v2 ? 2 : 1;
+                response.error   = buf[2] == '!';
+                response.command = v2 ? buf[4] | (buf[5] << 8) : buf[4];
+                response.size    = v2 ? buf[6] | (buf[7] << 8) : buf[3];
+
+                if (count < headerSize + response.size + 1u) {
+                    return false;
+                }
+
+                uint8_t checksum = 0;
+
+                for (uint16_t k=3; k<headerSize+response.size; ++k) {
+                    checksum = v2 ? crc8(checksum, buf[k]) : checksum ^ buf[k];
+                }
+
+                if (checksum != buf[headerSize+response.size] || response.size > sizeof(response.payload)) {
+                    badFrames++;
+                    _offset++;
+                    continue;
+                }
+
+                memcpy(response.payload, &buf[headerSize], response.size);
+
+                _offset += headerSize + response.size + 1;
+
+                return true;
+            }
+        }
+
+        // Bytes received but not yet part of a complete reply
+        size_t leftover(const std::vector<uint8_t> & bytes)
+        {
+            return bytes.size() - _offset;
+        }
+
+}; // class ResponseDecoder
+
+// Level except for this roll, so attitude replies can be checked
+static const float ROLL = 0.25;
+
+class HostIMU : public hf::IMU {
+
+    public:
+
+        virtual bool getGyrometer(float & gx, float & gy, float & gz) override
+        {
+            gx = 0;
+            gy = 0;
+            gz = 0;
+
+            return true;
+        }
+
+        virtual bool getQuaternion(float & qw, float & qx, float & qy, float & qz, float time) override
+        {
+            (void)time;
+
+            qw = cosf(ROLL/2);
+            qx = sinf(ROLL/2);
+            qy = 0;
+            qz = 0;
+
+            return true;
+        }
+};
+
+// Disarmed, with throttle down
+class HostReceiver : public hf::Receiver {
+
+    private:
+
+        static constexpr uint8_t CHANNEL_MAP[6] = {0, 1, 2, 3, 4, 5};
+
+    protected:
+
+        virtual bool gotNewFrame(void) override
+        {
+            return true;
+        }
+
+        virtual void readRawvals(void) override
+        {
+            rawvals[0] = -1;
+            rawvals[4] = -1;
+        }
+
+        virtual bool lostSignal(void) override
+        {
+            return false;
+        }
+
+    public:
+
+        HostReceiver(void)
+            : hf::Receiver(CHANNEL_MAP)
+        {
+        }
+};
+
+constexpr uint8_t HostReceiver::CHANNEL_MAP[6];
+
+class NullMotor : public hf::Motor {
+
+    public:
+
+        NullMotor(void) : hf::Motor(0) { }
+
+        virtual void write(float value) override
+        {
+            (void)value;
+        }
+};
+
+// Hackflight on a LoopbackBoard, disarmed and level but for its roll, running a rate PID controller
+class LoopbackVehicle {
+
+    private:
+
+        static constexpr float STARTUP_TIME = 2.5; // sec; the board flashes its LED for two
+
+        hf::Hackflight _h;
+
+        HostIMU _imu;
+        HostReceiver _receiver;
+        hf::MixerQuadXCF _mixer;
+
+        NullMotor _motor1, _motor2, _motor3, _motor4;
+        hf::Motor * _motors[4] = {&_motor1, &_motor2, &_motor3, &_motor4};
+
+    public:
+
+        // Simulated time between calls to Hackflight::update()
+        static constexpr float UPDATE_PERIOD = 0.0005; // sec
+
+        LoopbackBoard board;
+
+        hf::RatePid ratePid;
+
+        LoopbackVehicle(float baud)
+            : board(baud), ratePid(0.05f, 0.00f, 0.00f, 0.10f, 0.01f)
+        {
+            _h.init(&board, &_imu, &_receiver, &_mixer, _motors);
+            _h.addPidController(&ratePid);
+        }
+
+        void update(void)
+        {
+            _h.update();
+
+            board.time += UPDATE_PERIOD;
+        }
+
+        // Runs until the vehicle is ready to arm
+        void start(void)
+        {
+            while (board.time < STARTUP_TIME) {
+                update();
+            }
+        }
+
+}; // class LoopbackVehicle
@@ -0,0 +1,143 @@
+/*
+   Host benchmark for the generated MSP parser
+
+   Pipelines a mix of requests and commands through the parser and drains the
+   responses, reporting messages handled per second when input is parsed a
+   byte at a time and in blocks
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as 
+   published by the Free Software Foundation, either version 3 of the 
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,     
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License 
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "mspparser.hpp"
+
+class BenchmarkParser : public hf::MspParser {
+
+    public:
+
+        uint32_t handled = 0;
+        uint32_t responseBytes = 0;
+        float motorSum = 0;
+
+        BenchmarkParser(void)
+        {
+            MspParser::init();
+        }
+
+        void run(const std::vector<uint8_t> & input)
+        {
+            for (size_t k=0; k<input.size(); ++k) {
+                MspParser::parse(input[k]);
+                while (MspParser::availableBytes() > 0) {
+                    responseBytes += MspParser::readByte();
+                }
+            }
+        }
+
+        // Feeds input in blocks, as SerialTask does
+        void runBulk(const std::vector<uint8_t> & input, size_t blockSize)
+        {
+            for (size_t k=0; k<input.size(); ) {
+
+                size_t count = input.size() - k < blockSize ? input.size() - k : blockSize;
+
+                while (count > 0) {
+
+                    size_t parsed = MspParser::parse(&input[k], count);
+                    k += parsed;
+                    count -= parsed;
+
+                    while (MspParser::availableBytes() > 0) {
+                        uint16_t n = 0;
+                        const uint8_t * bytes = MspParser::peekOutput(n);
+                        for (uint16_t j=0; j<n; ++j) {
+                            responseBytes += bytes[j];
+                        }
+                        MspParser::consumeOutput(n);
+                    }
+                }
+            }
+        }
+
+    protected:
+
+        virtual void handle_STATE_Request(float & altitude, float & variometer, float & positionX, float & positionY, 
+                float & heading, float & velocityForward, float & velocityRightward) override
+        {
+            altitude = variometer = positionX = positionY = velocityForward = velocityRightward = 0;
+            heading = handled++;
+        }
+
+        virtual void handle_ATTITUDE_RADIANS_Request(float & roll, float & pitch, float & yaw) override
+        {
+            roll = pitch = 0;
+            yaw = handled++;
+        }
+
+        virtual void handle_SET_MOTOR_NORMAL(float  m1, float  m2, float  m3, float  m4) override
+        {
+            motorSum += m1 + m2 + m3 + m4;
+            handled++;
+        }
+
+}; // class BenchmarkParser
+
+static void append(std::vector<uint8_t> & input, const uint8_t * bytes, uint16_t count)
+{
+    input.insert(input.end(), bytes, bytes + count);
+}
+
+int main(void)
+{
+    static const uint32_t ROUNDS = 20000;
+    static const uint32_t PASSES = 20;
+
+    std::vector<uint8_t> input;
+    uint8_t bytes[64];
+
+    for (uint32_t k=0; k<ROUNDS; ++k) {
+        append(input, bytes, hf::MspParser::serialize_ATTITUDE_RADIANS_Request(bytes));
+        append(input, bytes, hf::MspParser::serialize_STATE_Request(bytes));
+        append(input, bytes, hf::MspParser::serialize_SET_MOTOR_NORMAL(bytes, .1, .2, .3, .4));
+        append(input, bytes, hf::MspParser::serialize_ATTITUDE_RADIANS_Request_V2(bytes));
+        append(input, bytes, hf::MspParser::serialize_SET_MOTOR_NORMAL_V2(bytes, .1, .2, .3, .4));
+    }
+
+    for (uint8_t bulk=0; bulk<2; ++bulk) {
+
+        BenchmarkParser parser;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t k=0; k<PASSES; ++k) {
+            if (bulk) {
+                parser.runBulk(input, 128);
+            }
+            else {
+                parser.run(input);
+            }
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%s: %u messages in %3.3f sec: %3.0f messages/sec (check %u %u)\n", bulk ? "block" : "byte ",
+                parser.handled, elapsed, parser.handled / elapsed, parser.responseBytes, (uint32_t)parser.motorSum);
+    }
+
+    return 0;
+}
@@ -193,6 +193,28 @@ class Python_Emitter(LocalCodeEmitter):
                 self._write(self.indent+'msg = \'$M<\' + chr(0) + chr(%s) + chr(%s)\n' % (msgid, msgid))
                 self._write(self.indent+'return bytes(msg) if sys.version[0] == \'2\' else bytes(msg, \'utf-8\')\n\n')
 
+                self._write('def serialize_' + msgtype + '_Request_V2():\n\n')
+                self._write(self.indent + "'''\n")
+                self._write(self.indent + 'Serializes an MSPv2 request for ' + msgtype + ' data.\n')
+                self._write(self.indent + "'''\n")
+                self._write(self.indent + 'msg = [0, %d, %d, 0, 0]\n' % (msgid & 0xFF, msgid >> 8))
+                self._write(self.indent + 'return bytes(bytearray([ord(\'$\'), ord(\'X\'), ord(\'<\')] + msg + [_CRC8_DVB_S2(msg)]))\n\n')
+
+            self._write('def serialize_' + msgtype + '_V2(' + ', '.join(self._getargnames(msgstuff)) + '):\n')
+            self._write(self.indent + "'''\n")
+            self._write(self.indent + 'Serializes the contents of an MSPv2 message of type ' + msgtype + '.\n')
+            self._write(self.indent + "'''\n")
+            self._write(self.indent + 'message_buffer = struct.pack(\'<')
+            for argtype in self._getargtypes(msgstuff):
+                self._write(self.type2pack[argtype])
+            self._write('\'')
+            for argname in self._getargnames(msgstuff):
+                self._write(', ' + argname)
+            self._write(')\n')
+            self._write(self.indent + 'size = len(message_buffer)\n')
+            self._write(self.indent + 'msg = [0, %d, %d, size & 0xFF, size >> 8] + list(bytearray(message_buffer))\n' % (msgid & 0xFF, msgid >> 8))
+            self._write(self.indent + 'return bytes(bytearray([ord(\'$\'), ord(\'X\'), ord(\'%c\')] + msg + [_CRC8_DVB_S2(msg)]))\n\n' % ('>' if msgid < 200 else '<'))
+
 
     def _write(self, s):
 
@@ -216,11 +238,23 @@ class HPP_Emitter(CodeEmitter):
         # Open file for appending
         self.output = open('../../src/mspparser.hpp', 'a')
 
-        # Add dispatchMessage() method
+        # Add payload structs; since each message has a uniform type, they have no padding
 
-        self.output.write(3*self.indent + 'void dispatchMessage(void)\n')
-        self.output.write(3*self.indent + '{\n')
-        self.output.write(4*self.indent + 'switch (_command) {\n\n')
+        for msgtype in msgdict.keys():
+
+            msgstuff = msgdict[msgtype]
+
+            argnames = self._getargnames(msgstuff)
+            argtypes = self._getargtypes(msgstuff)
+
+            self.output.write(3*self.indent + 'typedef struct {\n\n')
+            for (argname,argtype) in zip(argnames, argtypes):
+                self.output.write(4*self.indent + '%s %s;\n' % (self.type2decl[argtype], argname))
+            self.output.write('\n' + 3*self.indent + '} payload_%s_t;\n\n' % msgtype)
+            self.output.write(3*self.indent + 'static_assert(sizeof(payload_%s_t) == %d, "Padded payload");\n\n' % 
+                    (msgtype, self._paysize(argtypes)))
+
+        # Add a dispatch method for each message, reading commands in place and sending responses whole
 
         for msgtype in msgdict.keys():
 
@@ -228,37 +262,48 @@ class HPP_Emitter(CodeEmitter):
             msgid = msgstuff[0]
 
             argnames = self._getargnames(msgstuff)
-            argtypes = self._getargtypes(msgstuff)
 
-            self.output.write(5*self.indent + ('case %s:\n' % msgdict[msgtype][0]))
-            self.output.write(5*self.indent + '{\n')
-            nargs = len(argnames)
-            offset = 0
-            for k in range(nargs):
-                argname = argnames[k]
-                argtype = argtypes[k]
-                decl = self.type2decl[argtype]
-                self.output.write(6*self.indent + decl  + ' ' + argname + ' = 0;\n')
-                if msgid >= 200:
-                    self.output.write(6*self.indent + 'memcpy(&%s,  &_inBuf[%d], sizeof(%s));\n\n' % (argname, offset, decl))
-                offset += self.type2size[argtype]
-            self.output.write(6*self.indent + 'handle_%s%s(' % (msgtype, '_Request' if msgid<200 else ''))
-            for k in range(nargs):
-                self.output.write(argnames[k])
-                if k < nargs-1:
-                    self.output.write(', ')
-            self.output.write(');\n')
+            self.output.write(3*self.indent + 'static void dispatch_%s(MspParser * parser)\n' % msgtype)
+            self.output.write(3*self.indent + '{\n')
+
             if msgid < 200:
-                argtype = argtypes[0].capitalize() # XXX enforce uniform type for now
-                self.output.write(6*self.indent + ('prepareToSend%ss(%d);\n' % (argtype, nargs)))
-                for argname in argnames:
-                    self.output.write(6*self.indent + ('send%s(%s);\n' % (argtype, argname)))
-                self.output.write(6*self.indent + "serialize8(_checksum);\n")
-            self.output.write(6*self.indent + '} break;\n\n')
-
-        self.output.write(4*self.indent + '}\n')
+                self.output.write(4*self.indent + 'payload_%s_t payload = {};\n\n' % msgtype)
+                self.output.write(4*self.indent + 'parser->_handler->handle_%s_Request(' % msgtype)
+                self.output.write(', '.join(['payload.' + argname for argname in argnames]) + ');\n\n')
+                self.output.write(4*self.indent + 'parser->sendResponse(&payload, sizeof(payload));\n')
+            else:
+                self.output.write(4*self.indent + 
+                        'const payload_%s_t * payload = (const payload_%s_t *)parser->_inBuf;\n\n' % (msgtype, msgtype))
+                self.output.write(4*self.indent + 'parser->_handler->handle_%s(' % msgtype)
+                self.output.write(', '.join(['payload->' + argname for argname in argnames]) + ');\n')
+
+            self.output.write(3*self.indent + '}\n\n')
+
+        # Add descriptor table, sorted by ID for binary search
+
+        self.output.write(3*self.indent + 'static const uint8_t MESSAGE_COUNT = %d;\n\n' % len(msgdict))
+        self.output.write(3*self.indent + 'static const messageDescriptor_t * messageTable(void)\n')
+        self.output.write(3*self.indent + '{\n')
+        self.output.write(4*self.indent + 'static constexpr messageDescriptor_t MESSAGES[MESSAGE_COUNT] = {\n\n')
+        for msgtype in sorted(msgdict.keys(), key=lambda msgtype: msgdict[msgtype][0]):
+            msgstuff = msgdict[msgtype]
+            msgid = msgstuff[0]
+            self.output.write(5*self.indent + '{%d, %d, %s, &MspParser::dispatch_%s},\n' % 
+                    (msgid, self._paysize(self._getargtypes(msgstuff)), 'true' if msgid < 200 else 'false', msgtype))
+        self.output.write(4*self.indent + '};\n\n')
+        self.output.write(4*self.indent + 'return MESSAGES;\n')
         self.output.write(3*self.indent + '}\n\n')
 
+        # Add size of largest response, so parsing can wait for room in the output queue
+
+        maxpaysize = max([self._paysize(self._getargtypes(msgdict[msgtype]))
+            for msgtype in msgdict.keys() if msgdict[msgtype][0] < 200])
+
+        self.output.write(3*self.indent + '// Largest response frame, using the larger MSPv2 framing\n')
+        self.output.write(3*self.indent + 'static const uint16_t MAX_RESPONSE_SIZE = %d;\n\n' % (maxpaysize + 9))
+        self.output.write(3*self.indent + 
+                'static_assert(MAX_RESPONSE_SIZE <= OUTBUF_SIZE, "Output queue can\'t hold largest response");\n\n')
+
         # Add virtual declarations for handler methods
 
         for msgtype in msgdict.keys():
@@ -327,11 +372,46 @@ class HPP_Emitter(CodeEmitter):
                     'bytes[%d] = CRC8(&bytes[3], %d);\n\n' % (msgsize+5, msgsize+2))
             self.output.write(4*self.indent + 'return %d;\n'% (msgsize+6))
             self.output.write(3*self.indent + '}\n\n')
+
+            # MSPv2 versions of the above
+            if msgid < 200:
+                self._write_v2_serializer(msgtype, msgid, '_Request', 60, [], [])
+            self._write_v2_serializer(msgtype, msgid, '', 62 if msgid < 200 else 60, argtypes, argnames)
  
         self.output.write(self.indent + '}; // class MspParser\n\n')
         self.output.write('} // namespace hf\n')
         self.output.close()
 
+    def _write_v2_serializer(self, msgtype, msgid, suffix, direction, argtypes, argnames):
+
+        paysize = self._paysize(argtypes)
+
+        self.output.write(3*self.indent + 'static uint16_t serialize_%s%s_V2' % (msgtype, suffix))
+        if len(argnames) > 0:
+            self._write_params(self.output, argtypes, argnames, '(uint8_t bytes[], ')
+        else:
+            self.output.write('(uint8_t bytes[])')
+        self.output.write('\n' + 3*self.indent + '{\n')
+        self.output.write(4*self.indent + 'bytes[0] = 36;\n')
+        self.output.write(4*self.indent + 'bytes[1] = 88;\n')
+        self.output.write(4*self.indent + 'bytes[2] = %d;\n' % direction)
+        self.output.write(4*self.indent + 'bytes[3] = 0;\n')
+        self.output.write(4*self.indent + 'bytes[4] = %d;\n' % (msgid & 0xFF))
+        self.output.write(4*self.indent + 'bytes[5] = %d;\n' % (msgid >> 8))
+        self.output.write(4*self.indent + 'bytes[6] = %d;\n' % (paysize & 0xFF))
+        self.output.write(4*self.indent + 'bytes[7] = %d;\n\n' % (paysize >> 8))
+        offset = 8
+        for (argname,argtype) in zip(argnames, argtypes):
+            self.output.write(4*self.indent + 
+                    'memcpy(&bytes[%d], &%s, sizeof(%s));\n' %  (offset, argname, self.type2decl[argtype]))
+            offset += self.type2size[argtype]
+        if len(argnames) > 0:
+            self.output.write('\n')
+        self.output.write(4*self.indent + 
+                'bytes[%d] = CRC8_DVB_S2(&bytes[3], %d);\n\n' % (paysize+8, paysize+5))
+        self.output.write(4*self.indent + 'return %d;\n'% (paysize+9))
+        self.output.write(3*self.indent + '}\n\n')
+
 
 # Java emitter =======================================================================================
 
@@ -413,6 +493,28 @@ class Java_Emitter(CompileableCodeEmitter):
                 self._write(' { \n')
                 self._write(self.indent + '}\n\n')
 
+            # For messages to FC
+            else:
+
+                # Write serializer for commands
+                self._write(self.indent + 'public byte [] serialize_%s' % msgtype)
+                self._write_params(self.output, argtypes, argnames)
+                self._write(' {\n\n')
+                paysize = self._paysize(argtypes)
+                self._write(2*self.indent + 'ByteBuffer bb = newByteBuffer(%d);\n\n' % paysize)
+                for (argname,argtype) in zip(argnames,argtypes):
+                    self._write(2*self.indent + 'bb.put%s(%s);\n' % (self.type2bb[argtype], argname))
+                self._write('\n' + 2*self.indent + 'byte [] message = new byte[%d];\n\n' % (paysize+6))
+                self._write(2*self.indent + 'message[0] = 36;\n')
+                self._write(2*self.indent + 'message[1] = 77;\n')
+                self._write(2*self.indent + 'message[2] = 60;\n')
+                self._write(2*self.indent + 'message[3] = %d;\n' % paysize)
+                self._write(2*self.indent + 'message[4] = (byte)%d;\n' % msgid)
+                self._write(2*self.indent + 'System.arraycopy(bb.array(), 0, message, 5, %d);\n' % paysize)
+                self._write(2*self.indent + 'message[%d] = CRC8(message, 3, %d);\n\n' % (paysize+5, paysize+5))
+                self._write(2*self.indent + 'return message;\n')
+                self._write(self.indent + '}\n\n')
+
         self._write('}\n')
 
     def _write(self, s):
@@ -27,18 +27,31 @@
 #include <stdint.h>
 #include <string.h>
 
+// Largest MSPv2 payload accepted; MSPv1 payloads are limited to 255 bytes by their framing
+#ifndef HF_MSP_MAX_PAYLOAD
+#define HF_MSP_MAX_PAYLOAD 256
+#endif
+
 namespace hf {
 
     class MspParser {
 
+        friend class SerialTask;
+
         public:
 
             static const uint8_t MAXMSG = 255;
 
         private:
 
-            static const int INBUF_SIZE  = 128;
-            static const int OUTBUF_SIZE = 128;
+            static const uint16_t INBUF_SIZE = HF_MSP_MAX_PAYLOAD;
+
+            // Output is a ring of framed responses, so replies to pipelined requests aren't lost
+            static const uint16_t OUTBUF_SIZE = 256;
+
+            // Framing overhead: $M>, size, command, checksum for v1; $X>, flag, command, size, CRC for v2
+            static const uint8_t V1_OVERHEAD = 6;
+            static const uint8_t V2_OVERHEAD = 9;
 
             typedef enum serialState_t {
                 IDLE,
@@ -46,26 +59,49 @@ namespace hf {
                 HEADER_M,
                 HEADER_ARROW,
                 HEADER_SIZE,
-                HEADER_CMD
+                HEADER_CMD,
+                V2_HEADER,
+                V2_PAYLOAD,
+                V2_CHECKSUM
             } serialState_t;
 
-            uint8_t _checksum;
-            uint8_t _inBuf[INBUF_SIZE];
-            uint8_t _inBufIndex;
+            uint8_t _checksum;    // response being serialized
+            uint8_t _inChecksum;  // request being parsed
+            alignas(4) uint8_t _inBuf[INBUF_SIZE]; // command payloads are read in place
             uint8_t _outBuf[OUTBUF_SIZE];
-            uint8_t _outBufIndex;
-            uint8_t _outBufSize;
-            uint8_t _command;
-            uint8_t _offset;
-            uint8_t _dataSize;
+            uint16_t _outBufHead;
+            uint16_t _outBufTail;
+            uint16_t _outBufCount;
+            uint32_t _droppedResponseCount;
+            typedef struct {
+
+                uint16_t id;
+                uint16_t payloadSize;
+                bool     isRequest;
+                void (*dispatch)(MspParser * parser);
+
+            } messageDescriptor_t;
+
+            uint16_t _command;
+            uint16_t _offset;
+            uint16_t _dataSize;
             uint8_t _direction;
 
+            // Version of request being parsed, and of responses (which follow the latest request)
+            uint8_t _version;
+            uint8_t _responseVersion;
+
             serialState_t  _state;
 
+            // Receives the handle_ calls, so several parsers (one per port) can share one set of handlers
+            MspParser * _handler;
+
             void serialize8(uint8_t a)
             {
-                _outBuf[_outBufSize++] = a;
-                _checksum ^= a;
+                _outBuf[_outBufHead] = a;
+                _outBufHead = (_outBufHead + 1) % OUTBUF_SIZE;
+                _outBufCount++;
+                _checksum = (_responseVersion == 2) ? crc8_dvb_s2(_checksum, a) : _checksum ^ a;
             }
 
             void serialize16(int16_t a)
@@ -82,84 +118,229 @@ namespace hf {
                 serialize8((a >> 24) & 0xFF);
             }
 
-            void headSerialResponse(uint8_t err, uint8_t s)
+            void headSerialResponse(uint8_t err, uint16_t s)
             {
                 serialize8('$');
-                serialize8('M');
+                serialize8(_responseVersion == 2 ? 'X' : 'M');
                 serialize8(err ? '!' : '>');
                 _checksum = 0;               // start calculating a new _checksum
-                serialize8(s);
-                serialize8(_command);
+
+                if (_responseVersion == 2) {
+                    serialize8(0);           // flag
+                    serialize16(_command);
+                    serialize16(s);
+                }
+                else {
+                    serialize8(s);
+                    serialize8(_command);
+                }
             }
 
-            void headSerialReply(uint8_t s)
+            void headSerialReply(uint16_t s)
             {
                 headSerialResponse(0, s);
             }
 
-            void prepareToSend(uint8_t count, uint8_t size)
+            uint8_t frameOverhead(void)
             {
-                _outBufSize = 0;
-                _outBufIndex = 0;
-                headSerialReply(count*size);
+                return _responseVersion == 2 ? V2_OVERHEAD : V1_OVERHEAD;
             }
 
-            void prepareToSendBytes(uint8_t count)
+            // Copies a response payload into the output queue
+            void sendResponse(const void * payload, uint16_t size)
             {
-                prepareToSend(count, 1);
-            }
+                // Drop the whole response, rather than part of it, if it won't fit
+                if (outputSpace() < size + frameOverhead()) {
+                    _droppedResponseCount++;
+                    return;
+                }
 
-            void sendByte(uint8_t src)
-            {
-                serialize8(src);
+                headSerialReply(size);
+
+                const uint8_t * bytes = (const uint8_t *)payload;
+
+                // Copying and checksumming together is faster than memcpy for payloads this small
+                uint8_t checksum = _checksum;
+
+                if (_responseVersion == 2) {
+                    for (uint16_t k=0; k<size; ++k) {
+                        _outBuf[(_outBufHead + k) % OUTBUF_SIZE] = bytes[k];
+                        checksum = crc8_dvb_s2(checksum, bytes[k]);
+                    }
+                }
+                else {
+                    for (uint16_t k=0; k<size; ++k) {
+                        _outBuf[(_outBufHead + k) % OUTBUF_SIZE] = bytes[k];
+                        checksum ^= bytes[k];
+                    }
+                }
+
+                _outBufHead = (_outBufHead + size) % OUTBUF_SIZE;
+                _outBufCount += size;
+
+                serialize8(checksum);
             }
 
-            void prepareToSendShorts(uint8_t count)
+            static uint8_t CRC8(uint8_t * data, int n) 
             {
-                prepareToSend(count, 2);
+                uint8_t crc = 0x00;
+
+                for (int k=0; k<n; ++k) {
+
+                    crc ^= data[k];
+                }
+
+                return crc;
             }
 
-            void sendShort(short src)
+            // CRC-8 with polynomial 0xD5, as used by MSPv2
+            static uint8_t crc8_dvb_s2(uint8_t crc, uint8_t a)
             {
-                int16_t a;
-                memcpy(&a, &src, 2);
-                serialize16(a);
+                static const uint8_t TABLE[256] = {
+                    0x00, 0xd5, 0x7f, 0xaa, 0xfe, 0x2b, 0x81, 0x54,
+                    0x29, 0xfc, 0x56, 0x83, 0xd7, 0x02, 0xa8, 0x7d,
+                    0x52, 0x87, 0x2d, 0xf8, 0xac, 0x79, 0xd3, 0x06,
+                    0x7b, 0xae, 0x04, 0xd1, 0x85, 0x50, 0xfa, 0x2f,
+                    0xa4, 0x71, 0xdb, 0x0e, 0x5a, 0x8f, 0x25, 0xf0,
+                    0x8d, 0x58, 0xf2, 0x27, 0x73, 0xa6, 0x0c, 0xd9,
+                    0xf6, 0x23, 0x89, 0x5c, 0x08, 0xdd, 0x77, 0xa2,
+                    0xdf, 0x0a, 0xa0, 0x75, 0x21, 0xf4, 0x5e, 0x8b,
+                    0x9d, 0x48, 0xe2, 0x37, 0x63, 0xb6, 0x1c, 0xc9,
+                    0xb4, 0x61, 0xcb, 0x1e, 0x4a, 0x9f, 0x35, 0xe0,
+                    0xcf, 0x1a, 0xb0, 0x65, 0x31, 0xe4, 0x4e, 0x9b,
+                    0xe6, 0x33, 0x99, 0x4c, 0x18, 0xcd, 0x67, 0xb2,
+                    0x39, 0xec, 0x46, 0x93, 0xc7, 0x12, 0xb8, 0x6d,
+                    0x10, 0xc5, 0x6f, 0xba, 0xee, 0x3b, 0x91, 0x44,
+                    0x6b, 0xbe, 0x14, 0xc1, 0x95, 0x40, 0xea, 0x3f,
+                    0x42, 0x97, 0x3d, 0xe8, 0xbc, 0x69, 0xc3, 0x16,
+                    0xef, 0x3a, 0x90, 0x45, 0x11, 0xc4, 0x6e, 0xbb,
+                    0xc6, 0x13, 0xb9, 0x6c, 0x38, 0xed, 0x47, 0x92,
+                    0xbd, 0x68, 0xc2, 0x17, 0x43, 0x96, 0x3c, 0xe9,
+                    0x94, 0x41, 0xeb, 0x3e, 0x6a, 0xbf, 0x15, 0xc0,
+                    0x4b, 0x9e, 0x34, 0xe1, 0xb5, 0x60, 0xca, 0x1f,
+                    0x62, 0xb7, 0x1d, 0xc8, 0x9c, 0x49, 0xe3, 0x36,
+                    0x19, 0xcc, 0x66, 0xb3, 0xe7, 0x32, 0x98, 0x4d,
+                    0x30, 0xe5, 0x4f, 0x9a, 0xce, 0x1b, 0xb1, 0x64,
+                    0x72, 0xa7, 0x0d, 0xd8, 0x8c, 0x59, 0xf3, 0x26,
+                    0x5b, 0x8e, 0x24, 0xf1, 0xa5, 0x70, 0xda, 0x0f,
+                    0x20, 0xf5, 0x5f, 0x8a, 0xde, 0x0b, 0xa1, 0x74,
+                    0x09, 0xdc, 0x76, 0xa3, 0xf7, 0x22, 0x88, 0x5d,
+                    0xd6, 0x03, 0xa9, 0x7c, 0x28, 0xfd, 0x57, 0x82,
+                    0xff, 0x2a, 0x80, 0x55, 0x01, 0xd4, 0x7e, 0xab,
+                    0x84, 0x51, 0xfb, 0x2e, 0x7a, 0xaf, 0x05, 0xd0,
+                    0xad, 0x78, 0xd2, 0x07, 0x53, 0x86, 0x2c, 0xf9
+                };
+
+                return TABLE[crc ^ a];
             }
 
-            void prepareToSendInts(uint8_t count)
+            static uint8_t CRC8_DVB_S2(uint8_t * data, int n) 
             {
-                prepareToSend(count, 4);
+                uint8_t crc = 0x00;
+
+                for (int k=0; k<n; ++k) {
+
+                    crc = crc8_dvb_s2(crc, data[k]);
+                }
+
+                return crc;
             }
 
-            void sendInt(int32_t src)
+            static const messageDescriptor_t * findMessage(uint16_t id)
             {
-                int32_t a;
-                memcpy(&a, &src, 4);
-                serialize32(a);
+                const messageDescriptor_t * message = messageTable();
+
+                // Binary search without branches on the comparisons, which are unpredictable
+                for (uint8_t count = MESSAGE_COUNT; count > 1; ) {
+                    uint8_t half = count / 2;
+                    message = (message[half].id <= id) ? &message[half] : message;
+                    count -= half;
+                }
+
+                return (message->id == id) ? message : NULL;
             }
 
-            void prepareToSendFloats(uint8_t count)
+            void dispatchMessage(void)
             {
-                prepareToSend(count, 4);
+                const messageDescriptor_t * message = findMessage(_command);
+
+                // Commands are read in place, so they must carry a full payload
+                if (message && (message->isRequest || _dataSize == message->payloadSize)) {
+                    message->dispatch(this);
+                }
             }
 
-            void sendFloat(float src)
+            // Response payload size, or -1 for commands and unknown messages
+            static int32_t responsePayloadSize(uint16_t command)
             {
-                uint32_t a;
-                memcpy(&a, &src, 4);
-                serialize32(a);
+                const messageDescriptor_t * message = findMessage(command);
+
+                return (message && message->isRequest) ? message->payloadSize : -1;
             }
 
-            static uint8_t CRC8(uint8_t * data, int n) 
+            // Handles a frame that starts at buf[0] and is complete within count bytes, returning its size;
+            // returns zero if the frame is incomplete or its header is malformed
+            size_t parseFrame(const uint8_t * buf, size_t count)
             {
-                uint8_t crc = 0x00;
+                if (count < V1_OVERHEAD || (buf[2] != '<' && buf[2] != '>')) {
+                    return 0;
+                }
 
-                for (int k=0; k<n; ++k) {
+                uint8_t version = 0;
+                uint16_t dataSize = 0;
+                uint16_t headerSize = 0;
 
-                    crc ^= data[k];
+                if (buf[1] == 'M') {
+                    version = 1;
+                    dataSize = buf[3];
+                    headerSize = 5;
+                }
+                else if (buf[1] == 'X' && count >= V2_OVERHEAD) {
+                    version = 2;
+                    dataSize = buf[6] | (buf[7] << 8);
+                    headerSize = 8;
+                }
+                else {
+                    return 0;
                 }
 
-                return crc;
+                size_t frameSize = headerSize + dataSize + 1;
+
+                if (dataSize > INBUF_SIZE || frameSize > count) {
+                    return 0;
+                }
+
+                uint8_t checksum = 0;
+
+                if (version == 2) {
+                    for (uint16_t k=3; k<headerSize+dataSize; ++k) {
+                        checksum = crc8_dvb_s2(checksum, buf[k]);
+                    }
+                }
+                else {
+                    for (uint16_t k=3; k<headerSize+dataSize; ++k) {
+                        checksum ^= buf[k];
+                    }
+                }
+
+                // Like the state machine, drop a frame whose checksum fails
+                if (checksum == buf[frameSize-1]) {
+                    _version = version;
+                    _direction = buf[2] == '>';
+                    _command = (version == 2) ? (buf[4] | (buf[5] << 8)) : buf[4];
+                    _dataSize = dataSize;
+                    memcpy(_inBuf, &buf[headerSize], dataSize); // aligned for reading in place
+                    dispatchRequest();
+                }
+
+                return frameSize;
+            }
+
+            // Responses go out in the version of the request
+            void dispatchRequest(void)
+            {
+                _responseVersion = _version;
+                dispatchMessage();
             }
 
         protected:
@@ -167,23 +348,119 @@ namespace hf {
             void init(void)
             {
                 _checksum = 0;
-                _outBufIndex = 0;
-                _outBufSize = 0;
+                _inChecksum = 0;
+                _outBufHead = 0;
+                _outBufTail = 0;
+                _outBufCount = 0;
+                _droppedResponseCount = 0;
                 _command = 0;
                 _offset = 0;
                 _dataSize = 0;
+                _version = 1;
+                _responseVersion = 1;
                 _state = IDLE;
+                _handler = this;
+            }
+
+            void setHandler(MspParser * handler)
+            {
+                _handler = handler;
+            }
+
+            // Abandons any partly-parsed frame, as at the start of a datagram
+            void resetParser(void)
+            {
+                _state = IDLE;
+            }
+
+            bool frameInProgress(void)
+            {
+                return _state != IDLE;
             }
             
-            uint8_t availableBytes(void)
+            uint16_t availableBytes(void)
             {
-                return _outBufSize;
+                return _outBufCount;
             }
 
             uint8_t readByte(void)
             {
-                _outBufSize--;
-                return _outBuf[_outBufIndex++];
+                uint8_t c = _outBuf[_outBufTail];
+                _outBufTail = (_outBufTail + 1) % OUTBUF_SIZE;
+                _outBufCount--;
+                return c;
+            }
+
+            // Contiguous run of queued output, for writing in bulk; follow with consumeOutput()
+            const uint8_t * peekOutput(uint16_t & count)
+            {
+                count = _outBufCount;
+
+                if (_outBufTail + count > OUTBUF_SIZE) {
+                    count = OUTBUF_SIZE - _outBufTail;
+                }
+
+                return &_outBuf[_outBufTail];
+            }
+
+            void consumeOutput(uint16_t count)
+            {
+                _outBufTail = (_outBufTail + count) % OUTBUF_SIZE;
+                _outBufCount -= count;
+            }
+
+            uint16_t outputSpace(void)
+            {
+                return OUTBUF_SIZE - _outBufCount;
+            }
+
+            // Backpressure: stop parsing input while a response might not fit in the output queue
+            bool readyToParse(void)
+            {
+                return outputSpace() >= MAX_RESPONSE_SIZE;
+            }
+
+            uint32_t getDroppedResponseCount(void)
+            {
+                return _droppedResponseCount;
+            }
+
+            // Response frame size in the current version, or zero for commands and unknown messages
+            uint16_t responseSize(uint16_t command)
+            {
+                int32_t payloadSize = responsePayloadSize(command);
+
+                if (payloadSize < 0 || (_responseVersion == 1 && command > 255)) {
+                    return 0;
+                }
+
+                return payloadSize + frameOverhead();
+            }
+
+            // Sends a response without a request, as for subscribed telemetry
+            void pushResponse(uint16_t command)
+            {
+                if (responseSize(command) == 0) {
+                    return;
+                }
+
+                // Don't disturb a request that is being parsed
+                uint16_t parsingCommand = _command;
+                _command = command;
+                dispatchMessage();
+                _command = parsingCommand;
+            }
+
+            // Refuses the command being handled, with an empty error response
+            void sendErrorResponse(void)
+            {
+                if (outputSpace() < frameOverhead()) {
+                    _droppedResponseCount++;
+                    return;
+                }
+
+                headSerialResponse(1, 0);
+                serialize8(_checksum);
             }
 
             // returns true if reboot request, false otherwise
@@ -199,7 +476,8 @@ namespace hf {
                         break;
 
                     case HEADER_START:
-                        _state = (c == 'M') ? HEADER_M : IDLE;
+                        _version = (c == 'X') ? 2 : 1;
+                        _state = (c == 'M' || c == 'X') ? HEADER_M : IDLE;
                         break;
 
                     case HEADER_M:
@@ -218,34 +496,77 @@ namespace hf {
                         break;
 
                     case HEADER_ARROW:
+                        if (_version == 2) {            // flag byte starts the v2 header
+                            _inChecksum = crc8_dvb_s2(0, c);
+                            _offset = 1;
+                            _state = V2_HEADER;
+                            break;
+                        }
                         if (c > INBUF_SIZE) {       // now we are expecting the payload size
                             _state = IDLE;
                             return false;
                         }
                         _dataSize = c;
                         _offset = 0;
-                        _checksum = 0;
-                        _inBufIndex = 0;
-                        _checksum ^= c;
+                        _inChecksum = 0;
+                        _inChecksum ^= c;
                         _state = HEADER_SIZE;      // the command is to follow
                         break;
 
                     case HEADER_SIZE:
                         _command = c;
-                        _checksum ^= c;
+                        _inChecksum ^= c;
                         _state = HEADER_CMD;
                         break;
 
                     case HEADER_CMD:
                         if (_offset < _dataSize) {
-                            _checksum ^= c;
+                            _inChecksum ^= c;
                             _inBuf[_offset++] = c;
                         } else  {
-                            if (_checksum == c) {        // compare calculated and transferred _checksum
-                                dispatchMessage();
+                            if (_inChecksum == c) {        // compare calculated and transferred _checksum
+                                dispatchRequest();
                             }
                             _state = IDLE;
                         }
+                        break;
+
+                    case V2_HEADER:                 // command and size, little-endian
+                        _inChecksum = crc8_dvb_s2(_inChecksum, c);
+                        switch (_offset++) {
+                            case 1:
+                                _command = c;
+                                break;
+                            case 2:
+                                _command |= c << 8;
+                                break;
+                            case 3:
+                                _dataSize = c;
+                                break;
+                            default:
+                                _dataSize |= c << 8;
+                                if (_dataSize > INBUF_SIZE) {
+                                    _state = IDLE;
+                                    return false;
+                                }
+                                _offset = 0;
+                                _state = _dataSize > 0 ? V2_PAYLOAD : V2_CHECKSUM;
+                        }
+                        break;
+
+                    case V2_PAYLOAD:
+                        _inChecksum = crc8_dvb_s2(_inChecksum, c);
+                        _inBuf[_offset++] = c;
+                        if (_offset == _dataSize) {
+                            _state = V2_CHECKSUM;
+                        }
+                        break;
+
+                    case V2_CHECKSUM:
+                        if (_inChecksum == c) {
+                            dispatchRequest();
+                        }
+                        _state = IDLE;
 
                 } // switch (_state)
 
@@ -253,4 +574,38 @@ namespace hf {
 
             } // parse
 
+            // Parses a block of input, handling frames that arrive whole without the byte-by-byte state machine.
+            // Returns the number of bytes consumed, which is less than count only when the output queue is full.
+            size_t parse(const uint8_t * buf, size_t count)
+            {
+                size_t k = 0;
+
+                while (k < count && readyToParse()) {
+
+                    if (_state == IDLE) {
+
+                        // Skip to the next frame header
+                        const uint8_t * start = (const uint8_t *)memchr(&buf[k], '$', count - k);
+
+                        if (start == NULL) {
+                            return count;
+                        }
+
+                        k = start - buf;
+
+                        size_t frameSize = parseFrame(&buf[k], count - k);
+
+                        if (frameSize > 0) {
+                            k += frameSize;
+                            continue;
+                        }
+                    }
+
+                    // Partial frame: finish it, or start it, a byte at a time
+                    parse(buf[k++]);
+                }
+
+                return k;
+            }
+
 
@@ -24,19 +24,18 @@ along with this code.  If not, see <http:#www.gnu.org/licenses/>.
 
 SUPERFLY_ADDR = '192.168.4.1'
 SUPERFLY_PORT = 80
-TIMEOUT_SEC   = 4
 
-from socket import socket
+from socket import socket, AF_INET, SOCK_DGRAM
+from struct import pack
 from pysticks import get_controller
 from msppg import serialize_SET_RC_NORMAL
 
 # Start the controller
 con = get_controller()
 
-# Set up socket connection to SuperFly
-sock = socket()
-sock.settimeout(TIMEOUT_SEC)
-sock.connect((SUPERFLY_ADDR, SUPERFLY_PORT))    
+# SuperFly takes MSP over UDP, each datagram starting with a sequence number
+sock = socket(AF_INET, SOCK_DGRAM)
+sequence = 0
     
 while True:
 
@@ -51,5 +50,6 @@ while True:
     print('Throttle:%+2.2f Roll:%+2.2f Pitch:%+2.2f Yaw:%+2.2f Aux1:%+2.2f Aux2:%+2.2f' % cmds)
 
     # Send the array of commands to SuperFly
-    sock.send(serialize_SET_RC_NORMAL(*cmds))
+    sock.sendto(pack('<H', sequence) + serialize_SET_RC_NORMAL(*cmds), (SUPERFLY_ADDR, SUPERFLY_PORT))
+    sequence = (sequence + 1) & 0xFFFF
 
@@ -0,0 +1,286 @@
+/*
+   Loopback test for the UDP MSP transport
+
+   Sends SET_RC_NORMAL datagrams over a loopback socket with some dropped,
+   duplicated and delayed, as on a busy WiFi link, and checks that the
+   receiver never goes back to older stick values, that its link statistics
+   add up, and that replies to requests come back to the sender.  Then
+   checks that a sender restarting its count is accepted, whether it lands
+   far behind the old count or, after a gap, just behind it.
+
+   Copyright (C) Simon D. Levy 2020
+
+   This code is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as 
+   published by the Free Software Foundation, either version 3 of the 
+   License, or (at your option) any later version.
+   This code is distributed in the hope that it will be useful,     
+   but WITHOUT ANY WARRANTY without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License 
+   along with this code.  If not, see <http:#www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <vector>
+
+#include "udpmsp.hpp"
+
+static const uint16_t PORT = 45678;
+
+static const uint16_t DATAGRAM_COUNT = 2000;
+
+static float getTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9f;
+}
+
+static int openSocket(uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("socket");
+        exit(1);
+    }
+
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+
+    return sock;
+}
+
+// What a flight controller would do with the transport core
+class LoopbackReceiver : public hf::UdpMsp {
+
+    private:
+
+        int _sock = -1;
+
+        void sendReplies(struct sockaddr_in & from)
+        {
+            uint8_t reply[256];
+            uint16_t size = 0;
+
+            while (UdpMsp::availableBytes() > 0) {
+
+                uint16_t count = 0;
+                const uint8_t * bytes = UdpMsp::peekOutput(count);
+
+                memcpy(&reply[size], bytes, count);
+                size += count;
+
+                UdpMsp::consumeOutput(count);
+            }
+
+            sendto(_sock, reply, size, 0, (struct sockaddr *)&from, sizeof(from));
+        }
+
+    protected:
+
+        virtual void handle_SET_RC_NORMAL(float  c1, float  c2, float  c3, float  c4, float  c5, float  c6) override
+        {
+            if (c1 < throttle) {
+                regressions++;
+            }
+
+            throttle = c1;
+            rcCount++;
+        }
+
+    public:
+
+        float    throttle = -1;
+        uint32_t rcCount = 0;
+        uint32_t regressions = 0;
+
+        void begin(void)
+        {
+            _sock = openSocket(PORT);
+
+            UdpMsp::init();
+        }
+
+        void poll(void)
+        {
+            uint8_t datagram[256];
+            struct sockaddr_in from = {};
+            socklen_t fromSize = sizeof(from);
+
+            while (true) {
+
+                ssize_t count = recvfrom(_sock, datagram, sizeof(datagram), 0, (struct sockaddr *)&from, &fromSize);
+
+                if (count < 0) {
+                    break;
+                }
+
+                if (UdpMsp::receive(datagram, (uint16_t)count, getTime()) && UdpMsp::availableBytes() > 0) {
+                    sendReplies(from);
+                }
+            }
+        }
+
+        bool lostSignal(void)
+        {
+            return UdpMsp::gapTimedOut(getTime());
+        }
+
+}; // class LoopbackReceiver
+
+static std::vector<uint8_t> makeDatagram(uint16_t sequence, bool withRequest)
+{
+    uint8_t frame[64];
+
+    std::vector<uint8_t> datagram;
+    datagram.push_back(sequence & 0xFF);
+    datagram.push_back(sequence >> 8);
+
+    uint16_t size = hf::MspParser::serialize_SET_RC_NORMAL(frame, (float)sequence / DATAGRAM_COUNT, 0, 0, 0, 0, 0);
+    datagram.insert(datagram.end(), frame, frame+size);
+
+    if (withRequest) {
+        size = hf::MspParser::serialize_ATTITUDE_RADIANS_Request(frame);
+        datagram.insert(datagram.end(), frame, frame+size);
+    }
+
+    return datagram;
+}
+
+static bool check(const char * label, bool ok)
+{
+    printf("%-40s %s\n", label, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(void)
+{
+    LoopbackReceiver receiver;
+    receiver.begin();
+
+    int sender = openSocket(PORT+1);
+
+    struct sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(PORT);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    srand(0);
+
+    uint32_t dropped = 0, duplicated = 0, delayed = 0, requests = 0;
+
+    std::vector<uint8_t> held;
+
+    for (uint16_t k=0; k<DATAGRAM_COUNT; ++k) {
+
+        bool withRequest = (k % 10) == 0;
+
+        std::vector<uint8_t> datagram = makeDatagram(k, withRequest);
+
+        int r = rand() % 100;
+
+        // Drop 5%
+        if (r < 5) {
+            dropped++;
+            continue;
+        }
+
+        requests += withRequest;
+
+        // Hold back 5% until after the next one
+        if (r < 10 && held.empty()) {
+            held = datagram;
+            delayed++;
+            continue;
+        }
+
+        sendto(sender, datagram.data(), datagram.size(), 0, (struct sockaddr *)&to, sizeof(to));
+
+        // Duplicate 2%
+        if (r < 12) {
+            sendto(sender, datagram.data(), datagram.size(), 0, (struct sockaddr *)&to, sizeof(to));
+            duplicated++;
+        }
+
+        if (!held.empty()) {
+            sendto(sender, held.data(), held.size(), 0, (struct sockaddr *)&to, sizeof(to));
+            held.clear();
+        }
+
+        receiver.poll();
+    }
+
+    receiver.poll();
+
+    // Delayed datagrams arrive after a newer one, so they count as lost and then as stale
+    bool ok = true;
+    ok &= check("stick values never went back", receiver.regressions == 0);
+    ok &= check("every in-order datagram handled", receiver.rcCount == receiver.getReceivedCount());
+    ok &= check("lost count matches", receiver.getLostCount() == dropped + delayed);
+    ok &= check("stale count matches", receiver.getStaleCount() == duplicated + delayed);
+    ok &= check("signal present", !receiver.lostSignal());
+
+    // Count replies to ATTITUDE_RADIANS requests that weren't dropped as stale
+    uint32_t replies = 0;
+    uint8_t buf[256];
+    while (recv(sender, buf, sizeof(buf), 0) > 0) {
+        replies++;
+    }
+    ok &= check("replies came back", replies > 0 && replies <= requests);
+
+    usleep(300000);
+    ok &= check("signal lost after gap", receiver.lostSignal());
+
+    // Sender restarts its count
+    std::vector<uint8_t> datagram = makeDatagram(0, false);
+    sendto(sender, datagram.data(), datagram.size(), 0, (struct sockaddr *)&to, sizeof(to));
+    usleep(10000);
+    receiver.poll();
+    ok &= check("sender restart accepted", receiver.getRestartCount() == 1 && !receiver.lostSignal());
+
+    // Sender restarts after a gap, landing just behind its old count
+    for (uint16_t k=1; k<=100; ++k) {
+        datagram = makeDatagram(k, false);
+        sendto(sender, datagram.data(), datagram.size(), 0, (struct sockaddr *)&to, sizeof(to));
+    }
+    usleep(10000);
+    receiver.poll();
+
+    usleep(300000);
+    datagram = makeDatagram(50, false);
+    sendto(sender, datagram.data(), datagram.size(), 0, (struct sockaddr *)&to, sizeof(to));
+    usleep(10000);
+    receiver.poll();
+    ok &= check("restart after gap accepted", receiver.getRestartCount() == 2 && !receiver.lostSignal());
+
+    // Without a gap, an older datagram is still stale
+    uint32_t stale = receiver.getStaleCount();
+    datagram = makeDatagram(40, false);
+    sendto(sender, datagram.data(), datagram.size(), 0, (struct sockaddr *)&to, sizeof(to));
+    usleep(10000);
+    receiver.poll();
+    ok &= check("older datagram after resync is stale", receiver.getStaleCount() == stale + 1);
+
+    printf("\nreceived %u, lost %u, stale %u, quality %u%%, max gap %u usec\n", 
+            receiver.getReceivedCount(), receiver.getLostCount(), receiver.getStaleCount(), 
+            receiver.getLinkQuality(), receiver.getMaxGapUsec());
+
+    close(sender);
+
+    return ok ? 0 : 1;
+}
@@ -31,10 +31,16 @@ namespace hf {
 
         protected:
 
+            // Arbitrary
+            static const uint8_t MAXMOTORS = 20;
+
             virtual void cut(void) = 0;
 
             virtual void run(demands_t demands) = 0;
 
+            // Supports spinning individual motors (e.g., from the GCS) while disarmed
+            virtual void runDisarmed(const float * values) { (void)values; }
+
     }; // class Actuator
 
 } // namespace hf
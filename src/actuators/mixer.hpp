@@ -41,9 +41,6 @@ namespace hf {
                 int8_t yaw;	     // R
             } motorMixer_t;
 
-            // Arbitrary
-            static const uint8_t MAXMOTORS = 20;
-
             float _motorsPrev[MAXMOTORS] = {0};
 
             void writeMotor(uint8_t index, float value)
@@ -81,7 +78,7 @@ namespace hf {
 
             uint8_t _nmotors;
 
-            // This is also use by serial task
+            // Set by the serial task, run by the PID task
             float  motorsDisarmed[MAXMOTORS];
 
             void useMotors(Motor ** motors)
@@ -93,16 +90,16 @@ namespace hf {
                 }
             }
 
+            // Actuator overrides ----------------------------------------------
+
             // This is how we can spin the motors from the GCS
-            void runDisarmed(void)
+            void runDisarmed(const float * values) override
             {
                 for (uint8_t i = 0; i < _nmotors; i++) {
-                    safeWriteMotor(i, motorsDisarmed[i]);
+                    safeWriteMotor(i, values[i]);
                 }
             }
 
-            // Actuator overrides ----------------------------------------------
-
             void run(demands_t demands) override
             {
                 // Map throttle demand from [-1,+1] to [0,1]
@@ -0,0 +1,139 @@
+/*
+   Abstract class for non-blocking sensor buses
+
+   Drivers submit transactions to a small queue and return immediately;
+   update() advances the queue, so multi-step sensor interactions can be
+   written as state machines that make progress on each Hackflight update
+   instead of blocking the loop.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    class AsyncBus {
+
+        public:
+
+            typedef enum {
+                IDLE,
+                QUEUED,
+                IN_PROGRESS,
+                COMPLETE,
+                FAILED
+            } status_t;
+
+            typedef struct {
+
+                uint8_t  address;
+                uint16_t reg;
+                uint8_t  regSize;   // 1 or 2 bytes, big-endian on the wire
+                bool     write;
+                uint8_t  count;
+                uint8_t * data;
+
+                volatile status_t status;
+
+            } transaction_t;
+
+        private:
+
+            static const uint8_t QUEUE_SIZE = 8;
+
+            transaction_t * _queue[QUEUE_SIZE] = {};
+            uint8_t _head = 0;
+            uint8_t _count = 0;
+
+            uint32_t _completedCount = 0;
+
+        protected:
+
+            // Start transferring a transaction; may complete it immediately
+            virtual void startTransfer(transaction_t * t, float time) = 0;
+
+            // Returns true once the transaction started by startTransfer() has finished, setting its status
+            virtual bool transferDone(transaction_t * t, float time) = 0;
+
+        public:
+
+            // Returns false if the queue is full
+            bool submit(transaction_t * t)
+            {
+                if (_count == QUEUE_SIZE) {
+                    return false;
+                }
+
+                t->status = QUEUED;
+                _queue[(_head + _count) % QUEUE_SIZE] = t;
+                _count++;
+
+                return true;
+            }
+
+            // Call often; finishes the current transaction and starts the next one
+            void update(float time)
+            {
+                while (_count > 0) {
+
+                    transaction_t * t = _queue[_head];
+
+                    if (t->status == QUEUED) {
+                        t->status = IN_PROGRESS;
+                        startTransfer(t, time);
+                    }
+
+                    if (t->status == IN_PROGRESS && !transferDone(t, time)) {
+                        return;
+                    }
+
+                    _head = (_head + 1) % QUEUE_SIZE;
+                    _count--;
+                    _completedCount++;
+                }
+            }
+
+            uint32_t getCompletedCount(void)
+            {
+                return _completedCount;
+            }
+
+            // Helpers for filling in transactions
+
+            static void setRead(transaction_t & t, uint8_t address, uint16_t reg, uint8_t regSize, uint8_t * data, uint8_t count)
+            {
+                t.address = address;
+                t.reg = reg;
+                t.regSize = regSize;
+                t.write = false;
+                t.data = data;
+                t.count = count;
+                t.status = IDLE;
+            }
+
+            static void setWrite(transaction_t & t, uint8_t address, uint16_t reg, uint8_t regSize, uint8_t * data, uint8_t count)
+            {
+                setRead(t, address, reg, regSize, data, count);
+                t.write = true;
+            }
+
+    }; // class AsyncBus
+
+} // namespace hf
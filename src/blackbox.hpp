@@ -0,0 +1,468 @@
+/*
+   Binary flight recorder
+
+   Each PID tick, the state, receiver demands, PID output and motor values are
+   quantized and packed into blocks: the first frame of a block holds absolute
+   values and the rest hold differences from the frame before, all as zigzag
+   varints.  Blocks pass through a lock-free ring and are drained to a
+   BlackboxStore in the time the flight loop has to spare, or on the other
+   core in dual-core mode; whatever the store can't take yet stays in the
+   ring for the next try.  The store opens during startup.  A schema header at the start of the log
+   names each field and its scale, so fields can be added without breaking
+   decoders.
+
+   Log layout (little-endian):
+
+     header:  "HFBB", version (2), size of the rest of the header (2), field
+              count (1), then per field a NUL-terminated name, flags (1) and
+              scale (float)
+
+     block:   'H', 'B', payload size (2), frame count (2), Fletcher-16 of
+              payload (2), payload
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "datatypes.hpp"
+#include "spscring.hpp"
+#include "startupcomponent.hpp"
+
+#ifndef HF_BLACKBOX_RING_SIZE
+#define HF_BLACKBOX_RING_SIZE 4096
+#endif
+
+namespace hf {
+
+    // Opens its storage in startupStep(), so a slow device never holds up the flight loop
+    class BlackboxStore : public StartupComponent {
+
+        friend class Blackbox;
+
+        protected:
+
+            virtual const char * startupName(void) override
+            {
+                return "blackbox";
+            }
+
+            // Returns how many bytes were taken; fewer than count (even zero) when the store is busy or failing,
+            // in which case the rest are offered again later
+            virtual uint16_t write(const uint8_t * data, uint16_t count) = 0;
+
+            // Some storage (e.g., an SD card) buffers writes until flushed
+            virtual void flush(void)
+            {
+            }
+
+    }; // class BlackboxStore
+
+    class Blackbox {
+
+        friend class Hackflight;
+        friend class PidTask;
+
+        private:
+
+            static const uint32_t MAGIC   = 0x42424648; // "HFBB"
+            static const uint16_t VERSION = 1;
+
+            // Field flags: an unsigned counter (like time) wraps around instead of going negative
+            static const uint8_t FIELD_UNSIGNED = 0x01;
+
+            typedef struct {
+
+                const char * name;
+                uint8_t      flags;
+                float        scale; // quantization steps per unit
+
+            } field_t;
+
+            static const uint8_t FIXED_FIELD_COUNT = 29;
+            static const uint8_t MAX_MOTORS        = 8;
+            static const uint8_t MAX_FIELDS        = FIXED_FIELD_COUNT + MAX_MOTORS;
+
+            static const field_t * fixedFields(void)
+            {
+                static const field_t fields[FIXED_FIELD_COUNT] = {
+                    {"time",          FIELD_UNSIGNED, 1e6f}, // microseconds
+                    {"flags",         0, 1},                 // armed, failsafe
+                    {"location.x",    0, 1e3f},
+                    {"location.y",    0, 1e3f},
+                    {"location.z",    0, 1e3f},
+                    {"angularVel.x",  0, 1e3f},
+                    {"angularVel.y",  0, 1e3f},
+                    {"angularVel.z",  0, 1e3f},
+                    {"bodyAccel.x",   0, 1e3f},
+                    {"bodyAccel.y",   0, 1e3f},
+                    {"bodyAccel.z",   0, 1e3f},
+                    {"bodyVel.x",     0, 1e3f},
+                    {"bodyVel.y",     0, 1e3f},
+                    {"bodyVel.z",     0, 1e3f},
+                    {"inertialVel.x", 0, 1e3f},
+                    {"inertialVel.y", 0, 1e3f},
+                    {"inertialVel.z", 0, 1e3f},
+                    {"quaternion.w",  0, 1e4f},
+                    {"quaternion.x",  0, 1e4f},
+                    {"quaternion.y",  0, 1e4f},
+                    {"quaternion.z",  0, 1e4f},
+                    {"rc.throttle",   0, 1e3f},
+                    {"rc.roll",       0, 1e3f},
+                    {"rc.pitch",      0, 1e3f},
+                    {"rc.yaw",        0, 1e3f},
+                    {"pid.throttle",  0, 1e3f},
+                    {"pid.roll",      0, 1e3f},
+                    {"pid.pitch",     0, 1e3f},
+                    {"pid.yaw",       0, 1e3f}
+                };
+
+                return fields;
+            }
+
+            static constexpr float MOTOR_SCALE = 1e4f;
+
+            static const uint8_t  BLOCK_HEADER_SIZE = 8;
+            static const uint16_t BLOCK_PAYLOAD_MAX = 512;
+
+            // A new block (and so a keyframe) at least this often, which bounds what a corrupt block can lose
+            static const uint16_t BLOCK_FRAMES_MAX = 64;
+
+            // Worst case: a five-byte varint per field
+            static const uint16_t FRAME_SIZE_MAX = 5 * MAX_FIELDS;
+
+            // Writes go to the store in chunks of this size (a flash page or SD sector) when possible
+            static const uint16_t DRAIN_SIZE = 512;
+
+            // Writes in a row that flush() lets the store refuse
+            static const uint8_t FLUSH_RETRIES = 3;
+
+            // Longest field name, not counting its NUL
+            static const uint8_t FIELD_NAME_MAX = 15;
+
+            static const uint16_t HEADER_SIZE_MAX = 9 + MAX_FIELDS * (FIELD_NAME_MAX + 2 + sizeof(float));
+
+            // The header goes through the ring ahead of the first block
+            static_assert(HEADER_SIZE_MAX + BLOCK_HEADER_SIZE + BLOCK_PAYLOAD_MAX <= HF_BLACKBOX_RING_SIZE,
+                    "Blackbox ring can't hold the header and a block");
+
+            BlackboxStore * _store = NULL;
+
+            // Producer (recording) side -------------------------------------------
+
+            const float * _motors = NULL;
+            uint8_t _motorCount = 0;
+
+            uint32_t _previous[MAX_FIELDS] = {};
+
+            uint8_t  _block[BLOCK_HEADER_SIZE + BLOCK_PAYLOAD_MAX];
+            uint16_t _blockSize = 0;
+            uint16_t _blockFrames = 0;
+
+            uint32_t _frameCount = 0;
+            uint32_t _droppedFrameCount = 0;
+
+            bool _queuedHeader = false;
+
+            SpscRing<uint8_t, HF_BLACKBOX_RING_SIZE> _ring;
+
+            // Consumer (draining) side --------------------------------------------
+
+            uint32_t _bytesWritten = 0;
+
+            // Writes the store refused, or took only part of
+            uint32_t _failedWriteCount = 0;
+
+            uint8_t fieldCount(void)
+            {
+                return FIXED_FIELD_COUNT + _motorCount;
+            }
+
+            static uint32_t quantize(float value, float scale)
+            {
+                float scaled = value * scale;
+
+                // Saturate rather than overflow
+                if (scaled > 2.1e9f) {
+                    scaled = 2.1e9f;
+                }
+                if (scaled < -2.1e9f) {
+                    scaled = -2.1e9f;
+                }
+
+                return (uint32_t)(int32_t)(scaled + (scaled < 0 ? -0.5f : 0.5f));
+            }
+
+            void putVarint(uint32_t value)
+            {
+                while (value >= 0x80) {
+                    _block[_blockSize++] = (uint8_t)(value | 0x80);
+                    value >>= 7;
+                }
+
+                _block[_blockSize++] = (uint8_t)value;
+            }
+
+            static uint32_t zigzag(uint32_t value)
+            {
+                return (value << 1) ^ (uint32_t)((int32_t)value >> 31);
+            }
+
+            static uint16_t fletcher16(const uint8_t * data, uint16_t count)
+            {
+                uint16_t a = 0, b = 0;
+
+                for (uint16_t k=0; k<count; ++k) {
+                    a = (a + data[k]) % 255;
+                    b = (b + a) % 255;
+                }
+
+                return (b << 8) | a;
+            }
+
+            void closeBlock(void)
+            {
+                if (_blockFrames == 0) {
+                    return;
+                }
+
+                uint16_t payloadSize = _blockSize - BLOCK_HEADER_SIZE;
+                uint16_t checksum = fletcher16(&_block[BLOCK_HEADER_SIZE], payloadSize);
+
+                _block[0] = 'H';
+                _block[1] = 'B';
+                _block[2] = payloadSize & 0xFF;
+                _block[3] = payloadSize >> 8;
+                _block[4] = _blockFrames & 0xFF;
+                _block[5] = _blockFrames >> 8;
+                _block[6] = checksum & 0xFF;
+                _block[7] = checksum >> 8;
+
+                if (!_ring.push(_block, _blockSize)) {
+                    _droppedFrameCount += _blockFrames;
+                }
+
+                _blockSize = 0;
+                _blockFrames = 0;
+            }
+
+            // Motor fields are named motor0, motor1, ...
+            field_t getField(uint8_t index, char motorName[7])
+            {
+                if (index < FIXED_FIELD_COUNT) {
+                    return fixedFields()[index];
+                }
+
+                strcpy(motorName, "motor0");
+                motorName[5] += index - FIXED_FIELD_COUNT;
+
+                field_t field = {motorName, 0, MOTOR_SCALE};
+
+                return field;
+            }
+
+            // Field count plus, for each field, name, NUL, flags and scale
+            uint16_t schemaSize(void)
+            {
+                uint16_t size = 1;
+
+                for (uint8_t k=0; k<fieldCount(); ++k) {
+                    char motorName[7];
+                    size += strlen(getField(k, motorName).name) + 2 + sizeof(float);
+                }
+
+                return size;
+            }
+
+            // The ring is empty when this runs, before the first block, so every piece fits
+            void queueHeader(void)
+            {
+                uint32_t magic = MAGIC;
+                uint16_t version = VERSION;
+                uint16_t size = schemaSize();
+                uint8_t count = fieldCount();
+
+                _ring.push((const uint8_t *)&magic, 4);
+                _ring.push((const uint8_t *)&version, 2);
+                _ring.push((const uint8_t *)&size, 2);
+                _ring.push(&count, 1);
+
+                for (uint8_t k=0; k<fieldCount(); ++k) {
+
+                    char motorName[7];
+                    field_t field = getField(k, motorName);
+
+                    _ring.push((const uint8_t *)field.name, strlen(field.name)+1);
+                    _ring.push(&field.flags, 1);
+                    _ring.push((const uint8_t *)&field.scale, sizeof(float));
+                }
+            }
+
+        protected:
+
+            void useMotors(const float * motors, uint8_t count)
+            {
+                _motors = motors;
+                _motorCount = count < MAX_MOTORS ? count : MAX_MOTORS;
+            }
+
+            // Called by the PID task on every tick, with the board's microsecond clock
+            void record(uint32_t usec, state_t * state, const demands_t & rcDemands, const demands_t & pidDemands)
+            {
+                if (!_queuedHeader) {
+                    queueHeader();
+                    _queuedHeader = true;
+                }
+
+                const float values[FIXED_FIELD_COUNT] = {
+                    0, // time is handled separately
+                    (float)(state->armed | (state->failsafe << 1)),
+                    state->location[0],    state->location[1],    state->location[2],
+                    state->angularVel[0],  state->angularVel[1],  state->angularVel[2],
+                    state->bodyAccel[0],   state->bodyAccel[1],   state->bodyAccel[2],
+                    state->bodyVel[0],     state->bodyVel[1],     state->bodyVel[2],
+                    state->inertialVel[0], state->inertialVel[1], state->inertialVel[2],
+                    state->quaternion[0],  state->quaternion[1],  state->quaternion[2], state->quaternion[3],
+                    rcDemands.throttle,    rcDemands.roll,        rcDemands.pitch,      rcDemands.yaw,
+                    pidDemands.throttle,   pidDemands.roll,       pidDemands.pitch,     pidDemands.yaw
+                };
+
+                uint32_t quantized[MAX_FIELDS];
+
+                const field_t * fields = fixedFields();
+
+                // Microseconds wrap around every 71 minutes; the decoder unwraps them
+                quantized[0] = usec;
+
+                for (uint8_t k=1; k<FIXED_FIELD_COUNT; ++k) {
+                    quantized[k] = quantize(values[k], fields[k].scale);
+                }
+
+                for (uint8_t k=0; k<_motorCount; ++k) {
+                    quantized[FIXED_FIELD_COUNT+k] = quantize(_motors[k], MOTOR_SCALE);
+                }
+
+                if (_blockSize + FRAME_SIZE_MAX > (uint16_t)sizeof(_block) || _blockFrames == BLOCK_FRAMES_MAX) {
+                    closeBlock();
+                }
+
+                if (_blockFrames == 0) {
+                    _blockSize = BLOCK_HEADER_SIZE;
+                }
+
+                // The first frame of a block is absolute, so blocks decode independently
+                bool keyframe = _blockFrames == 0;
+
+                for (uint8_t k=0; k<fieldCount(); ++k) {
+                    putVarint(zigzag(keyframe ? quantized[k] : quantized[k] - _previous[k]));
+                    _previous[k] = quantized[k];
+                }
+
+                _blockFrames++;
+                _frameCount++;
+            }
+
+            // Writes at most one chunk, and only a full one unless flushing, so a slow store costs little per call.  Bytes
+            // leave the ring only once the store has taken them; if it's failing, the ring fills and new frames are dropped.
+            // Returns true if the store was offered anything.
+            bool drain(bool all=false)
+            {
+                if (!_store || _ring.available() == 0 || (!all && _ring.available() < DRAIN_SIZE)) {
+                    return false;
+                }
+
+                while (all || _ring.available() >= DRAIN_SIZE) {
+
+                    uint8_t chunk[DRAIN_SIZE];
+
+                    uint16_t count = _ring.peek(chunk, DRAIN_SIZE);
+
+                    if (count == 0) {
+                        break;
+                    }
+
+                    uint16_t written = _store->write(chunk, count);
+
+                    _ring.discard(written);
+                    _bytesWritten += written;
+
+                    if (written < count) {
+                        _failedWriteCount++;
+                        break;
+                    }
+
+                    if (!all) {
+                        break;
+                    }
+                }
+
+                return true;
+            }
+
+        public:
+
+            Blackbox(BlackboxStore * store)
+            {
+                _store = store;
+            }
+
+            // Writes out everything recorded so far; call from the same thread as the PID task, e.g. after landing.  Gives up
+            // if the store takes nothing several times running, leaving the rest queued for another try.
+            void flush(void)
+            {
+                closeBlock();
+
+                for (uint8_t failures=0; _store && _ring.available() > 0 && failures < FLUSH_RETRIES; ) {
+
+                    uint32_t written = _bytesWritten;
+
+                    drain(true);
+
+                    failures = _bytesWritten == written ? failures + 1 : 0;
+                }
+
+                if (_store) {
+                    _store->flush();
+                }
+            }
+
+            uint32_t getFrameCount(void)
+            {
+                return _frameCount;
+            }
+
+            uint32_t getDroppedFrameCount(void)
+            {
+                return _droppedFrameCount;
+            }
+
+            uint32_t getBytesWritten(void)
+            {
+                return _bytesWritten;
+            }
+
+            uint32_t getFailedWriteCount(void)
+            {
+                return _failedWriteCount;
+            }
+
+    }; // class Blackbox
+
+} // namespace hf
@@ -0,0 +1,66 @@
+/*
+   Blackbox log in a file, for simulators and host testing
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include "blackbox.hpp"
+
+namespace hf {
+
+    class FileBlackboxStore : public BlackboxStore {
+
+        private:
+
+            FILE * _fp = NULL;
+
+        protected:
+
+            virtual uint16_t write(const uint8_t * data, uint16_t count) override
+            {
+                return _fp ? (uint16_t)fwrite(data, 1, count, _fp) : 0;
+            }
+
+            virtual void flush(void) override
+            {
+                if (_fp) {
+                    fflush(_fp);
+                }
+            }
+
+        public:
+
+            // Starts a new log, replacing any file already at the path
+            FileBlackboxStore(const char * path)
+            {
+                _fp = fopen(path, "wb");
+            }
+
+            ~FileBlackboxStore(void)
+            {
+                if (_fp) {
+                    fclose(_fp);
+                }
+            }
+
+    }; // class FileBlackboxStore
+
+} // namespace hf
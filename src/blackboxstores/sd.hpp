@@ -0,0 +1,81 @@
+/*
+   Blackbox log on an SD card
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <SD.h>
+
+#include "blackbox.hpp"
+#include "debugger.hpp"
+
+namespace hf {
+
+    class SdBlackboxStore : public BlackboxStore {
+
+        private:
+
+            const char * _path = NULL;
+            uint8_t _chipSelect = 0;
+
+            File _file;
+
+        protected:
+
+            // Card initialization can take hundreds of msec, so it happens here rather than on the first write.  A missing
+            // card is reported but doesn't stop the vehicle arming; the log's frames are then counted as dropped.
+            virtual bool startupStep(float time) override
+            {
+                (void)time;
+
+                if (SD.begin(_chipSelect)) {
+                    SD.remove(_path);
+                    _file = SD.open(_path, FILE_WRITE);
+                }
+
+                if (!_file) {
+                    Debugger::printf("No SD card; blackbox not recording\n");
+                }
+
+                return true;
+            }
+
+            virtual uint16_t write(const uint8_t * data, uint16_t count) override
+            {
+                return _file ? (uint16_t)_file.write(data, count) : 0;
+            }
+
+            virtual void flush(void) override
+            {
+                if (_file) {
+                    _file.flush();
+                }
+            }
+
+        public:
+
+            SdBlackboxStore(const char * path, uint8_t chipSelect)
+            {
+                _path = path;
+                _chipSelect = chipSelect;
+            }
+
+    }; // class SdBlackboxStore
+
+} // namespace hf
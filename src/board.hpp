@@ -23,9 +23,12 @@
 #include <stdarg.h>
 #include <stdint.h>
 
+#include "startupcomponent.hpp"
+#include "calibration.hpp"
+
 namespace hf {
 
-    class Board {
+    class Board : public StartupComponent {
 
         friend class Hackflight;
         friend class Debugger;
@@ -38,10 +41,31 @@ namespace hf {
             //------------------------------------ Core functionality ----------------------------------------------------
             virtual float getTime(void) = 0;
 
+            // Microseconds, wrapping every 71 minutes, for timestamps finer than a float of seconds keeps in a long flight
+            virtual uint32_t getMicros(void) { return (uint32_t)(uint64_t)(getTime() * 1e6); }
+
+            virtual const char * startupName(void) override
+            {
+                return "board";
+            }
+
+            virtual void applyCalibration(const calibration_t & calibration) { (void)calibration; }
+            virtual void captureCalibration(calibration_t & calibration) { (void)calibration; }
+
             //------------------------------- Serial communications via MSP ----------------------------------------------
-            virtual uint8_t serialAvailableBytes(void) { return 0; }
-            virtual uint8_t serialReadByte(void)  { return 1; }
-            virtual void    serialWriteByte(uint8_t c) { (void)c; }
+            // Moves received bytes off the hardware; called every update, so the hardware FIFO doesn't overflow between serial ticks
+            virtual void     serialReceive(void) { }
+
+            // Each port (USB, telemetry radio, companion computer) gets its own MSP parser
+            virtual uint8_t  serialPortCount(void) { return 0; }
+
+            // Line rate, which sets how much telemetry a port can carry
+            static const uint32_t SERIAL_BAUD = 115200;
+            virtual uint32_t serialBaud(uint8_t port) { (void)port; return SERIAL_BAUD; }
+
+            // Bulk transfers; read returns how many bytes it got, up to count, without blocking
+            virtual uint16_t serialRead(uint8_t port, uint8_t * buf, uint16_t count) { (void)port; (void)buf; (void)count; return 0; }
+            virtual void     serialWrite(uint8_t port, const uint8_t * buf, uint16_t count) { (void)port; (void)buf; (void)count; }
 
             //----------------------------------------- Safety -----------------------------------------------------------
             virtual void showArmedStatus(bool armed) { (void)armed; }
@@ -50,6 +74,9 @@ namespace hf {
             //--------------------------------------- Debugging ----------------------------------------------------------
             static  void outbuf(char * buf);
 
+            // Bytes outbuf() can take without blocking, so queued debug messages wait for room
+            virtual uint16_t outbufAvailable(void) { return 0xFFFF; }
+
     }; // class Board
 
 } // namespace
@@ -23,6 +23,7 @@
 #include "board.hpp"
 #include "debugger.hpp"
 #include "datatypes.hpp"
+#include "spscring.hpp"
 
 namespace hf {
 
@@ -36,30 +37,83 @@ namespace hf {
 
             bool _shouldFlash = false;
 
-            // Supports MSP over wireless protcols like Bluetooth
-            bool _useSerialTelemetry = false;
+            float _startupTime = -1;
+
+            static const uint8_t MAX_SERIAL_PORTS = 3;
+
+            // Received bytes wait here for the serial task; big enough for a few ticks at 115200 baud
+            static const uint16_t RX_RING_SIZE = 512;
+
+            typedef SpscRing<uint8_t, RX_RING_SIZE> rxRing_t;
+
+            rxRing_t _rxRings[MAX_SERIAL_PORTS];
+
+            void receive(uint8_t port)
+            {
+                rxRing_t & ring = _rxRings[port];
+
+                uint16_t available = serialPortAvailable(port);
+
+                while (available > 0) {
+
+                    uint8_t buf[32];
+
+                    uint16_t count = available < sizeof(buf) ? available : sizeof(buf);
+
+                    count = serialPortRead(port, buf, count);
+
+                    if (count == 0) {
+                        break;
+                    }
+
+                    // A full ring counts what it drops
+                    for (uint16_t k=0; k<count; ++k) {
+                        ring.push(buf[k]);
+                    }
+
+                    available -= count;
+                }
+            }
 
             float _rollAdjustRadians = 0;
             float _pitchAdjustRadians = 0;
 
         protected:
 
+            // Port numbers; boards may add others, such as a companion computer
+            static const uint8_t SERIAL_PORT_USB       = 0;
+            static const uint8_t SERIAL_PORT_TELEMETRY = 1; // MSP over wireless protocols like Bluetooth
+
             virtual void setLed(bool isOn) = 0;
 
             void init(void)
             {
-                // Flash LED
-                float pauseSeconds = LED_STARTUP_FLASH_SECONDS / LED_STARTUP_FLASH_COUNT;
+                // LED flashes during startup; see startupStep()
                 setLed(false);
-                for (uint8_t i = 0; i < LED_STARTUP_FLASH_COUNT; i++) {
-                    setLed(true);
-                    delaySeconds(pauseSeconds);
+
+                _shouldFlash = false;
+            }
+
+            // Flashes LED without blocking, while other components start
+            virtual bool startupStep(float time) override
+            {
+                if (_startupTime < 0) {
+                    _startupTime = time;
+                }
+
+                float pauseSeconds = LED_STARTUP_FLASH_SECONDS / LED_STARTUP_FLASH_COUNT;
+
+                uint16_t pauses = (uint16_t)((time - _startupTime) / pauseSeconds);
+
+                if (pauses >= 2 * LED_STARTUP_FLASH_COUNT) {
                     setLed(false);
-                    delaySeconds(pauseSeconds);
+                    return true;
                 }
-                setLed(false);
 
-                _shouldFlash = false;
+                // On for one pause, off for the next
+                setLed(pauses % 2 == 0);
+
+                return false;
             }
 
             float getTime(void)
@@ -67,63 +121,56 @@ namespace hf {
                 return micros() / 1.e6f;
             }
 
+            virtual uint32_t getMicros(void) override
+            {
+                return micros();
+            }
+
             void delaySeconds(float sec)
             {
                 delay((uint32_t)(1000*sec));
             }
 
-            uint8_t serialAvailableBytes(void)
+            virtual uint8_t serialPortCount(void) override
             {
-                // Attempt to use telemetry first
-                if (serialTelemetryAvailable()) {
-                    _useSerialTelemetry = true;
-                    return serialTelemetryAvailable();
-                }
-
-                // Default to USB
-                if (serialNormalAvailable() > 0) {
-                    _useSerialTelemetry = false;
-                    return serialNormalAvailable();
-                }
-
-                return 0;
+                return 1; // USB
             }
 
-            uint8_t serialReadByte(void)
+            virtual void serialReceive(void) override
             {
-                return _useSerialTelemetry? serialTelemetryRead() : serialNormalRead();
+                for (uint8_t port=0; port<serialPortCount() && port<MAX_SERIAL_PORTS; ++port) {
+                    receive(port);
+                }
             }
 
-            void serialWriteByte(uint8_t c)
+            virtual uint16_t serialRead(uint8_t port, uint8_t * buf, uint16_t count) override
             {
-                if (_useSerialTelemetry) {
-                    serialTelemetryWrite(c);
+                if (port >= MAX_SERIAL_PORTS) {
+                    return 0;
                 }
-                else {
-                    serialNormalWrite(c);
-                }
-            }
 
-            virtual uint8_t serialNormalAvailable(void) = 0;
+                rxRing_t & ring = _rxRings[port];
 
-            virtual uint8_t serialNormalRead(void) = 0;
+                uint16_t k = 0;
 
-            virtual void    serialNormalWrite(uint8_t c) = 0;
+                while (k < count && ring.pop(buf[k])) {
+                    k++;
+                }
 
-            virtual uint8_t serialTelemetryAvailable(void)
-            {
-                return 0;
+                return k;
             }
 
-            virtual uint8_t serialTelemetryRead(void)
+            virtual void serialWrite(uint8_t port, const uint8_t * buf, uint16_t count) override
             {
-                return 0;
+                serialPortWrite(port, buf, count);
             }
 
-            virtual void serialTelemetryWrite(uint8_t c)
-            {
-                (void)c;
-            }
+            // Port hooks.  Reads need not block: count never exceeds what the port reported available
+            virtual uint16_t serialPortAvailable(uint8_t port) = 0;
+
+            virtual uint16_t serialPortRead(uint8_t port, uint8_t * buf, uint16_t count) = 0;
+
+            virtual void     serialPortWrite(uint8_t port, const uint8_t * buf, uint16_t count) = 0;
 
             void showArmedStatus(bool armed)
             {
@@ -152,16 +199,40 @@ namespace hf {
                 _shouldFlash = shouldflash;
             }
 
+            virtual void applyCalibration(const calibration_t & calibration) override
+            {
+                _rollAdjustRadians  = calibration.rollTrim;
+                _pitchAdjustRadians = calibration.pitchTrim;
+            }
+
+            virtual void captureCalibration(calibration_t & calibration) override
+            {
+                calibration.rollTrim  = _rollAdjustRadians;
+                calibration.pitchTrim = _pitchAdjustRadians;
+            }
+
             void error(const char * errmsg) 
             {
                 while (true) {
                     Debugger::printf("%s\n", errmsg);
+                    Debugger::flush();
                     delaySeconds(0.1);
                 }
             }
  
         public:
 
+            uint32_t getSerialDropCount(void)
+            {
+                uint32_t count = 0;
+
+                for (uint8_t port=0; port<MAX_SERIAL_PORTS; ++port) {
+                    count += _rxRings[port].getDropCount();
+                }
+
+                return count;
+            }
+
             /**
              * Compensates for poorly-mounted IMU.
              */
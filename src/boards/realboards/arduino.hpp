@@ -44,19 +44,26 @@ namespace hf {
                 digitalWrite(_led_pin, isOn ?  (_led_inverted?LOW:HIGH) : (_led_inverted?HIGH:LOW));
             }
 
-            uint8_t serialNormalAvailable(void)
+            virtual uint16_t serialPortAvailable(uint8_t port) override
             {
-                return Serial.available();
+                return port == SERIAL_PORT_USB ? Serial.available() : 0;
             }
 
-            uint8_t serialNormalRead(void)
+            virtual uint16_t serialPortRead(uint8_t port, uint8_t * buf, uint16_t count) override
             {
-                return Serial.read();
+                return port == SERIAL_PORT_USB ? Serial.readBytes(buf, count) : 0;
             }
 
-            void serialNormalWrite(uint8_t c)
+            virtual void serialPortWrite(uint8_t port, const uint8_t * buf, uint16_t count) override
             {
-                Serial.write(c);
+                if (port == SERIAL_PORT_USB) {
+                    Serial.write(buf, count);
+                }
+            }
+
+            virtual uint16_t outbufAvailable(void) override
+            {
+                return Serial.availableForWrite();
             }
 
         public:
@@ -75,7 +82,7 @@ namespace hf {
                 pinMode(_led_pin, OUTPUT);
                 digitalWrite(_led_pin, _led_inverted ? HIGH : LOW);
 
-                Serial.begin(115200);
+                Serial.begin(SERIAL_BAUD);
                 RealBoard::init();
             }
 
@@ -29,19 +29,29 @@ namespace hf {
 
          protected:
 
-            virtual uint8_t serialTelemetryAvailable(void) override
+            virtual uint8_t serialPortCount(void) override
             {
-                return Serial2.available();
+                return 2; // USB and telemetry
             }
 
-            virtual uint8_t serialTelemetryRead(void) override
+            virtual uint16_t serialPortAvailable(uint8_t port) override
             {
-                return Serial2.read();
+                return port == SERIAL_PORT_TELEMETRY ? Serial2.available() : ArduinoBoard::serialPortAvailable(port);
             }
 
-            virtual void serialTelemetryWrite(uint8_t c) override
+            virtual uint16_t serialPortRead(uint8_t port, uint8_t * buf, uint16_t count) override
             {
-                Serial2.write(c);
+                return port == SERIAL_PORT_TELEMETRY ? Serial2.readBytes(buf, count) : ArduinoBoard::serialPortRead(port, buf, count);
+            }
+
+            virtual void serialPortWrite(uint8_t port, const uint8_t * buf, uint16_t count) override
+            {
+                if (port == SERIAL_PORT_TELEMETRY) {
+                    Serial2.write(buf, count);
+                }
+                else {
+                    ArduinoBoard::serialPortWrite(port, buf, count);
+                }
             }
 
          public:
@@ -50,7 +60,7 @@ namespace hf {
                 : ArduinoBoard(13, true) // red LED, active low
             {
                 // Start telemetry on Serial2
-                Serial2.begin(115200);
+                Serial2.begin(SERIAL_BAUD);
 
                 // Use D4 for power, D3 for ground
                 powerPins(4, 3);
@@ -29,19 +29,29 @@ namespace hf {
         protected:
 
 
-            uint8_t serialTelemetryAvailable(void) override
+            uint8_t serialPortCount(void) override
             {
-                return Serial1.available();
+                return 2; // USB and telemetry
             }
 
-            uint8_t serialTelemetryRead(void) override
+            uint16_t serialPortAvailable(uint8_t port) override
             {
-                return Serial1.read();
+                return port == SERIAL_PORT_TELEMETRY ? Serial1.available() : ArduinoBoard::serialPortAvailable(port);
             }
 
-            void serialTelemetryWrite(uint8_t c) override
+            uint16_t serialPortRead(uint8_t port, uint8_t * buf, uint16_t count) override
             {
-                Serial1.write(c);
+                return port == SERIAL_PORT_TELEMETRY ? Serial1.readBytes(buf, count) : ArduinoBoard::serialPortRead(port, buf, count);
+            }
+
+            void serialPortWrite(uint8_t port, const uint8_t * buf, uint16_t count) override
+            {
+                if (port == SERIAL_PORT_TELEMETRY) {
+                    Serial1.write(buf, count);
+                }
+                else {
+                    ArduinoBoard::serialPortWrite(port, buf, count);
+                }
             }
 
         public:
@@ -51,7 +61,7 @@ namespace hf {
             {
 
                 // Set up to receive telemetry over Serial1
-                Serial1.begin(115200);
+                Serial1.begin(SERIAL_BAUD);
                 _time = 0;
             }
 
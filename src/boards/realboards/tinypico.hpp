@@ -44,38 +44,39 @@ namespace hf {
                 tp.DotStar_SetPixelColor(0, isOn?255:0, 0);
             }
 
-            uint8_t serialNormalAvailable(void)
+            virtual uint16_t serialPortAvailable(uint8_t port) override
             {
-                return Serial.available();
+                return port == SERIAL_PORT_USB ? Serial.available() : 0;
             }
 
-            uint8_t serialNormalRead(void)
+            virtual uint16_t serialPortRead(uint8_t port, uint8_t * buf, uint16_t count) override
             {
-                return Serial.read();
+                return port == SERIAL_PORT_USB ? Serial.readBytes(buf, count) : 0;
             }
 
-            void serialNormalWrite(uint8_t c)
+            virtual void serialPortWrite(uint8_t port, const uint8_t * buf, uint16_t count) override
             {
-                Serial.write(c);
+                if (port == SERIAL_PORT_USB) {
+                    Serial.write(buf, count);
+                }
+            }
+
+            virtual uint16_t outbufAvailable(void) override
+            {
+                return Serial.availableForWrite();
             }
 
          public:
 
             TinyPico(void) 
             {
-                Serial.begin(115200);
+                Serial.begin(SERIAL_BAUD);
 
-                // This will blink the LED
+                // LED will blink during startup
                 RealBoard::init();
 
-                // Hang a bit 
-                delay(100);
-
-                // Start I^2C
+                // Start I^2C; IMU waits for power to settle during startup
                 Wire.begin();
-
-                // Hang a bit
-                delay(100);
             }
 
     }; // class TinyPico
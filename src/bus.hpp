@@ -0,0 +1,87 @@
+/*
+   Abstract class for sensor buses (I^2C, SPI)
+
+   Supports multi-register burst transactions, and counts transactions and
+   bytes so that drivers can be compared on the host using MockBus.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    class Bus {
+
+        private:
+
+            uint32_t _transactionCount = 0;
+            uint32_t _byteCount = 0;
+
+        protected:
+
+            // Reads count consecutive registers starting at reg, in a single transaction
+            virtual bool readRegisters(uint8_t address, uint8_t reg, uint8_t count, uint8_t * dst) = 0;
+
+            virtual bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) = 0;
+
+        public:
+
+            bool read(uint8_t address, uint8_t reg, uint8_t count, uint8_t * dst)
+            {
+                _transactionCount++;
+                _byteCount += count;
+
+                return readRegisters(address, reg, count, dst);
+            }
+
+            uint8_t readByte(uint8_t address, uint8_t reg)
+            {
+                uint8_t value = 0;
+                read(address, reg, 1, &value);
+                return value;
+            }
+
+            bool write(uint8_t address, uint8_t reg, uint8_t value)
+            {
+                _transactionCount++;
+                _byteCount++;
+
+                return writeRegister(address, reg, value);
+            }
+
+            uint32_t getTransactionCount(void)
+            {
+                return _transactionCount;
+            }
+
+            uint32_t getByteCount(void)
+            {
+                return _byteCount;
+            }
+
+            void resetCounts(void)
+            {
+                _transactionCount = 0;
+                _byteCount = 0;
+            }
+
+    }; // class Bus
+
+} // namespace hf
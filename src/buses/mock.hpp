@@ -0,0 +1,75 @@
+/*
+   Mock sensor bus for testing
+
+   Serves reads and writes from an in-memory register image for a single
+   device, so drivers can be exercised on the host and their transaction
+   counts and byte volumes checked.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string.h>
+
+#include "bus.hpp"
+
+namespace hf {
+
+    class MockBus : public Bus {
+
+        private:
+
+            uint8_t _address = 0;
+
+        protected:
+
+            virtual bool readRegisters(uint8_t address, uint8_t reg, uint8_t count, uint8_t * dst) override
+            {
+                if (address != _address || reg + count > 256) {
+                    return false;
+                }
+
+                memcpy(dst, &registers[reg], count);
+
+                return true;
+            }
+
+            virtual bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) override
+            {
+                if (address != _address) {
+                    return false;
+                }
+
+                registers[reg] = value;
+
+                return true;
+            }
+
+        public:
+
+            // Register image of the simulated device
+            uint8_t registers[256] = {0};
+
+            MockBus(uint8_t address)
+            {
+                _address = address;
+            }
+
+    }; // class MockBus
+
+} // namespace hf
@@ -0,0 +1,93 @@
+/*
+   Simulated non-blocking sensor bus for testing
+
+   Serves transactions from an in-memory register image for a single device,
+   completing each one after a configurable latency.  Lets asynchronous
+   drivers be exercised on the host without hardware.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string.h>
+
+#include "asyncbus.hpp"
+
+namespace hf {
+
+    class SimulatedBus : public AsyncBus {
+
+        public:
+
+            static const uint16_t REGISTER_COUNT = 1024;
+
+        private:
+
+            uint8_t _address = 0;
+
+            float _latency = 0;
+            float _latencyPerByte = 0;
+
+            float _doneTime = 0;
+
+        protected:
+
+            virtual void startTransfer(transaction_t * t, float time) override
+            {
+                _doneTime = time + _latency + t->count * _latencyPerByte;
+            }
+
+            virtual bool transferDone(transaction_t * t, float time) override
+            {
+                if (time < _doneTime) {
+                    return false;
+                }
+
+                if (t->address != _address || t->reg + t->count > REGISTER_COUNT) {
+                    t->status = FAILED;
+                    return true;
+                }
+
+                if (t->write) {
+                    memcpy(&registers[t->reg], t->data, t->count);
+                }
+                else {
+                    memcpy(t->data, &registers[t->reg], t->count);
+                }
+
+                t->status = COMPLETE;
+
+                return true;
+            }
+
+        public:
+
+            // Register image of the simulated device
+            uint8_t registers[REGISTER_COUNT] = {0};
+
+            // latency: seconds per transaction; latencyPerByte: additional seconds per data byte
+            SimulatedBus(uint8_t address, float latency=0, float latencyPerByte=0)
+            {
+                _address = address;
+                _latency = latency;
+                _latencyPerByte = latencyPerByte;
+            }
+
+    }; // class SimulatedBus
+
+} // namespace hf
@@ -0,0 +1,76 @@
+/*
+   Arduino Wire (I^2C) implementation of sensor bus
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Wire.h>
+
+#include "bus.hpp"
+
+namespace hf {
+
+    class WireBus : public Bus {
+
+        private:
+
+            TwoWire * _wire = NULL;
+
+        protected:
+
+            virtual bool readRegisters(uint8_t address, uint8_t reg, uint8_t count, uint8_t * dst) override
+            {
+                _wire->beginTransmission(address);
+                _wire->write(reg);
+
+                // Repeated start keeps register pointer and burst in one transaction
+                if (_wire->endTransmission(false) != 0) {
+                    return false;
+                }
+
+                if (_wire->requestFrom(address, count) != count) {
+                    return false;
+                }
+
+                for (uint8_t k=0; k<count; ++k) {
+                    dst[k] = _wire->read();
+                }
+
+                return true;
+            }
+
+            virtual bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) override
+            {
+                _wire->beginTransmission(address);
+                _wire->write(reg);
+                _wire->write(value);
+
+                return _wire->endTransmission() == 0;
+            }
+
+        public:
+
+            WireBus(TwoWire & wire=Wire)
+            {
+                _wire = &wire;
+            }
+
+    }; // class WireBus
+
+} // namespace hf
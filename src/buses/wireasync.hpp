@@ -0,0 +1,102 @@
+/*
+   Arduino Wire (I^2C) implementation of non-blocking sensor bus
+
+   Wire itself is blocking, so each transaction completes as soon as it starts.
+   Drivers still issue at most one transaction per update instead of a blocking
+   sequence.  Boards with interrupt- or DMA-driven I^2C can subclass AsyncBus to
+   overlap transfers with PID computation.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Wire.h>
+
+#include "asyncbus.hpp"
+
+namespace hf {
+
+    class WireAsyncBus : public AsyncBus {
+
+        private:
+
+            TwoWire * _wire = NULL;
+
+            void writeRegisterAddress(transaction_t * t)
+            {
+                _wire->beginTransmission(t->address);
+
+                if (t->regSize == 2) {
+                    _wire->write(t->reg >> 8);
+                }
+                _wire->write(t->reg & 0xFF);
+            }
+
+            bool transfer(transaction_t * t)
+            {
+                writeRegisterAddress(t);
+
+                if (t->write) {
+                    for (uint8_t k=0; k<t->count; ++k) {
+                        _wire->write(t->data[k]);
+                    }
+                    return _wire->endTransmission() == 0;
+                }
+
+                if (_wire->endTransmission(false) != 0) {
+                    return false;
+                }
+
+                if (_wire->requestFrom(t->address, t->count) != t->count) {
+                    return false;
+                }
+
+                for (uint8_t k=0; k<t->count; ++k) {
+                    t->data[k] = _wire->read();
+                }
+
+                return true;
+            }
+
+        protected:
+
+            virtual void startTransfer(transaction_t * t, float time) override
+            {
+                (void)time;
+
+                t->status = transfer(t) ? COMPLETE : FAILED;
+            }
+
+            virtual bool transferDone(transaction_t * t, float time) override
+            {
+                (void)t;
+                (void)time;
+
+                return true;
+            }
+
+        public:
+
+            WireAsyncBus(TwoWire & wire=Wire)
+            {
+                _wire = &wire;
+            }
+
+    }; // class WireAsyncBus
+
+} // namespace hf
@@ -0,0 +1,139 @@
+/*
+   Persistent calibration store
+
+   Holds gyrometer bias, accelerometer offsets, magnetometer calibration,
+   level trim and USFS warm-start parameters.  Records are versioned and
+   CRC-protected, so a blank, stale or corrupt store is ignored and the
+   defaults are used instead.  Subclasses supply the storage (EEPROM, flash,
+   a file on the host).
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+namespace hf {
+
+    typedef struct {
+
+        float gyroBias[3];      // radians / sec
+        float accelOffset[3];   // Gs
+        float magBias[3];
+        float magScale[3];
+
+        // Level trim, as set by RealBoard::setRollAndPitchOffsets()
+        float rollTrim;         // radians
+        float pitchTrim;        // radians
+
+        // SENtral warm-start parameters: 35 four-byte values
+        bool    haveWarmStart;
+        uint8_t warmStart[140];
+
+    } calibration_t;
+
+    class CalibrationStore {
+
+        private:
+
+            static const uint32_t MAGIC   = 0x4C434648; // "HFCL"
+            static const uint16_t VERSION = 1;
+
+            typedef struct {
+                uint32_t magic;
+                uint16_t version;
+                uint16_t size;
+            } header_t;
+
+            static const uint16_t PAYLOAD_OFFSET = sizeof(header_t);
+            static const uint16_t CRC_OFFSET     = PAYLOAD_OFFSET + sizeof(calibration_t);
+
+            static uint32_t crc32(const uint8_t * data, uint16_t count, uint32_t crc=0xFFFFFFFF)
+            {
+                for (uint16_t k=0; k<count; ++k) {
+                    crc ^= data[k];
+                    for (uint8_t b=0; b<8; ++b) {
+                        crc = (crc >> 1) ^ (0xEDB88320 & (-(int32_t)(crc & 1)));
+                    }
+                }
+                return crc;
+            }
+
+            static uint32_t crc32(const header_t & header, const calibration_t & calibration)
+            {
+                uint32_t crc = crc32((const uint8_t *)&header, sizeof(header_t));
+                return ~crc32((const uint8_t *)&calibration, sizeof(calibration_t), crc);
+            }
+
+        protected:
+
+            virtual bool readBytes(uint16_t offset, uint8_t * dst, uint16_t count) = 0;
+
+            virtual bool writeBytes(uint16_t offset, const uint8_t * src, uint16_t count) = 0;
+
+            // Some storage (e.g., emulated EEPROM) must be committed after writing
+            virtual bool commit(void)
+            {
+                return true;
+            }
+
+        public:
+
+            // Bytes of storage needed
+            static const uint16_t SIZE = CRC_OFFSET + sizeof(uint32_t);
+
+            calibration_t calibration = {};
+
+            // Returns false, leaving calibration unchanged, if the store is blank, from another version, or corrupt
+            bool load(void)
+            {
+                header_t header = {};
+                calibration_t stored = {};
+                uint32_t crc = 0;
+
+                if (!readBytes(0, (uint8_t *)&header, sizeof(header_t)) ||
+                        header.magic != MAGIC || header.version != VERSION || header.size != sizeof(calibration_t)) {
+                    return false;
+                }
+
+                if (!readBytes(PAYLOAD_OFFSET, (uint8_t *)&stored, sizeof(calibration_t)) ||
+                        !readBytes(CRC_OFFSET, (uint8_t *)&crc, sizeof(uint32_t)) ||
+                        crc != crc32(header, stored)) {
+                    return false;
+                }
+
+                memcpy(&calibration, &stored, sizeof(calibration_t));
+
+                return true;
+            }
+
+            bool save(void)
+            {
+                header_t header = {MAGIC, VERSION, sizeof(calibration_t)};
+                uint32_t crc = crc32(header, calibration);
+
+                return writeBytes(0, (const uint8_t *)&header, sizeof(header_t)) &&
+                    writeBytes(PAYLOAD_OFFSET, (const uint8_t *)&calibration, sizeof(calibration_t)) &&
+                    writeBytes(CRC_OFFSET, (const uint8_t *)&crc, sizeof(uint32_t)) &&
+                    commit();
+            }
+
+    }; // class CalibrationStore
+
+} // namespace hf
@@ -0,0 +1,78 @@
+/*
+   EEPROM implementation of calibration store for Arduino boards
+
+   On ESP32 and other boards that emulate EEPROM in flash, the EEPROM library
+   must be started with a size and committed after writing.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <EEPROM.h>
+
+#include "calibration.hpp"
+
+namespace hf {
+
+    class EepromCalibrationStore : public CalibrationStore {
+
+        private:
+
+            uint16_t _address = 0;
+
+        protected:
+
+            virtual bool readBytes(uint16_t offset, uint8_t * dst, uint16_t count) override
+            {
+                for (uint16_t k=0; k<count; ++k) {
+                    dst[k] = EEPROM.read(_address + offset + k);
+                }
+                return true;
+            }
+
+            virtual bool writeBytes(uint16_t offset, const uint8_t * src, uint16_t count) override
+            {
+                for (uint16_t k=0; k<count; ++k) {
+                    EEPROM.write(_address + offset + k, src[k]);
+                }
+                return true;
+            }
+
+            virtual bool commit(void) override
+            {
+#ifdef ESP32
+                return EEPROM.commit();
+#else
+                return true;
+#endif
+            }
+
+        public:
+
+            EepromCalibrationStore(uint16_t address=0)
+            {
+                _address = address;
+
+#ifdef ESP32
+                EEPROM.begin(_address + SIZE);
+#endif
+            }
+
+    }; // class EepromCalibrationStore
+
+} // namespace hf
@@ -0,0 +1,82 @@
+/*
+   File implementation of calibration store, for running on the host
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include "calibration.hpp"
+
+namespace hf {
+
+    class FileCalibrationStore : public CalibrationStore {
+
+        private:
+
+            const char * _path = NULL;
+
+            bool transfer(const char * mode, uint16_t offset, uint8_t * data, uint16_t count, bool write)
+            {
+                FILE * fp = fopen(_path, mode);
+
+                if (!fp) {
+                    return false;
+                }
+
+                bool ok = fseek(fp, offset, SEEK_SET) == 0 &&
+                    (write ? fwrite(data, 1, count, fp) : fread(data, 1, count, fp)) == count;
+
+                fclose(fp);
+
+                return ok;
+            }
+
+        protected:
+
+            virtual bool readBytes(uint16_t offset, uint8_t * dst, uint16_t count) override
+            {
+                return transfer("rb", offset, dst, count, false);
+            }
+
+            virtual bool writeBytes(uint16_t offset, const uint8_t * src, uint16_t count) override
+            {
+                // Create the file on first write, then update it in place
+                FILE * fp = fopen(_path, "r+b");
+
+                if (fp) {
+                    fclose(fp);
+                }
+                else if ((fp = fopen(_path, "wb"))) {
+                    fclose(fp);
+                }
+
+                return transfer("r+b", offset, (uint8_t *)src, count, true);
+            }
+
+        public:
+
+            FileCalibrationStore(const char * path)
+            {
+                _path = path;
+            }
+
+    }; // class FileCalibrationStore
+
+} // namespace hf
@@ -0,0 +1,89 @@
+/*
+   Data-ready interrupt bookkeeping, shared by sensors and IMUs
+
+   The interrupt routine counts interrupts into a latest-value slot; the main
+   loop compares the latest count with the last one whose data it actually
+   read.  An interrupt therefore stays pending until a read succeeds, so a
+   failed read is retried on the next update instead of losing the sample.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "latestvalue.hpp"
+
+namespace hf {
+
+    class DataReady {
+
+        friend class Sensor;
+        friend class IMU;
+
+        private:
+
+            bool _inUse = false;
+
+            // Written by the interrupt routine, read by the main loop
+            LatestValue<uint32_t> _interrupts;
+            uint32_t _interruptCount = 0;
+
+            // Main loop only: the latest interrupt seen, and the latest one whose data was actually read
+            uint32_t _latest = 0;
+            uint32_t _handled = 0;
+
+        protected:
+
+            void use(void)
+            {
+                _inUse = true;
+            }
+
+            bool inUse(void)
+            {
+                return _inUse;
+            }
+
+            // Called from the interrupt routine
+            void interrupt(void)
+            {
+                _interrupts.write(++_interruptCount);
+            }
+
+            // True if an interrupt hasn't been handled yet; always true when no data-ready pin is in use
+            bool pending(void)
+            {
+                if (!_inUse) {
+                    return true;
+                }
+
+                _interrupts.read(_latest);
+
+                return _latest != _handled;
+            }
+
+            // Call once the data has been read, and not before
+            void handled(void)
+            {
+                _handled = _latest;
+            }
+
+    }; // class DataReady
+
+} // namespace hf
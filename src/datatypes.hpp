@@ -20,6 +20,11 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <string.h>
+
+#include "fastmath.hpp"
+
 namespace hf {
 
     enum {
@@ -28,6 +33,18 @@ namespace hf {
         AXIS_YAW
     };
 
+    // Vehicle-state fields whose changes are counted, so that PID controllers can
+    // skip recomputing when nothing they depend on has changed
+    enum {
+        STATE_ROTATION = 0,
+        STATE_ANGULAR_VEL,
+        STATE_LOCATION,
+        STATE_BODY_ACCEL,
+        STATE_BODY_VEL,
+        STATE_INERTIAL_VEL,
+        STATE_FIELD_COUNT
+    };
+
     typedef struct {
 
         float throttle;
@@ -37,18 +54,117 @@ namespace hf {
 
     } demands_t;
 
-    typedef struct {
+    typedef struct state_t {
 
         bool armed;
         bool failsafe;
 
         float location[3];
-        float rotation[3]; 
         float angularVel[3]; 
         float bodyAccel[3]; 
         float bodyVel[3]; 
         float inertialVel[3]; 
 
+        // Primary attitude representation; use setQuaternion() to change it.  Hackflight starts it at the identity.
+        float quaternion[4];
+
+        // Incremented by sensors each time they modify the corresponding field
+        uint32_t changes[STATE_FIELD_COUNT];
+
+        void markChanged(uint8_t field)
+        {
+            changes[field]++;
+        }
+
+        void setQuaternion(float qw, float qx, float qy, float qz)
+        {
+            quaternion[0] = qw;
+            quaternion[1] = qx;
+            quaternion[2] = qy;
+            quaternion[3] = qz;
+
+            // Invalidate the derived representations
+            _rotationValid = 0;
+            _rotationMatrixValid = false;
+
+            markChanged(STATE_ROTATION);
+        }
+
+        // Euler angle for one axis of a quaternion, with heading in [-pi,+pi]
+        static float eulerAngle(float qw, float qx, float qy, float qz, uint8_t axis)
+        {
+            switch (axis) {
+
+                case AXIS_ROLL:
+                    return FastMath::atan2(2.0f*(qw*qx+qy*qz),qw*qw-qx*qx-qy*qy+qz*qz);
+
+                case AXIS_PITCH:
+                    return FastMath::asin(2.0f*(qx*qz-qw*qy));
+
+                case AXIS_YAW:
+                    return FastMath::atan2(2.0f*(qx*qy+qw*qz),qw*qw+qx*qx-qy*qy-qz*qz);
+
+                default:
+                    return 0;
+            }
+        }
+
+        // Euler angle for one axis, computed from the quaternion on first access; heading is in [0,2*pi]
+        float getRotation(uint8_t axis)
+        {
+            if (axis > AXIS_YAW) {
+                return 0;
+            }
+
+            uint8_t bit = 1 << axis;
+
+            if (!(_rotationValid & bit)) {
+
+                float angle = eulerAngle(quaternion[0], quaternion[1], quaternion[2], quaternion[3], axis);
+
+                if (axis == AXIS_YAW && angle < 0) {
+                    angle += 2*3.14159265f;
+                }
+
+                _rotation[axis] = angle;
+
+                _rotationValid |= bit;
+            }
+
+            return _rotation[axis];
+        }
+
+        // Body-to-earth rotation matrix, computed from the quaternion on first access
+        void getRotationMatrix(float R[3][3])
+        {
+            if (!_rotationMatrixValid) {
+
+                float * q = quaternion;
+
+                _rotationMatrix[0][0] = q[0] * q[0] + q[1] * q[1] - q[2] * q[2] - q[3] * q[3];
+                _rotationMatrix[0][1] = 2 * q[1] * q[2] - 2 * q[0] * q[3];
+                _rotationMatrix[0][2] = 2 * q[1] * q[3] + 2 * q[0] * q[2];
+
+                _rotationMatrix[1][0] = 2 * q[1] * q[2] + 2 * q[0] * q[3];
+                _rotationMatrix[1][1] = q[0] * q[0] - q[1] * q[1] + q[2] * q[2] - q[3] * q[3];
+                _rotationMatrix[1][2] = 2 * q[2] * q[3] - 2 * q[0] * q[1];
+
+                _rotationMatrix[2][0] = 2 * q[1] * q[3] - 2 * q[0] * q[2];
+                _rotationMatrix[2][1] = 2 * q[2] * q[3] + 2 * q[0] * q[1];
+                _rotationMatrix[2][2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+                _rotationMatrixValid = true;
+            }
+
+            memcpy(R, _rotationMatrix, sizeof(_rotationMatrix));
+        }
+
+        // Cached representations, valid until the next setQuaternion()
+        float   _rotation[3]; 
+        uint8_t _rotationValid;
+        float   _rotationMatrix[3][3];
+        bool    _rotationMatrixValid;
+
     } state_t;
 
 } // namespace hf
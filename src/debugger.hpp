@@ -5,6 +5,12 @@
     debug messages.  Your Board implementation should provide and outbuf(char
     method that displays the message in an appropriate way.
 
+    While Hackflight is running, printf() just queues the format string and
+    its arguments, and the messages are formatted and written out in the
+    time left over after the scheduled tasks, only as fast as the board's
+    transmit buffer has room, so debugging output never stalls the control
+    loop.  Both cores may print in dual-core mode.
+
     Copyright (c) 2018 Simon D. Levy
 
     This file is part of Hackflight.
@@ -24,10 +30,15 @@
 
 #pragma once
 
-#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "board.hpp"
+#include "spscring.hpp"
+
+#ifndef HF_DEBUG_RING_SIZE
+#define HF_DEBUG_RING_SIZE 32
+#endif
 
 namespace hf {
 
@@ -41,33 +52,222 @@ namespace hf {
 
             static constexpr float _adhoc_period = 1.f / ADHOC_RATE;
 
+            static const uint8_t  MAX_ARGS = 8;
+            static const uint16_t MAX_MESSAGE = 200;
+
+            static const uint8_t MAX_FLOAT_PRECISION = 6;
+
+            typedef union {
+                int32_t      i;
+                uint32_t     u;
+                float        f;
+                const char * s;
+            } arg_t;
+
+            // The format string's address identifies the message
+            typedef struct {
+                const char * fmt;
+                uint8_t      count;
+                arg_t        args[MAX_ARGS];
+            } message_t;
+
+            // Each core takes a flag before pushing, so the ring still sees one producer at a time; a core that finds
+            // the other pushing drops its message rather than wait.  The consumer side has its own flag, since fatal
+            // errors flush from whichever core hits them.
+            typedef struct {
+                SpscRing<message_t, HF_DEBUG_RING_SIZE> ring;
+                bool     deferred;
+                bool     pushing;
+                bool     draining;
+                uint32_t contendedDrops;
+                uint32_t reportedDrops;
+                char     pending[MAX_MESSAGE];
+                uint16_t pendingSize;
+                uint16_t pendingSent;
+            } queue_t;
+
+            static queue_t & queue(void)
+            {
+                static queue_t queue;
+                return queue;
+            }
+
             Board * _board;
 
             float _prevTime;
 
-        protected:
+            static arg_t toArg(int value)           { arg_t a; a.i = value; return a; }
+            static arg_t toArg(long value)          { arg_t a; a.i = value; return a; }
+            static arg_t toArg(unsigned value)      { arg_t a; a.u = value; return a; }
+            static arg_t toArg(unsigned long value) { arg_t a; a.u = value; return a; }
+            static arg_t toArg(double value)        { arg_t a; a.f = value; return a; }
+            static arg_t toArg(const char * value)  { arg_t a; a.s = value; return a; }
 
-            void init(Board * board)
+            // Formats one conversion (like %+3.3f) with snprintf, passing the argument with the right type
+            static int formatArg(char * buf, uint16_t size, char * spec, uint8_t length, arg_t arg)
             {
-                _board = board;
+                char conversion = spec[length-1];
+
+                switch (conversion) {
+
+                    case 'd':
+                    case 'i':
+                    case 'u':
+                    case 'x':
+                    case 'X':
+                    case 'o':
+                        // Arguments are 32 bits wide, even where int is 16
+                        spec[length-1] = 'l';
+                        spec[length]   = conversion;
+                        spec[length+1] = 0;
+                        return (conversion == 'd' || conversion == 'i') ?
+                            snprintf(buf, size, spec, (long)arg.i) :
+                            snprintf(buf, size, spec, (unsigned long)arg.u);
+
+                    case 'c':
+                        return snprintf(buf, size, spec, (int)arg.i);
+
+                    case 'f':
+                    case 'e':
+                    case 'E':
+                    case 'g':
+                    case 'G':
+                        return snprintf(buf, size, spec, (double)arg.f);
+
+                    case 's':
+                        return snprintf(buf, size, spec, arg.s ? arg.s : "(null)");
+
+                    default:
+                        return snprintf(buf, size, "%s", spec);
+                }
             }
 
-        public:
+            static void format(const message_t & message, char * buf, uint16_t size)
+            {
+                const char * p = message.fmt;
+                uint16_t n = 0;
+                uint8_t argIndex = 0;
+
+                while (*p && n < size-1) {
+
+                    if (*p != '%') {
+                        buf[n++] = *p++;
+                        continue;
+                    }
+
+                    if (p[1] == '%') {
+                        buf[n++] = '%';
+                        p += 2;
+                        continue;
+                    }
+
+                    // Flags, width and precision are kept; length modifiers are dropped
+                    char spec[16] = {'%'};
+                    uint8_t length = 1;
+                    p++;
+
+                    while (*p && strchr("-+ #0123456789.", *p) && length < 12) {
+                        spec[length++] = *p++;
+                    }
 
-            static void printf(const char * fmt, ...)
+                    while (*p && strchr("hlLzjt", *p)) {
+                        p++;
+                    }
+
+                    if (!*p) {
+                        break;
+                    }
+
+                    spec[length++] = *p++;
+
+                    arg_t arg = {};
+                    if (argIndex < message.count) {
+                        arg = message.args[argIndex++];
+                    }
+
+                    int written = formatArg(&buf[n], size-n, spec, length, arg);
+
+                    if (written > 0) {
+                        n += (written < size-n) ? written : size-1-n;
+                    }
+                }
+
+                buf[n] = 0;
+            }
+
+            static void output(const message_t & message)
             {
-                va_list ap;
-                va_start(ap, fmt);
-                char buf[200];
-                vsnprintf(buf, 200, fmt, ap); 
+                char buf[MAX_MESSAGE];
+                format(message, buf, MAX_MESSAGE);
                 Board::outbuf(buf);
-                va_end(ap);
             }
 
-            // for boards that do not support floating-point vnsprintf
-            static void printfloat(float val, uint8_t prec=3)
+            static uint32_t dropCount(queue_t & q)
+            {
+                return q.ring.getDropCount() + __atomic_load_n(&q.contendedDrops, __ATOMIC_RELAXED);
+            }
+
+            // Formats the next drop report or queued message, if there's nothing left of the previous one
+            static bool nextPending(queue_t & q)
+            {
+                if (q.pendingSent < q.pendingSize) {
+                    return true;
+                }
+
+                uint32_t drops = dropCount(q);
+
+                message_t message;
+
+                if (drops != q.reportedDrops) {
+                    snprintf(q.pending, MAX_MESSAGE, "[%lu debug messages dropped]\n", (unsigned long)(drops - q.reportedDrops));
+                    q.reportedDrops = drops;
+                }
+                else if (q.ring.pop(message)) {
+                    format(message, q.pending, MAX_MESSAGE);
+                }
+                else {
+                    return false;
+                }
+
+                q.pendingSize = strlen(q.pending);
+                q.pendingSent = 0;
+
+                return q.pendingSize > 0;
+            }
+
+            // Writes out as much pending output as the space allows; a message cut short is finished before the next
+            // one starts.  The caller must hold the draining flag.
+            static void drain(queue_t & q, uint16_t space)
+            {
+                while (space > 0 && nextPending(q)) {
+
+                    uint16_t remaining = q.pendingSize - q.pendingSent;
+
+                    uint16_t count = remaining < space ? remaining : space;
+
+                    char * chunk = &q.pending[q.pendingSent];
+                    char saved = chunk[count];
+                    chunk[count] = 0;
+                    Board::outbuf(chunk);
+                    chunk[count] = saved;
+
+                    q.pendingSent += count;
+                    space -= count;
+                }
+            }
+
+            static void queueFloat(float val, uint8_t prec, bool newline)
             {
-                uint16_t mul = 1;
+                static const char * const formats[2][MAX_FLOAT_PRECISION+1] = {
+                    {"%c%u",   "%c%u.%01u",   "%c%u.%02u",   "%c%u.%03u",   "%c%u.%04u",   "%c%u.%05u",   "%c%u.%06u"},
+                    {"%c%u\n", "%c%u.%01u\n", "%c%u.%02u\n", "%c%u.%03u\n", "%c%u.%04u\n", "%c%u.%05u\n", "%c%u.%06u\n"}
+                };
+
+                if (prec > MAX_FLOAT_PRECISION) {
+                    prec = MAX_FLOAT_PRECISION;
+                }
+
+                uint32_t mul = 1;
                 for (uint8_t k=0; k<prec; ++k) {
                     mul *= 10;
                 }
@@ -77,13 +277,93 @@ namespace hf {
                     sgn = '-';
                 }
                 uint32_t bigval = (uint32_t)(val*mul);
-                Debugger::printf("%c%d.%d", sgn, bigval/mul, bigval % mul);
+                printf(formats[newline][prec], sgn, (unsigned long)(bigval/mul), (unsigned long)(bigval % mul));
+            }
+
+        protected:
+
+            void init(Board * board)
+            {
+                _board = board;
+            }
+
+            static void defer(bool deferred)
+            {
+                queue().deferred = deferred;
+            }
+
+            // Writes out queued messages as far as the board's transmit buffer has room; called in the time left over
+            // after the scheduled tasks.  Returns at once if another core is already writing.
+            void update(void)
+            {
+                queue_t & q = queue();
+
+                if (__atomic_test_and_set(&q.draining, __ATOMIC_ACQUIRE)) {
+                    return;
+                }
+
+                drain(q, _board->outbufAvailable());
+
+                __atomic_clear(&q.draining, __ATOMIC_RELEASE);
+            }
+
+        public:
+
+            // Arguments are stored as 32-bit values, and strings by address, so %s arguments must outlive the
+            // call (as string literals do)
+            template <typename... Args>
+            static void printf(const char * fmt, Args... args)
+            {
+                static_assert(sizeof...(Args) <= MAX_ARGS, "Too many arguments for Debugger::printf()");
+
+                message_t message;
+                message.fmt = fmt;
+                message.count = sizeof...(Args);
+
+                const arg_t values[] = {toArg(args)..., arg_t()};
+                memcpy(message.args, values, sizeof...(Args) * sizeof(arg_t));
+
+                queue_t & q = queue();
+
+                if (!q.deferred) {
+                    output(message);
+                }
+                else if (__atomic_test_and_set(&q.pushing, __ATOMIC_ACQUIRE)) {
+                    __atomic_fetch_add(&q.contendedDrops, 1, __ATOMIC_RELAXED);
+                }
+                else {
+                    q.ring.push(message);
+                    __atomic_clear(&q.pushing, __ATOMIC_RELEASE);
+                }
+            }
+
+            // Writes out everything queued, waiting for the transmit buffer; for use before halting on a fatal error
+            static void flush(void)
+            {
+                queue_t & q = queue();
+
+                while (__atomic_test_and_set(&q.draining, __ATOMIC_ACQUIRE)) {
+                }
+
+                drain(q, 0xFFFF);
+
+                __atomic_clear(&q.draining, __ATOMIC_RELEASE);
+            }
+
+            static uint32_t getDroppedCount(void)
+            {
+                return dropCount(queue());
+            }
+
+            // for boards that do not support floating-point vnsprintf; each call queues a single message
+            static void printfloat(float val, uint8_t prec=3)
+            {
+                queueFloat(val, prec, false);
             }
 
             static void printlnfloat(float val, uint8_t prec=3)
             {
-                printfloat(val, prec);
-                printf("\n");
+                queueFloat(val, prec, true);
             }
 
         }; // class Debugger
@@ -0,0 +1,195 @@
+/*
+   Fast approximations of transcendental functions
+
+   Each kernel has a documented worst-case error, measured against the double-
+   precision C library over its full input range.  Define HF_FASTMATH as 0
+   before including any Hackflight header to fall back on the C library.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef HF_FASTMATH
+#define HF_FASTMATH 1
+#endif
+
+namespace hf {
+
+    class FastMath {
+
+        private:
+
+            static constexpr float PI      = 3.14159265f;
+            static constexpr float HALF_PI = 1.57079633f;
+
+            // Cody-Waite split of pi/2 keeps range reduction exact for |x| < 1e4
+            static constexpr float HALF_PI_HI = 1.5703125f;
+            static constexpr float HALF_PI_LO = 4.83826794897e-4f;
+
+            // atan(z) for |z| <= 1, odd minimax polynomial of degree 11
+            static float atanUnit(float z)
+            {
+                float z2 = z * z;
+
+                return z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f +
+                                z2 * (-0.11643287f + z2 * (0.05265332f + z2 * -0.01172120f)))));
+            }
+
+            // sin(r), cos(r) for |r| <= pi/4, Taylor polynomials of degree 9 and 8
+            static float sinQuadrant(float r)
+            {
+                float r2 = r * r;
+
+                return r * (1 + r2 * (-1.66666667e-1f + r2 * (8.33333333e-3f +
+                                r2 * (-1.98412698e-4f + r2 * 2.75573192e-6f))));
+            }
+
+            static float cosQuadrant(float r)
+            {
+                float r2 = r * r;
+
+                return 1 + r2 * (-0.5f + r2 * (4.16666667e-2f +
+                            r2 * (-1.38888889e-3f + r2 * 2.48015873e-5f)));
+            }
+
+        public:
+
+            // Max error 2.0e-6 radians over all (y,x)
+            static float fastAtan2(float y, float x)
+            {
+                float ax = fabsf(x);
+                float ay = fabsf(y);
+
+                if (ax == 0 && ay == 0) {
+                    return 0;
+                }
+
+                // Reduce to the first octant, then unfold
+                float a = (ay > ax) ? HALF_PI - atanUnit(ax / ay) : atanUnit(ay / ax);
+
+                if (x < 0) {
+                    a = PI - a;
+                }
+
+                return (y < 0) ? -a : a;
+            }
+
+            // Max error 6.8e-5 radians over [-1,+1]; arguments outside are clamped
+            static float fastAsin(float x)
+            {
+                float ax = fabsf(x);
+
+                if (ax > 1) {
+                    ax = 1;
+                }
+
+                // Abramowitz & Stegun 4.4.45
+                float a = HALF_PI - sqrtf(1 - ax) * (1.5707288f + ax * (-0.2121144f + ax * (0.0742610f + ax * -0.0187293f)));
+
+                return (x < 0) ? -a : a;
+            }
+
+            // Max error 2.0e-7 for either output over |x| < 1e4 radians
+            static void fastSincos(float x, float & s, float & c)
+            {
+                // Reduce to r in [-pi/4,+pi/4] plus quadrant index
+                float k = floorf(x * (1 / HALF_PI) + 0.5f);
+                float r = (x - k * HALF_PI_HI) - k * HALF_PI_LO;
+
+                float sr = sinQuadrant(r);
+                float cr = cosQuadrant(r);
+
+                switch ((int32_t)k & 3) {
+                    case 0:
+                        s =  sr;
+                        c =  cr;
+                        break;
+                    case 1:
+                        s =  cr;
+                        c = -sr;
+                        break;
+                    case 2:
+                        s = -sr;
+                        c = -cr;
+                        break;
+                    default:
+                        s = -cr;
+                        c =  sr;
+                }
+            }
+
+            // Max relative error 4.8e-6 for normal x > 0
+            static float fastRsqrt(float x)
+            {
+                uint32_t i = 0;
+                memcpy(&i, &x, 4);
+                i = 0x5f3759df - (i >> 1);
+
+                float y = 0;
+                memcpy(&y, &i, 4);
+
+                // Two Newton-Raphson iterations
+                float halfx = 0.5f * x;
+                y = y * (1.5f - halfx * y * y);
+                y = y * (1.5f - halfx * y * y);
+
+                return y;
+            }
+
+            // Compile-time selection between fast kernels and C library
+
+            static float atan2(float y, float x)
+            {
+                return HF_FASTMATH ? fastAtan2(y, x) : atan2f(y, x);
+            }
+
+            static float asin(float x)
+            {
+                return HF_FASTMATH ? fastAsin(x) : asinf(x);
+            }
+
+            static void sincos(float x, float & s, float & c)
+            {
+                if (HF_FASTMATH) {
+                    fastSincos(x, s, c);
+                }
+                else {
+                    s = sinf(x);
+                    c = cosf(x);
+                }
+            }
+
+            static float cos(float x)
+            {
+                float s = 0, c = 0;
+                sincos(x, s, c);
+                return c;
+            }
+
+            static float rsqrt(float x)
+            {
+                return HF_FASTMATH ? fastRsqrt(x) : 1 / sqrtf(x);
+            }
+
+    }; // class FastMath
+
+} // namespace hf
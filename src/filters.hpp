@@ -23,6 +23,8 @@
 #include <math.h>
 #include <stdint.h>
 
+#include "fastmath.hpp"
+
 #ifndef M_PI
 static const float M_PI = 3.141593;
 #endif
@@ -180,17 +182,17 @@ namespace hf {
                 float q4q4 = q4 * q4;
 
                 // Normalise accelerometer measurement
-                norm = sqrtf(ax * ax + ay * ay + az * az);
+                norm = ax * ax + ay * ay + az * az;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f/norm;
+                norm = FastMath::rsqrt(norm);
                 ax *= norm;
                 ay *= norm;
                 az *= norm;
 
                 // Normalise magnetometer measurement
-                norm = sqrtf(mx * mx + my * my + mz * mz);
+                norm = mx * mx + my * my + mz * mz;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f/norm;
+                norm = FastMath::rsqrt(norm);
                 mx *= norm;
                 my *= norm;
                 mz *= norm;
@@ -232,8 +234,7 @@ namespace hf {
                     _2bx * q2 * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - mz);
 
                 // Normalize step magnitude
-                norm = sqrtf(s1 * s1 + s2 * s2 + s3 * s3 + s4 * s4);    
-                norm = 1.0f/norm;
+                norm = FastMath::rsqrt(s1 * s1 + s2 * s2 + s3 * s3 + s4 * s4);    
                 s1 *= norm;
                 s2 *= norm;
                 s3 *= norm;
@@ -250,8 +251,7 @@ namespace hf {
                 q2 += qDot2 * deltat;
                 q3 += qDot3 * deltat;
                 q4 += qDot4 * deltat;
-                norm = sqrtf(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);    // normalise quaternion
-                norm = 1.0f/norm;
+                norm = FastMath::rsqrt(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);    // normalise quaternion
             }
     }; // class MadgwickQuaternionFilter9DOF 
 
@@ -287,9 +287,9 @@ namespace hf {
                 //float _2q3q4 = 2.0f * q3 * q4;
 
                 // Normalise accelerometer measurement
-                float norm = sqrt(ax * ax + ay * ay + az * az);
+                float norm = ax * ax + ay * ay + az * az;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f/norm;
+                norm = FastMath::rsqrt(norm);
                 ax *= norm;
                 ay *= norm;
                 az *= norm;
@@ -312,11 +312,11 @@ namespace hf {
                 float hatDot4 = J_14or21 * f1 + J_11or24 * f2;
 
                 // Normalize the gradient
-                norm = sqrt(hatDot1 * hatDot1 + hatDot2 * hatDot2 + hatDot3 * hatDot3 + hatDot4 * hatDot4);
-                hatDot1 /= norm;
-                hatDot2 /= norm;
-                hatDot3 /= norm;
-                hatDot4 /= norm;
+                norm = FastMath::rsqrt(hatDot1 * hatDot1 + hatDot2 * hatDot2 + hatDot3 * hatDot3 + hatDot4 * hatDot4);
+                hatDot1 *= norm;
+                hatDot2 *= norm;
+                hatDot3 *= norm;
+                hatDot4 *= norm;
 
                 // Compute estimated gyroscope biases
                 float gerrx = _2q1 * hatDot2 - _2q2 * hatDot1 - _2q3 * hatDot4 + _2q4 * hatDot3;
@@ -344,8 +344,7 @@ namespace hf {
                 q4 += (qDot4 -(_beta * hatDot4)) * deltat;
 
                 // Normalize the quaternion
-                norm = sqrt(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);    // normalise quaternion
-                norm = 1.0f/norm;
+                norm = FastMath::rsqrt(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);    // normalise quaternion
                 q1 *= norm;
                 q2 *= norm;
                 q3 *= norm;
@@ -396,17 +395,17 @@ namespace hf {
                 float q4q4 = q4 * q4;   
 
                 // Normalise accelerometer measurement
-                norm = sqrtf(ax * ax + ay * ay + az * az);
+                norm = ax * ax + ay * ay + az * az;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f / norm;        // use reciprocal for division
+                norm = FastMath::rsqrt(norm);
                 ax *= norm;
                 ay *= norm;
                 az *= norm;
 
                 // Normalise magnetometer measurement
-                norm = sqrtf(mx * mx + my * my + mz * mz);
+                norm = mx * mx + my * my + mz * mz;
                 if (norm == 0.0f) return; // handle NaN
-                norm = 1.0f / norm;        // use reciprocal for division
+                norm = FastMath::rsqrt(norm);
                 mx *= norm;
                 my *= norm;
                 mz *= norm;
@@ -457,8 +456,7 @@ namespace hf {
                 q4 = pc + (q1 * gz + pa * gy - pb * gx) * (0.5f * deltat);
 
                 // Normalise quaternion
-                norm = sqrtf(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);
-                norm = 1.0f / norm;
+                norm = FastMath::rsqrt(q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4);
                 q1 *= norm;
                 q2 *= norm;
                 q3 *= norm;
@@ -27,7 +27,14 @@
 #include "actuator.hpp"
 #include "receiver.hpp"
 #include "datatypes.hpp"
+#include "snapshot.hpp"
+#include "loadshedder.hpp"
+#include "startup.hpp"
+#include "calibration.hpp"
 #include "pidcontroller.hpp"
+#include "offboard.hpp"
+#include "pidcontrollers/offboard.hpp"
+#include "blackbox.hpp"
 #include "motor.hpp"
 #include "actuators/mixer.hpp"
 #include "actuators/rxproxy.hpp"
@@ -45,6 +52,19 @@ namespace hf {
 
             static constexpr float MAX_ARMING_ANGLE_DEGREES = 25.0f;
 
+            // Limits for rates chosen by calibrateRates()
+            static constexpr float RATE_SAFETY_MARGIN = 2.0f;  // PID period vs. worst-case update period
+            static constexpr float PID_FREQ_MIN       = 100;
+            static constexpr float PID_FREQ_MAX       = 1000;
+            static constexpr float SERIAL_FREQ_MIN    = 20;
+            static constexpr float SERIAL_FREQ_MAX    = 200;
+
+            // How long calibrateRates() waits for startup before giving up
+            static constexpr float STARTUP_TIMEOUT = 10;
+
+            // Weight of each new blackbox write time in the running estimate
+            static constexpr float BLACKBOX_WRITE_SMOOTHING = 0.1f;
+
             // Supports periodic ad-hoc debugging
             Debugger _debugger;
 
@@ -73,13 +93,64 @@ namespace hf {
             // Serial timer task for GCS
             SerialTask _serialTask;
 
+            // Velocity setpoints from a companion computer
+            Offboard _offboard;
+
+            // Optional flight recorder
+            Blackbox * _blackbox = NULL;
+
+            // Running estimate of how long the blackbox store takes to write a chunk
+            float _blackboxWriteTime = 0;
+
+            // Keeps the rate loop on time when the rest of the update overruns
+            LoadShedder _loadShedder;
+
+            // Board, IMU, etc. start in parallel during the first updates
+            Startup _startup;
+
+            // Optional persistent calibration, applied once startup completes
+            CalibrationStore * _calibrationStore = NULL;
+
+            bool startupComplete(void)
+            {
+                bool wasDone = _startup.done();
+
+                if (!_startup.update(_board->getTime())) {
+                    return false;
+                }
+
+                if (!wasDone) {
+                    loadCalibration();
+                }
+
+                return true;
+            }
+
+            void loadCalibration(void)
+            {
+                if (!_calibrationStore) {
+                    return;
+                }
+
+                if (!_calibrationStore->load()) {
+                    Debugger::printf("No valid calibration found; using defaults\n");
+                    return;
+                }
+
+                _board->applyCalibration(_calibrationStore->calibration);
+
+                if (_imu) {
+                    _imu->applyCalibration(_calibrationStore->calibration);
+                }
+            }
+
              // Mandatory sensors on the board
             Gyrometer _gyrometer;
             Quaternion _quaternion; // not really a sensor, but we treat it like one!
  
-            bool safeAngle(uint8_t axis)
+            bool safeAngle(state_t & state, uint8_t axis)
             {
-                return fabs(_state.rotation[axis]) < Filter::deg2rad(MAX_ARMING_ANGLE_DEGREES);
+                return fabs(state.getRotation(axis)) < Filter::deg2rad(MAX_ARMING_ANGLE_DEGREES);
             }
 
            void checkQuaternion(void)
@@ -95,7 +166,7 @@ namespace hf {
                 }
             }
 
-            void checkGyrometer(void)
+            bool checkGyrometer(void)
             {
                 // Some gyrometers may need to know the current time
                 float time = _board->getTime();
@@ -105,7 +176,11 @@ namespace hf {
 
                     // Update state with gyro rates
                     _gyrometer.modifyState(_state, time);
+
+                    return true;
                 }
+
+                return false;
             }
 
 
@@ -115,17 +190,45 @@ namespace hf {
             // Vehicle state
             state_t _state;
 
-            void checkOptionalSensors(void)
+            // On a dual-core board, _state belongs to the IMU core and the outer loops work on a copy
+            state_t _outerState;
+            Snapshot<state_t> _imuState;
+
+            void checkOptionalSensors(state_t & state, bool includeImu=true)
             {
                 for (uint8_t k=0; k<_sensor_count; ++k) {
                     Sensor * sensor = _sensors[k];
+                    if (!includeImu && (sensor == &_gyrometer || sensor == &_quaternion)) {
+                        continue;
+                    }
                     float time = _board->getTime();
-                    if (sensor->ready(time)) {
-                        sensor->modifyState(_state, time);
+                    if (sensor->isStaleTolerant() && _loadShedder.shouldSkipStaleTolerant()) {
+                        if (sensor->shouldPoll(time)) {
+                            _loadShedder.countSensorSkip();
+                        }
+                        continue;
+                    }
+                    if (sensor->poll(time)) {
+                        sensor->modifyState(state, time);
                     }
                 }
             }
 
+            // Brings the outer-loop state up to date with the latest attitude and rates from the IMU core
+            void mergeImuState(void)
+            {
+                state_t imuState;
+
+                if (_imuState.read(imuState)) {
+
+                    _outerState.setQuaternion(imuState.quaternion[0], imuState.quaternion[1], 
+                            imuState.quaternion[2], imuState.quaternion[3]);
+
+                    memcpy(_outerState.angularVel, imuState.angularVel, sizeof(_outerState.angularVel));
+                    _outerState.markChanged(STATE_ANGULAR_VEL);
+                }
+            }
+
             void add_sensor(Sensor * sensor)
             {
                 _sensors[_sensor_count++] = sensor;
@@ -145,14 +248,19 @@ namespace hf {
                 _receiver = receiver;
                 _actuator = actuator;
 
-                // Ad-hoc debugging support
+                // Ad-hoc debugging support; messages are written out in the slack left by the scheduled tasks
                 _debugger.init(board);
+                Debugger::defer(true);
+
+                // Board may need some updates to finish starting
+                _startup.add(board);
 
                 // Support adding new sensors and PID controllers
                 _sensor_count = 0;
 
-                // Initialize state
+                // Initialize state, with level attitude until the first quaternion arrives
                 memset(&_state, 0, sizeof(state_t));
+                _state.setQuaternion(1, 0, 0, 0);
 
                 // Initialize the receiver
                 _receiver->begin();
@@ -162,25 +270,36 @@ namespace hf {
 
                 // Initialize timer task for PID controllers
                 _pidTask.init(_board, _receiver, _actuator, &_state);
+
+                // Detect updates that come too late for the PID controllers
+                _loadShedder.init(1 / PidTask::FREQ);
+            }
+
+            static float constrainFreq(float freq, float lo, float hi)
+            {
+                return freq < lo ? lo : (freq > hi ? hi : freq);
             }
 
-            void checkReceiver(void)
+            void checkReceiver(state_t & state)
             {
                 // Sync failsafe to receiver
-                if (_receiver->lostSignal() && _state.armed) {
-                    _actuator->cut();
-                    _state.armed = false;
-                    _state.failsafe = true;
+                if (_receiver->lostSignal() && state.armed) {
+                    _pidTask.cut();
+                    state.armed = false;
+                    state.failsafe = true;
                     _board->showArmedStatus(false);
                     return;
                 }
 
+                // Only headless mode needs the heading, so avoid computing it otherwise
+                float yawAngle = _receiver->headless ? state.getRotation(AXIS_YAW) - _yawInitial : 0;
+
                 // Check whether receiver data is available
-                if (!_receiver->getDemands(_state.rotation[AXIS_YAW] - _yawInitial)) return;
+                if (!_receiver->getDemands(yawAngle)) return;
 
                 // Disarm
-                if (_state.armed && !_receiver->getAux1State()) {
-                    _state.armed = false;
+                if (state.armed && !_receiver->getAux1State()) {
+                    state.armed = false;
                 } 
 
                 // Avoid arming if aux2 switch down on startup
@@ -189,19 +308,19 @@ namespace hf {
                 }
 
                 // Arm (after lots of safety checks!)
-                if (_safeToArm && !_state.armed && _receiver->throttleIsDown() && _receiver->getAux1State() && 
-                        !_state.failsafe && safeAngle(AXIS_ROLL) && safeAngle(AXIS_PITCH)) {
-                    _state.armed = true;
-                    _yawInitial = _state.rotation[AXIS_YAW]; // grab yaw for headless mode
+                if (_safeToArm && !state.armed && _receiver->throttleIsDown() && _receiver->getAux1State() && 
+                        !state.failsafe && safeAngle(state, AXIS_ROLL) && safeAngle(state, AXIS_PITCH)) {
+                    state.armed = true;
+                    _yawInitial = state.getRotation(AXIS_YAW); // grab yaw for headless mode
                 }
 
                 // Cut motors on throttle-down
-                if (_state.armed && _receiver->throttleIsDown()) {
-                    _actuator->cut();
+                if (state.armed && _receiver->throttleIsDown()) {
+                    _pidTask.cut();
                 }
 
                 // Set LED based on arming status
-                _board->showArmedStatus(_state.armed);
+                _board->showArmedStatus(state.armed);
 
             } // checkReceiver
 
@@ -259,6 +378,38 @@ namespace hf {
                 }
             }
 
+            void updateSerial(void)
+            {
+                // Keep received bytes moving even when the serial task doesn't run
+                _board->serialReceive();
+
+                // Update serial comms task, unless we're shedding load
+                _serialTask.setRateDivisor(_loadShedder.telemetryDivisor());
+                if (!_loadShedder.shouldDeferSerial()) {
+
+                    _serialTask.update();
+                }
+            }
+
+            // Writes a chunk of the blackbox log.  On the rate loop's core, only if the chunk should be written before
+            // the PID controllers are next due; a store too slow for the time to spare drops frames instead.
+            void drainBlackbox(bool onRateCore)
+            {
+                if (!_blackbox) {
+                    return;
+                }
+
+                float time = _board->getTime();
+
+                if (onRateCore && _pidTask.timeUntilDue(time) < _blackboxWriteTime) {
+                    return;
+                }
+
+                if (_blackbox->drain()) {
+                    _blackboxWriteTime += BLACKBOX_WRITE_SMOOTHING * (_board->getTime() - time - _blackboxWriteTime);
+                }
+            }
+
             void updateFull(void)
             {
                 // Check mandatory sensors
@@ -266,10 +417,9 @@ namespace hf {
                 checkQuaternion();
 
                 // Check optional sensors
-                checkOptionalSensors();
+                checkOptionalSensors(_state);
 
-                // Update serial comms task
-                _serialTask.update();
+                updateSerial();
             }
 
         public:
@@ -284,7 +434,7 @@ namespace hf {
                 _mixer = mixer;
 
                 // Initialize serial timer task
-                _serialTask.init(board, &_state, mixer, receiver);
+                _serialTask.init(board, &_state, mixer, receiver, &_loadShedder);
 
                 // Support safety override by simulator
                 _state.armed = armed;
@@ -295,10 +445,14 @@ namespace hf {
 
                 // Start the IMU
                 imu->begin();
+                _startup.add(imu);
 
                 // Tell the mixer which motors to use, and initialize them
                 mixer->useMotors(motors);
 
+                // Motors can be spun from the GCS while disarmed
+                _pidTask._motorsDisarmed = mixer->motorsDisarmed;
+
                 // Set the update function
                 _updater = &_updaterFull;
                 _updater->init(this);
@@ -321,6 +475,50 @@ namespace hf {
                 _updater->init(this);
             }
 
+            // Supports components (such as ESCs) that need time to start; vehicle can't arm until they have
+            void addStartupComponent(StartupComponent * component)
+            {
+                _startup.add(component);
+            }
+
+            // Calibration in the store is loaded and applied at the end of startup
+            void useCalibrationStore(CalibrationStore * store)
+            {
+                _calibrationStore = store;
+            }
+
+            // Captures current calibration from board and IMU and saves it to the store
+            bool saveCalibration(void)
+            {
+                if (!_calibrationStore) {
+                    return false;
+                }
+
+                _board->captureCalibration(_calibrationStore->calibration);
+
+                if (_imu) {
+                    _imu->captureCalibration(_calibrationStore->calibration);
+                }
+
+                return _calibrationStore->save();
+            }
+
+            // Records every PID tick; call after init().  The blackbox's store opens during startup.
+            void useBlackbox(Blackbox * blackbox)
+            {
+                _blackbox = blackbox;
+
+                if (blackbox->_store) {
+                    _startup.add(blackbox->_store);
+                }
+
+                if (_mixer) {
+                    _blackbox->useMotors(_mixer->_motorsPrev, _mixer->_nmotors);
+                }
+
+                _pidTask._blackbox = blackbox;
+            }
+
             void addSensor(Sensor * sensor) 
             {
                 add_sensor(sensor);
@@ -331,16 +529,174 @@ namespace hf {
                 _pidTask.addPidController(pidController, auxState);
             }
 
+            // Lets a companion computer fly the vehicle with velocity setpoints (SET_VELOCITY_SETPOINTS) while the aux switch
+            // selects the controller.  Add it before the level controller.  Serial input is then parsed at the PID rate, so
+            // setpoints reach the motors within a PID period or so.
+            void addOffboardController(OffboardPid * pidController, uint8_t auxState)
+            {
+                pidController->_offboard = &_offboard;
+
+                _pidTask._offboard = &_offboard;
+                _serialTask._offboard = &_offboard;
+
+                _serialTask.setFrequency(_pidTask.getFrequency());
+
+                addPidController(pidController, auxState);
+            }
+
+            Offboard * getOffboard(void)
+            {
+                return &_offboard;
+            }
+
+            // Splits the work between two cores: call updateInnerLoop() from one and updateOuterLoops() from the other
+            // instead of update().  The rate PID controller runs with the IMU; everything else runs on the other core.
+            // Only the IMU core writes to the motors.
+            void useDualCore(void)
+            {
+                _outerState = _state;
+
+                _pidTask.useDualCore(&_outerState);
+                _serialTask._state = &_outerState;
+            }
+
+            // IMU sampling, attitude estimation and rate loop
+            void updateInnerLoop(void)
+            {
+                // Inner loop drives startup; outer loops wait for it
+                if (!startupComplete()) {
+                    return;
+                }
+
+                // Carry out any motor cut first, even without a new gyrometer reading
+                _pidTask.checkInnerLoopInput();
+
+                bool gotGyrometer = checkGyrometer();
+
+                checkQuaternion();
+
+                if (gotGyrometer) {
+
+                    _pidTask.updateInnerLoop(&_state);
+
+                    _imuState.write(_state);
+                }
+            }
+
+            // Receiver, outer PID loops, optional sensors, serial comms and debug output
+            void updateOuterLoops(void)
+            {
+                if (!_startup.done()) {
+                    _debugger.update();
+                    return;
+                }
+
+                // An overrun here delays the outer loops, not the rate loop, so we shed load the same way as update()
+                _loadShedder.update(_board->getTime());
+
+                mergeImuState();
+
+                checkReceiver(_outerState);
+
+                _pidTask.update();
+
+                checkOptionalSensors(_outerState, false);
+
+                updateSerial();
+
+                drainBlackbox(false);
+
+                _debugger.update();
+            }
+
+            // Call at the end of setup, after adding sensors and PID controllers: runs update() for the specified time,
+            // then sets PID and telemetry rates from the worst-case update period, and reports them.  The PID controllers
+            // scale their I and D terms by the actual time step, so the new PID rate doesn't change their tuning.  If
+            // startup doesn't finish in time, reports the components still pending and keeps the default rates.
+            void calibrateRates(float duration=1)
+            {
+                // Benchmark the loop as it will run after startup, showing startup messages while we wait
+                float waitStart = _board->getTime();
+
+                while (!startupComplete()) {
+
+                    _debugger.update();
+
+                    if (_board->getTime() - waitStart > STARTUP_TIMEOUT) {
+                        Debugger::printf("Startup timed out; not calibrating rates\n");
+                        _startup.reportPending();
+                        Debugger::flush();
+                        return;
+                    }
+                }
+
+                float start = _board->getTime();
+                float prev = start;
+                float worstPeriod = 0;
+                uint32_t count = 0;
+
+                while (true) {
+
+                    update();
+
+                    float time = _board->getTime();
+
+                    if (time - prev > worstPeriod) {
+                        worstPeriod = time - prev;
+                    }
+
+                    prev = time;
+                    count++;
+
+                    if (time - start >= duration) {
+                        break;
+                    }
+                }
+
+                float pidFreq = constrainFreq(1 / (worstPeriod * RATE_SAFETY_MARGIN), PID_FREQ_MIN, PID_FREQ_MAX);
+
+                // Keep telemetry in the same proportion to PID as the defaults
+                float serialFreq = constrainFreq(pidFreq * SerialTask::FREQ / PidTask::FREQ, SERIAL_FREQ_MIN, SERIAL_FREQ_MAX);
+
+                // Offboard setpoints shouldn't wait for the serial task
+                if (_pidTask._offboard) {
+                    serialFreq = pidFreq;
+                }
+
+                _pidTask.setFrequency(pidFreq);
+                _serialTask.setFrequency(serialFreq);
+                _loadShedder.init(1 / pidFreq);
+
+                Debugger::printf("%d updates, worst period %d usec: PID %d Hz, telemetry %d Hz\n", 
+                        (int)count, (int)(worstPeriod * 1e6f), (int)pidFreq, (int)serialFreq);
+            }
+
             void update(void)
             {
+                // Nothing else runs until all components have started, so startup messages can go out meanwhile
+                if (!startupComplete()) {
+                    _debugger.update();
+                    return;
+                }
+
+                // Check for overrun since previous update
+                _loadShedder.update(_board->getTime());
+
                 // Grab control signal if available
-                checkReceiver();
+                checkReceiver(_state);
 
                 // Update PID controllers task
-                _pidTask.update();
+                bool ranPid = _pidTask.update();
 
                 // Run full or lite update function
                 _updater->update();
+
+                // Write out the blackbox log and queued debug messages in the slack, leaving updates that ran the PID
+                // controllers on time
+                if (!ranPid) {
+                    drainBlackbox(true);
+                    _debugger.update();
+                }
             }
 
     }; // class Hackflight
@@ -20,9 +20,15 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include "dataready.hpp"
+#include "startupcomponent.hpp"
+#include "calibration.hpp"
+
 namespace hf {
 
-    class IMU {
+    class IMU : public StartupComponent {
 
         // NB: quaternion, gyrometer, accelerometer should return values as follows:
         //
@@ -43,19 +49,59 @@ namespace hf {
         friend class Quaternion;
         friend class Gyrometer;
 
+        private:
+
+            DataReady _dataReady;
+
         protected:
 
+            // True if new data may be available: always, unless a data-ready pin is in use.  The interrupt stays
+            // pending until dataHandled() is called, so call that only once a read has succeeded.
+            bool dataReady(void)
+            {
+                return _dataReady.pending();
+            }
+
+            void dataHandled(void)
+            {
+                _dataReady.handled();
+            }
+
             virtual bool getQuaternion(float & qw, float & qx, float & qy, float & qz, float time) = 0;
 
             virtual bool getGyrometer(float & gx, float & gy, float & gz) = 0;
 
             virtual void begin(void) { }
 
+            virtual const char * startupName(void) override
+            {
+                return "IMU";
+            }
+
+            // Use calibration loaded at boot, so biases don't have to be re-learned
+            virtual void applyCalibration(const calibration_t & calibration) { (void)calibration; }
+
+            // Copy current calibration (e.g., warm-start parameters) out for saving
+            virtual void captureCalibration(calibration_t & calibration) { (void)calibration; }
+
             //------------------------- Support for additional surface-mount sensors -------------------------------------
             virtual bool  getAccelerometer(float & ax, float & ay, float & az) { (void)ax; (void)ay; (void)az; return false; }
             virtual bool  getMagnetometer(float & mx, float & my, float & mz) { (void)mx; (void)my; (void)mz; return false; }
             virtual bool  getBarometer(float & pressure) { (void)pressure;  return false; }
 
+        public:
+
+            // Read the IMU only after handleDataReadyInterrupt() has been called from its interrupt routine
+            void useDataReadyPin(void)
+            {
+                _dataReady.use();
+            }
+
+            void handleDataReadyInterrupt(void)
+            {
+                _dataReady.interrupt();
+            }
+
     }; // class IMU
 
 } // namespace hf
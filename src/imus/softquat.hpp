@@ -52,6 +52,10 @@ namespace hf {
             float _gy = 0;
             float _gz = 0;
 
+            // From calibration store
+            float _gyroBias[3] = {0};
+            float _accelOffset[3] = {0};
+
         protected:
 
             // Quaternion support: even though MPU9250 has a magnetometer, we keep it simple for now by 
@@ -67,16 +71,38 @@ namespace hf {
             bool getGyrometer(float & gx, float & gy, float & gz) override
             {
                 // Read acceleromter Gs, gyrometer rad/sec
-                if (imuReady()) {
+                if (dataReady() && imuReady()) {
+
+                    dataHandled();
 
                     imuReadAccelGyro(_ax, _ay, _az, _gx, _gy, _gz);
 
+                    _ax -= _accelOffset[0];
+                    _ay -= _accelOffset[1];
+                    _az -= _accelOffset[2];
+
+                    _gx -= _gyroBias[0];
+                    _gy -= _gyroBias[1];
+                    _gz -= _gyroBias[2];
+
                     return true;
                 }
 
                 return false;
             }
 
+            virtual void applyCalibration(const calibration_t & calibration) override
+            {
+                memcpy(_gyroBias, calibration.gyroBias, sizeof(_gyroBias));
+                memcpy(_accelOffset, calibration.accelOffset, sizeof(_accelOffset));
+            }
+
+            virtual void captureCalibration(calibration_t & calibration) override
+            {
+                memcpy(calibration.gyroBias, _gyroBias, sizeof(_gyroBias));
+                memcpy(calibration.accelOffset, _accelOffset, sizeof(_accelOffset));
+            }
+
             bool getQuaternion(float & qw, float & qx, float & qy, float & qz, float time) override
             {
                 // Update quaternion after some number of IMU readings
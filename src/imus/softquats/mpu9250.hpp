@@ -21,6 +21,7 @@
 #pragma once
 
 #include "imus/softquat.hpp"
+#include "buses/wire.hpp"
 #include "MPU9250_Master_I2C.h"
 
 namespace hf {
@@ -45,44 +46,117 @@ namespace hf {
 
         private:
 
-            static void error(const char * errmsg) 
+            // MPU9250 registers used for polling: accel, temperature and gyro are contiguous
+            static const uint8_t ADDRESS          = 0x68;
+            static const uint8_t REG_INT_STATUS   = 0x3A;
+            static const uint8_t REG_ACCEL_XOUT_H = 0x3B;
+            static const uint8_t REG_GYRO_XOUT_H  = 0x43;
+            static const uint8_t BURST_SIZE       = REG_GYRO_XOUT_H + 6 - REG_ACCEL_XOUT_H;
+
+            static const uint8_t RAW_DATA_READY = 0x01;
+
+            // Initialization goes through the MPU9250 library; polling uses burst reads on this bus
+            WireBus _wireBus;
+            Bus * _bus = &_wireBus;
+
+            uint8_t _data[BURST_SIZE] = {0};
+
+            bool _startupFailed = false;
+
+            // Registers are big-endian
+            float int16At(uint8_t reg)
+            {
+                uint8_t * data = &_data[reg - REG_ACCEL_XOUT_H];
+                return (int16_t)((data[0] << 8) | data[1]);
+            }
+
+            static float accelResolution(void)
+            {
+                switch (ASCALE) {
+                    case MPUIMU::AFS_2G:
+                        return 2.f / 32768;
+                    case MPUIMU::AFS_4G:
+                        return 4.f / 32768;
+                    case MPUIMU::AFS_8G:
+                        return 8.f / 32768;
+                    default:
+                        return 16.f / 32768;
+                }
+            }
+
+            static float gyroResolution(void)
             {
-                Serial.println(errmsg);
-                while (true) ;
+                switch (GSCALE) {
+                    case MPUIMU::GFS_250DPS:
+                        return 250.f / 32768;
+                    case MPUIMU::GFS_500DPS:
+                        return 500.f / 32768;
+                    case MPUIMU::GFS_1000DPS:
+                        return 1000.f / 32768;
+                    default:
+                        return 2000.f / 32768;
+                }
             }
 
         protected:
 
-            virtual void begin(void) override
+            virtual bool startupStep(float time) override
             {
+                (void)time;
+
+                if (_startupFailed) {
+                    return false;
+                }
+
                 // Start the MPU9250
                 switch (_mpu9250_imu.begin()) {
 
                     case MPUIMU::ERROR_IMU_ID:
-                        error("Bad IMU device ID");
+                        startupFailed("Bad IMU device ID");
+                        _startupFailed = true;
+                        return false;
                     case MPUIMU::ERROR_MAG_ID:
-                        error("Bad magnetometer device ID");
+                        startupFailed("Bad magnetometer device ID");
+                        _startupFailed = true;
+                        return false;
                     case MPUIMU::ERROR_SELFTEST:
-                        //error("Failed self-test");
+                        //startupFailed("Failed self-test");
                         break;
                 }
+
+                return true;
             }
 
             virtual bool imuReady(void) override 
             {
-                return _mpu9250_imu.checkNewData();
+                // A one-byte status read on a miss; the sample burst only when there's new data
+                if (!(_bus->readByte(ADDRESS, REG_INT_STATUS) & RAW_DATA_READY)) {
+                    return false;
+                }
+
+                // One burst gets accelerometer, temperature and gyrometer
+                return _bus->read(ADDRESS, REG_ACCEL_XOUT_H, BURST_SIZE, _data);
             }
 
             virtual void imuReadAccelGyro(float & ax, float & ay, float & az, float & gx, float & gy, float &gz) override
             {
-                _mpu9250_imu.readAccelerometer(ax, ay, az);
-                _mpu9250_imu.readGyrometer(gx, gy, gz);
+                // Use the values acquired by imuReady()
+                ax = int16At(REG_ACCEL_XOUT_H)   * accelResolution();
+                ay = int16At(REG_ACCEL_XOUT_H+2) * accelResolution();
+                az = int16At(REG_ACCEL_XOUT_H+4) * accelResolution();
 
                 // Convert gyrometer values from degrees/sec to radians/sec
-                gx = Filter::deg2rad(gx);
-                gy = Filter::deg2rad(gy);
-                gz = Filter::deg2rad(gz);
+                gx = Filter::deg2rad(int16At(REG_GYRO_XOUT_H)   * gyroResolution());
+                gy = Filter::deg2rad(int16At(REG_GYRO_XOUT_H+2) * gyroResolution());
+                gz = Filter::deg2rad(int16At(REG_GYRO_XOUT_H+4) * gyroResolution());
+            }
 
+        public:
+
+            // Supports running the polling code against a MockBus
+            void useBus(Bus * bus)
+            {
+                _bus = bus;
             }
 
     }; // class MPU9250SoftwareQuaternionIMU
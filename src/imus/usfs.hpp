@@ -23,6 +23,7 @@
 #include <Wire.h>
 #include <USFS_Master.h>
 #include "imu.hpp"
+#include "buses/wire.hpp"
 
 namespace hf {
 
@@ -37,18 +38,116 @@ namespace hf {
             static const uint8_t  BARO_RATE      = 50;   // Hz
             static const uint8_t  Q_RATE_DIVISOR = 5;    // 1/5 gyro rate
 
+            // EM7180 SENtral registers used for polling
+            static const uint8_t ADDRESS          = 0x28;
+            static const uint8_t REG_QX           = 0x00; // QX, QY, QZ, QW as floats
+            static const uint8_t REG_GX           = 0x22; // GX, GY, GZ as int16
+            static const uint8_t REG_EVENT_STATUS = 0x35;
+
+            // Parameter transfer, for warm start
+            static const uint8_t REG_PARAM_ACKNOWLEDGE = 0x3A;
+            static const uint8_t REG_SAVED_PARAM_BYTE0 = 0x3B;
+            static const uint8_t REG_ALGORITHM_CONTROL = 0x54;
+            static const uint8_t REG_LOAD_PARAM_BYTE0  = 0x60;
+            static const uint8_t REG_PARAM_REQUEST     = 0x64;
+
+            static const uint8_t WARM_START_PARAM_COUNT = 35;
+            static const uint8_t PARAM_TRANSFER         = 0x80;
+            static const uint8_t PARAM_LOAD             = 0x80;
+            static const uint16_t PARAM_ACK_TRIES       = 1000;
+
+            static const uint8_t EVENT_ERROR      = 0x02;
+            static const uint8_t EVENT_QUATERNION = 0x04;
+            static const uint8_t EVENT_GYROMETER  = 0x20;
+
+            // Degrees per second per LSB at 2000 deg/sec full scale
+            static constexpr float GYRO_SCALE = 0.153f;
+
+            // Time for SENtral to power up before we start it
+            static constexpr float POWER_UP_SECONDS = 0.1f;
+
+            float _startupTime = -1;
+            bool _startupFailed = false;
+
             USFS_Master _sentral = USFS_Master(MAG_RATE, ACCEL_RATE, GYRO_RATE, BARO_RATE, Q_RATE_DIVISOR);
 
-            void checkEventStatus(void)
+            // Configuration goes through the USFS library; polling uses burst reads on this bus
+            WireBus _wireBus;
+            Bus * _bus = &_wireBus;
+
+            // Quaternion through gyrometer registers, filled by one burst per event
+            uint8_t _data[REG_GX + 6] = {0};
+
+            bool _gotQuaternion = false;
+
+            static float floatAt(uint8_t * data)
+            {
+                float value = 0;
+                memcpy(&value, data, 4);
+                return value;
+            }
+
+            static float int16At(uint8_t * data)
             {
-                _sentral.checkEventStatus();
+                return (int16_t)(data[0] | (data[1] << 8));
+            }
+
+            bool waitForParamAcknowledge(uint8_t param)
+            {
+                for (uint16_t k=0; k<PARAM_ACK_TRIES; ++k) {
+                    if (_bus->readByte(ADDRESS, REG_PARAM_ACKNOWLEDGE) == param) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // Moves warm-start parameters between SENtral and the calibration blob, one four-byte parameter at a time
+            bool transferWarmStart(uint8_t * blob, bool load)
+            {
+                bool ok = true;
+
+                for (uint8_t k=0; k<WARM_START_PARAM_COUNT && ok; ++k) {
+
+                    uint8_t param = (k + 1) | (load ? PARAM_LOAD : 0);
+
+                    if (load) {
+                        for (uint8_t j=0; j<4; ++j) {
+                            _bus->write(ADDRESS, REG_LOAD_PARAM_BYTE0+j, blob[4*k+j]);
+                        }
+                    }
+
+                    _bus->write(ADDRESS, REG_PARAM_REQUEST, param);
+
+                    if (k == 0) {
+                        _bus->write(ADDRESS, REG_ALGORITHM_CONTROL, PARAM_TRANSFER);
+                    }
+
+                    ok = waitForParamAcknowledge(param);
+
+                    if (ok && !load) {
+                        _bus->read(ADDRESS, REG_SAVED_PARAM_BYTE0, 4, &blob[4*k]);
+                    }
+                }
 
-                if (_sentral.gotError()) {
+                // End parameter transfer, resume algorithm
+                _bus->write(ADDRESS, REG_PARAM_REQUEST, 0x00);
+                _bus->write(ADDRESS, REG_ALGORITHM_CONTROL, 0x00);
+
+                return ok;
+            }
+
+            uint8_t checkEventStatus(void)
+            {
+                uint8_t eventStatus = _bus->readByte(ADDRESS, REG_EVENT_STATUS);
+
+                if (eventStatus & EVENT_ERROR) {
                     while (true) {
-                        Serial.print("ERROR: ");
-                        Serial.println(_sentral.getErrorString());
+                        Serial.println("ERROR: USFS reported an error event");
                     }
                 }
+
+                return eventStatus;
             }
 
         protected:
@@ -61,18 +160,40 @@ namespace hf {
 
             virtual bool getGyrometer(float & gx, float & gy, float & gz) override
             {
+                // With a data-ready pin, skip the bus until the SENtral interrupts
+                if (!dataReady()) {
+                    return false;
+                }
+
                 // Since gyro is updated most frequently, use it to drive SENtral polling
-                checkEventStatus();
+                uint8_t eventStatus = checkEventStatus();
 
-                if (_sentral.gotGyrometer()) {
+                // An interrupt for some other event needs no further reads
+                if (!(eventStatus & (EVENT_GYROMETER | EVENT_QUATERNION))) {
+                    dataHandled();
+                    return false;
+                }
+
+                // One burst gets the gyrometer, plus the quaternion when it's ready too
+                uint8_t first = (eventStatus & EVENT_QUATERNION) ? REG_QX : REG_GX;
+
+                // On a bus error, _data holds the previous sample, which mustn't be passed off as a new one; the interrupt
+                // stays pending, so the read is retried on the next update
+                if (!_bus->read(ADDRESS, first, sizeof(_data) - first, &_data[first])) {
+                    _gotQuaternion = false;
+                    return false;
+                }
 
-                    // Returns degrees / sec
-                    _sentral.readGyrometer(gx, gy, gz);
+                dataHandled();
 
-                    // Convert degrees / sec to radians / sec
-                    gx = radians(gx);
-                    gy = radians(gy);
-                    gz = radians(gz);
+                _gotQuaternion = eventStatus & EVENT_QUATERNION;
+
+                if (eventStatus & EVENT_GYROMETER) {
+
+                    // Convert raw values to degrees / sec, then to radians / sec
+                    gx = radians(int16At(&_data[REG_GX])   * GYRO_SCALE);
+                    gy = radians(int16At(&_data[REG_GX+2]) * GYRO_SCALE);
+                    gz = radians(int16At(&_data[REG_GX+4]) * GYRO_SCALE);
 
                     adjustGyrometer(gx, gy, gz);
 
@@ -86,28 +207,61 @@ namespace hf {
             {
                 (void)time;
 
-                if (_sentral.gotQuaternion()) {
+                if (_gotQuaternion) {
 
-                    _sentral.readQuaternion(qw, qx, qy, qz);
+                    qx = floatAt(&_data[REG_QX]);
+                    qy = floatAt(&_data[REG_QX+4]);
+                    qz = floatAt(&_data[REG_QX+8]);
+                    qw = floatAt(&_data[REG_QX+12]);
 
                     adjustQuaternion(qw, qx, qy, qz);
 
+                    _gotQuaternion = false;
+
                     return true;
                 }
 
                 return false;
             }
 
-            virtual void begin(void) override
+            virtual bool startupStep(float time) override
             {
+                if (_startupTime < 0) {
+                    _startupTime = time;
+                }
+
+                if (_startupFailed || time - _startupTime < POWER_UP_SECONDS) {
+                    return false;
+                }
+
                 // Start the USFS in master mode, no interrupt
                 if (!_sentral.begin()) {
-                    while (true) {
-                        Serial.println(_sentral.getErrorString());
-                    }
+                    startupFailed(_sentral.getErrorString());
+                    _startupFailed = true;
+                    return false;
+                }
+
+                return true;
+            }
+
+            virtual void applyCalibration(const calibration_t & calibration) override
+            {
+                if (calibration.haveWarmStart) {
+                    transferWarmStart((uint8_t *)calibration.warmStart, true);
                 }
             }
 
+            virtual void captureCalibration(calibration_t & calibration) override
+            {
+                calibration.haveWarmStart = transferWarmStart(calibration.warmStart, false);
+            }
+
+            // Supports running the polling code against a MockBus
+            void useBus(Bus * bus)
+            {
+                _bus = bus;
+            }
+
     }; // class USFS
 
 } // namespace hf
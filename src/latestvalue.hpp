@@ -0,0 +1,94 @@
+/*
+   Seqlock-style latest-value slot
+
+   A single writer (interrupt routine or another core) publishes values without
+   ever waiting; the reader retries until it gets a copy that was not torn by a
+   concurrent write.  Older values are simply overwritten.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    template <typename T>
+    class LatestValue {
+
+        private:
+
+            // Odd while a write is in progress
+            uint32_t _sequence = 0;
+
+            T _value = {};
+
+            // Reader only: sequence of the last value read
+            uint32_t _readSequence = 0;
+
+            // Copy byte-by-byte with relaxed atomics so concurrent access is well defined
+            static void copy(uint8_t * dst, const uint8_t * src)
+            {
+                for (uint16_t k=0; k<sizeof(T); ++k) {
+                    __atomic_store_n(&dst[k], __atomic_load_n(&src[k], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+                }
+            }
+
+        public:
+
+            // Writer side; never blocks
+            void write(const T & value)
+            {
+                uint32_t sequence = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+
+                __atomic_store_n(&_sequence, sequence + 1, __ATOMIC_RELAXED);
+                __atomic_thread_fence(__ATOMIC_RELEASE);
+
+                copy((uint8_t *)&_value, (const uint8_t *)&value);
+
+                __atomic_store_n(&_sequence, sequence + 2, __ATOMIC_RELEASE);
+            }
+
+            // Reader side: copies the latest value and returns true if it is newer than the last one read
+            bool read(T & value)
+            {
+                uint32_t before = 0, after = 0;
+
+                do {
+                    before = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE);
+                    copy((uint8_t *)&value, (const uint8_t *)&_value);
+                    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                    after = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+                } while ((before & 1) || before != after);
+
+                bool isNew = before != _readSequence;
+
+                _readSequence = before;
+
+                return isNew;
+            }
+
+            // Reader side: true if a value has been written since the last read()
+            bool changed(void)
+            {
+                return __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE) != _readSequence;
+            }
+
+    }; // class LatestValue
+
+} // namespace hf
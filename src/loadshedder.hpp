@@ -0,0 +1,135 @@
+/*
+   Overrun detection and load shedding for the main loop
+
+   When the time between updates exceeds the PID deadline, the shedding level
+   rises one step per overrun and falls one step after a run of on-time
+   updates.  Each level sheds more of the work that can tolerate it, so that
+   the gyrometer, rate loop and mixer keep their deadline.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    class LoadShedder {
+
+        friend class Hackflight;
+        friend class SerialTask;
+
+        private:
+
+            // Levels, in increasing order of what gets shed
+            static const uint8_t LEVEL_NONE               = 0;
+            static const uint8_t LEVEL_DEFER_SERIAL       = 1; // skip serial task right after an overrun
+            static const uint8_t LEVEL_SKIP_STALE_SENSORS = 2; // also skip stale-tolerant optional sensors
+            static const uint8_t LEVEL_REDUCE_TELEMETRY   = 3; // also run serial task at reduced rate
+            static const uint8_t LEVEL_MAX                = LEVEL_REDUCE_TELEMETRY;
+
+            // On-time updates needed before dropping one level
+            static const uint16_t RECOVERY_UPDATES = 500;
+
+            static const uint8_t TELEMETRY_DIVISOR = 4;
+
+            float _deadline = 0;
+            float _lastTime = 0;
+
+            bool _overran = false;
+            uint8_t _level = LEVEL_NONE;
+            uint16_t _onTimeCount = 0;
+
+            // Shed events, reported over MSP
+            uint32_t _overrunCount = 0;
+            uint32_t _serialDeferCount = 0;
+            uint32_t _sensorSkipCount = 0;
+            uint32_t _telemetryReduceCount = 0;
+
+        protected:
+
+            void init(float deadline)
+            {
+                _deadline = deadline;
+            }
+
+            // Call at the start of each update
+            void update(float time)
+            {
+                _overran = _lastTime > 0 && (time - _lastTime) > _deadline;
+                _lastTime = time;
+
+                if (_overran) {
+
+                    _overrunCount++;
+                    _onTimeCount = 0;
+
+                    if (_level < LEVEL_MAX) {
+                        _level++;
+                        if (_level == LEVEL_REDUCE_TELEMETRY) {
+                            _telemetryReduceCount++;
+                        }
+                    }
+                }
+
+                else if (_level > LEVEL_NONE && ++_onTimeCount >= RECOVERY_UPDATES) {
+                    _level--;
+                    _onTimeCount = 0;
+                }
+            }
+
+            bool shouldDeferSerial(void)
+            {
+                if (_level >= LEVEL_DEFER_SERIAL && _overran) {
+                    _serialDeferCount++;
+                    return true;
+                }
+                return false;
+            }
+
+            bool shouldSkipStaleTolerant(void)
+            {
+                return _level >= LEVEL_SKIP_STALE_SENSORS;
+            }
+
+            // Call only when a skipped sensor was due to be polled, so the count reflects work actually shed
+            void countSensorSkip(void)
+            {
+                _sensorSkipCount++;
+            }
+
+            uint8_t telemetryDivisor(void)
+            {
+                return _level >= LEVEL_REDUCE_TELEMETRY ? TELEMETRY_DIVISOR : 1;
+            }
+
+        public:
+
+            uint8_t getLevel(void)
+            {
+                return _level;
+            }
+
+            uint32_t getOverrunCount(void)
+            {
+                return _overrunCount;
+            }
+
+    }; // class LoadShedder
+
+} // namespace hf
@@ -33,9 +33,11 @@
 
 #include "esp32-hal.h"
 
+#include "startupcomponent.hpp"
+
 namespace hf {
 
-    class Esp32DShot600 {
+    class Esp32DShot600 : public StartupComponent {
 
         private:
 
@@ -45,6 +47,11 @@ namespace hf {
             static constexpr uint16_t MIN = 48;
             static constexpr uint16_t MAX = 2047;
 
+            // ESCs need to see disarm frames for this long before they will run
+            static const uint32_t ARMING_MSEC = 3500;
+
+            uint32_t _beginMsec = 0;
+
             typedef struct {
 
                 rmt_data_t dshotPacket[16];
@@ -113,6 +120,20 @@ namespace hf {
 
             } // outputOne
 
+        protected:
+
+            virtual bool startupStep(float time) override
+            {
+                (void)time;
+
+                return ready();
+            }
+
+            virtual const char * startupName(void) override
+            {
+                return "ESCs";
+            }
+
         public:
 
             Esp32DShot600(void)
@@ -139,18 +160,23 @@ namespace hf {
 
                     // Output disarm signal while esc initialises
                     motor->outputValue = MIN;
-                    while (millis() < 3500) {
-                        outputOne(motor);
-                        delay(1);  
-                    }
                 }
 
+                // Core task sends the disarm frames to all motors at once, without blocking
+                _beginMsec = millis();
+
                 TaskHandle_t Task;
                 xTaskCreatePinnedToCore(coreTask, "Task", 10000, this, 1, &Task, 0); 
 
                 return true;
             }
 
+            // True once the ESCs have seen disarm frames long enough to arm
+            bool ready(void)
+            {
+                return millis() - _beginMsec >= ARMING_MSEC;
+            }
+
             void writeMotor(uint8_t index, float value)
             {
                 _motors[index].outputValue = MIN + (uint16_t)(value * (MAX-MIN));
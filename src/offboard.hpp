@@ -0,0 +1,160 @@
+/*
+   Velocity setpoints streamed from a companion computer
+
+   The serial task posts each setpoint with the time it arrived; the PID task
+   picks up the latest one on each tick, judges it by age, and records how long
+   it took to reach the motors.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "latestvalue.hpp"
+
+namespace hf {
+
+    class Offboard {
+
+        friend class Hackflight;
+        friend class SerialTask;
+        friend class PidTask;
+        friend class OffboardPid;
+
+        private:
+
+            // Older setpoints are replaced by zero velocity, so the vehicle brakes and holds
+            static constexpr float STALE_AGE = 0.1f;
+
+            // With no setpoint for this long, the PID task cuts the motors as for a lost receiver signal
+            static constexpr float TIMEOUT = 0.5f;
+
+            typedef struct {
+
+                float vx;
+                float vy;
+                float vz;
+                float yawRate;
+
+                // Board time when the setpoint was parsed
+                float time;
+
+            } setpoint_t;
+
+            // Written by serial task, read by PID task
+            LatestValue<setpoint_t> _mailbox;
+
+            // PID task only ------------------------------------------------------
+
+            setpoint_t _setpoint = {};
+
+            bool  _haveSetpoint = false;
+            float _age = 0;
+
+            // Set by the offboard controller on each tick that it flies the vehicle
+            bool _engaged = false;
+
+            // Latest setpoint hasn't yet reached the motors
+            bool _awaitingMotors = false;
+
+            uint32_t _setpointCount = 0;
+            uint32_t _timeoutCount = 0;
+
+            float    _latencySum = 0;
+            float    _latencyMax = 0;
+            uint32_t _latencyCount = 0;
+
+            // Serial task
+            void set(float vx, float vy, float vz, float yawRate, float time)
+            {
+                setpoint_t setpoint = {vx, vy, vz, yawRate, time};
+
+                _mailbox.write(setpoint);
+            }
+
+            // PID task, once per tick before the controllers run
+            void update(float time)
+            {
+                if (_mailbox.read(_setpoint)) {
+                    _haveSetpoint = true;
+                    _awaitingMotors = true;
+                    _setpointCount++;
+                }
+
+                _age = time - _setpoint.time;
+
+                _engaged = false;
+            }
+
+            bool isFresh(void)
+            {
+                return _haveSetpoint && _age < STALE_AGE;
+            }
+
+            // Only once setpoints have started, so arming before the companion computer is up is allowed
+            bool timedOut(void)
+            {
+                return _engaged && _haveSetpoint && _age > TIMEOUT;
+            }
+
+            // PID task, after running the motors
+            void actuated(float time)
+            {
+                if (!_engaged || !_awaitingMotors) {
+                    return;
+                }
+
+                float latency = time - _setpoint.time;
+
+                _latencySum += latency;
+                _latencyCount++;
+
+                if (latency > _latencyMax) {
+                    _latencyMax = latency;
+                }
+
+                _awaitingMotors = false;
+            }
+
+        public:
+
+            uint32_t getSetpointCount(void)
+            {
+                return _setpointCount;
+            }
+
+            uint32_t getTimeoutCount(void)
+            {
+                return _timeoutCount;
+            }
+
+            // Setpoint-to-motor latency, from parsing to the first motor update that used the setpoint
+            uint32_t getLatencyMeanUsec(void)
+            {
+                return _latencyCount ? (uint32_t)(1e6f * _latencySum / _latencyCount) : 0;
+            }
+
+            uint32_t getLatencyMaxUsec(void)
+            {
+                return (uint32_t)(1e6f * _latencyMax);
+            }
+
+    }; // class Offboard
+
+} // namespace hf
@@ -20,32 +20,22 @@
 
 #pragma once
 
+#include <string.h>
+
 #include "datatypes.hpp"
 #include "filters.hpp"
 
 namespace hf {
 
-    class PidController {
-
-        friend class PidTask;
-
-        protected:
-
-            static constexpr float STICK_DEADBAND = 0.10;
-
-            virtual void modifyDemands(state_t * state, demands_t & demands) = 0;
-
-            virtual bool shouldFlashLed(void) { return false; }
-
-            virtual void updateReceiver(bool throttleIsDown) { (void)throttleIsDown; }
-
-            uint8_t auxState = 0;
+    // PID controller for a single degree of freedom.  Tuning constants Ki and Kd "absorb" the time step of an update
+    // at TUNED_FREQ; compute() scales the I and D terms by the actual time step, so the same constants work when the PID
+    // task runs at another rate, or when a controller skips ticks whose inputs haven't changed.
+    class Pid {
 
-    };  // class PidController
+        public:
 
-    // PID controller for a single degree of freedom.  Because time differences (dt) appear more-or-less constant,
-    // we avoid incoroporating them into the code; i.e., they are "absorbed" into tuning constants Ki and Kd.
-    class Pid {
+            // Rate of the PID task when the existing tuning constants were chosen
+            static constexpr float TUNED_FREQ = 300;
 
         private: 
 
@@ -60,9 +50,6 @@ namespace hf {
             float _deltaError1 = 0;
             float _deltaError2 = 0;
 
-            // For deltaT-based controllers
-            float _previousTime = 0;
-     
             // Prevents integral windup
             float _windupMax = 0;
 
@@ -80,25 +67,28 @@ namespace hf {
                 reset();
             }
 
-            float compute(float target, float actual)
+            float compute(float target, float actual, float dt)
             {
                 // Compute error as scaled target minus actual
                 float error = target - actual;
 
+                // Number of updates at the tuned rate that this one stands for
+                float ticks = dt > 0 ? dt * TUNED_FREQ : 1;
+
                 // Compute P term
                 float pterm = error * _Kp;
 
                 // Compute I term
                 float iterm = 0;
                 if (_Ki > 0) { // optimization
-                    _errorI = Filter::constrainAbs(_errorI + error, _windupMax); // avoid integral windup
+                    _errorI = Filter::constrainAbs(_errorI + error * ticks, _windupMax); // avoid integral windup
                     iterm =  _errorI * _Ki;
                 }
 
                 // Compute D term
                 float dterm = 0;
                 if (_Kd > 0) { // optimization
-                    float deltaError = error - _lastError;
+                    float deltaError = (error - _lastError) / ticks;
                     dterm = (_deltaError1 + _deltaError2 + deltaError) * _Kd; 
                     _deltaError2 = _deltaError1;
                     _deltaError1 = deltaError;
@@ -120,7 +110,6 @@ namespace hf {
             {
                 _errorI = 0;
                 _lastError = 0;
-                _previousTime = 0;
             }
 
     };  // class Pid
@@ -145,7 +134,7 @@ namespace hf {
                 _didReset = false;
             }
 
-            float compute(float demand, float inBandTargetVelocity, float outOfBandTargetScale, float actualVelocity)
+            float compute(float demand, float inBandTargetVelocity, float outOfBandTargetScale, float actualVelocity, float dt)
             {
                 _didReset = false;
 
@@ -163,7 +152,7 @@ namespace hf {
                 float targetVelocity = inBand ? inBandTargetVelocity : outOfBandTargetScale * demand;
 
                 // Run velocity PID controller to get correction
-                return Pid::compute(targetVelocity, actualVelocity);
+                return Pid::compute(targetVelocity, actualVelocity, dt);
             }
 
             bool didReset(void)
@@ -173,4 +162,98 @@ namespace hf {
 
     }; // class VelocityPid
 
+    class PidController {
+
+        friend class PidTask;
+
+        private:
+
+            // Inputs and output of the most recent computation, so we can skip recomputing when inputs are unchanged
+            bool      _haveCache = false;
+            demands_t _demandsIn = {};
+            demands_t _demandsOut = {};
+            uint32_t  _changes[STATE_FIELD_COUNT] = {};
+
+            // Time of the most recent computation, so the next one knows how much time it covers
+            float _computeTime = 0;
+
+            // Supports reporting how much work was avoided
+            uint32_t _computeCount = 0;
+            uint32_t _skipCount = 0;
+
+            bool inputsChanged(state_t * state, demands_t & demands, uint8_t dependencies)
+            {
+                if (memcmp(&demands, &_demandsIn, sizeof(demands_t))) {
+                    return true;
+                }
+
+                for (uint8_t k=0; k<STATE_FIELD_COUNT; ++k) {
+                    if ((dependencies & (1<<k)) && state->changes[k] != _changes[k]) {
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            void compute(state_t * state, demands_t & demands, float time)
+            {
+                uint8_t dependencies = stateDependencies();
+
+                // Re-use cached output if nothing we depend on has changed
+                if (_haveCache && dependencies && !inputsChanged(state, demands, dependencies)) {
+                    demands = _demandsOut;
+                    _skipCount++;
+                    return;
+                }
+
+                // Skipped ticks are made up for by the longer time step; after a reset, or a spell inactive, we
+                // start again from a nominal one
+                float dt = _haveCache ? time - _computeTime : 1 / Pid::TUNED_FREQ;
+                _computeTime = time;
+
+                _demandsIn = demands;
+                memcpy(_changes, state->changes, sizeof(_changes));
+
+                modifyDemands(state, demands, dt); 
+
+                _demandsOut = demands;
+                _haveCache = true;
+                _computeCount++;
+            }
+
+        protected:
+
+            static constexpr float STICK_DEADBAND = 0.10;
+
+            // dt is the time in seconds since this controller last computed its demands
+            virtual void modifyDemands(state_t * state, demands_t & demands, float dt) = 0;
+
+            // Bitmask of (1<<STATE_...) fields read by modifyDemands(); each must have a sensor that marks it changed.
+            // Controllers that don't declare their dependencies are recomputed on every tick.
+            virtual uint8_t stateDependencies(void) { return 0; }
+
+            virtual bool shouldFlashLed(void) { return false; }
+
+            // True for the controller that runs with the gyrometer, on the IMU core, when Hackflight uses two cores
+            virtual bool isInnerLoop(void) { return false; }
+
+            virtual void updateReceiver(bool throttleIsDown) { (void)throttleIsDown; }
+
+            uint8_t auxState = 0;
+
+        public:
+
+            uint32_t getComputeCount(void)
+            {
+                return _computeCount;
+            }
+
+            uint32_t getSkipCount(void)
+            {
+                return _skipCount;
+            }
+
+    };  // class PidController
+
 } // namespace hf
@@ -44,13 +44,14 @@ namespace hf {
 
         protected:
 
-            void modifyDemands(state_t * state, demands_t & demands)
+            void modifyDemands(state_t * state, demands_t & demands, float dt)
             {
                 float altitude = state->location[2];
 
                 // Run the velocity-based PID controller, using position-based PID controller output inside deadband, throttle-stick
                 // proportion outside.  
-                demands.throttle = _velPid.compute(demands.throttle, _posPid.compute(_altitudeTarget, altitude), PILOT_VELZ_MAX, state->inertialVel[2]);
+                demands.throttle = _velPid.compute(demands.throttle, _posPid.compute(_altitudeTarget, altitude, dt), PILOT_VELZ_MAX, 
+                        state->inertialVel[2], dt);
 
                 // If we re-entered deadband, we reset the target altitude.
                 if (_velPid.didReset()) {
@@ -58,6 +59,12 @@ namespace hf {
                 }
             }
 
+            // Written by the rangefinder, so we compute at its rate; the time step makes up for the skipped ticks
+            virtual uint8_t stateDependencies(void) override
+            {
+                return (1 << STATE_LOCATION) | (1 << STATE_INERTIAL_VEL);
+            }
+
             virtual bool shouldFlashLed(void) override 
             {
                 return true;
@@ -44,9 +44,9 @@ namespace hf {
                         VelocityPid::init(Kp, Ki, 0);
                     }
 
-                    void update(float & demand, float velocity)
+                    void update(float & demand, float velocity, float dt)
                     {
-                        demand = VelocityPid::compute(demand, 0, 2*PILOT_VELXY_MAX, velocity);
+                        demand = VelocityPid::compute(demand, 0, 2*PILOT_VELXY_MAX, velocity, dt);
                     }
 
             }; // _FlowVelocityPid
@@ -56,10 +56,16 @@ namespace hf {
 
         protected:
 
-            void modifyDemands(state_t * state, demands_t & demands)
+            void modifyDemands(state_t * state, demands_t & demands, float dt)
             {
-                _rollPid.update(demands.roll,  state->bodyVel[1]);
-                _rollPid.update(demands.pitch, state->bodyVel[0]);
+                _rollPid.update(demands.roll,  state->bodyVel[1], dt);
+                _pitchPid.update(demands.pitch, state->bodyVel[0], dt);
+            }
+
+            // Written by the optical-flow EKF
+            virtual uint8_t stateDependencies(void) override
+            {
+                return 1 << STATE_BODY_VEL;
             }
 
             virtual bool shouldFlashLed(void) override 
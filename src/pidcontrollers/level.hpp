@@ -47,9 +47,9 @@ namespace hf {
                         Pid::init(Kp, 0, 0);
                     }
 
-                    float compute(float demand, float angle)
+                    float compute(float demand, float angle, float dt)
                     {
-                        return Pid::compute(demand*_demandMultiplier, angle);
+                        return Pid::compute(demand*_demandMultiplier, angle, dt);
                     }
 
             }; // class _AnglePid
@@ -70,10 +70,15 @@ namespace hf {
             {
             }
 
-            void modifyDemands(state_t * state, demands_t & demands)
+            void modifyDemands(state_t * state, demands_t & demands, float dt)
             {
-                demands.roll  = _rollPid.compute(demands.roll, state->rotation[0]); 
-                demands.pitch = _pitchPid.compute(demands.pitch, state->rotation[1]);
+                demands.roll  = _rollPid.compute(demands.roll, state->getRotation(AXIS_ROLL), dt); 
+                demands.pitch = _pitchPid.compute(demands.pitch, state->getRotation(AXIS_PITCH), dt);
+            }
+
+            virtual uint8_t stateDependencies(void) override
+            {
+                return 1 << STATE_ROTATION;
             }
 
     };  // class LevelPid
@@ -0,0 +1,137 @@
+/*
+   Velocity control from offboard setpoints
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "datatypes.hpp"
+#include "pidcontroller.hpp"
+#include "offboard.hpp"
+
+namespace hf {
+
+    // Replaces the stick demands with ones that track setpoints from a companion computer: roll and pitch angles
+    // from body velocity, and yaw rate passed through.  Add with Hackflight::addOffboardController(), ahead of the
+    // level controller.
+    //
+    // Flying on velocity needs a sensor that estimates it, such as the optical-flow EKF.  Until body velocity is
+    // arriving, or once it stops, the controller stands aside: the pilot's demands pass through and the setpoint
+    // timeout can't cut the motors.
+    //
+    // The pilot keeps the throttle unless the controller is constructed with controlThrottle set, in which case
+    // climb rate is flown from the setpoint's vz; that also needs an estimate of vertical velocity, such as from a
+    // rangefinder.
+    class OffboardPid : public PidController {
+
+        friend class Hackflight;
+
+        private: 
+
+            // Velocity estimates older than this can't be flown on
+            static constexpr float VELOCITY_TIMEOUT = 0.1;
+
+            // Set by Hackflight::addOffboardController()
+            Offboard * _offboard = NULL;
+
+            Pid _rollPid;
+            Pid _pitchPid;
+            Pid _throttlePid;
+
+            bool _controlThrottle = false;
+
+            // Age of the body- and inertial-velocity estimates, which PID task ticks track by their change counts
+            uint32_t _velocityChanges[2] = {};
+            float    _velocityAge[2] = {VELOCITY_TIMEOUT, VELOCITY_TIMEOUT};
+
+            bool velocityFresh(state_t * state, uint8_t k, uint8_t field, float dt)
+            {
+                if (state->changes[field] != _velocityChanges[k]) {
+                    _velocityChanges[k] = state->changes[field];
+                    _velocityAge[k] = 0;
+                }
+                else {
+                    _velocityAge[k] += dt;
+                }
+
+                return _velocityAge[k] < VELOCITY_TIMEOUT;
+            }
+
+        protected:
+
+            void modifyDemands(state_t * state, demands_t & demands, float dt)
+            {
+                if (!_offboard) {
+                    return;
+                }
+
+                bool bodyVelFresh = velocityFresh(state, 0, STATE_BODY_VEL, dt);
+                bool inertialVelFresh = velocityFresh(state, 1, STATE_INERTIAL_VEL, dt);
+
+                // Without the estimates we'd fly on, leave the pilot in control, and start afresh when they return
+                if (!bodyVelFresh || (_controlThrottle && !inertialVelFresh)) {
+                    _rollPid.reset();
+                    _pitchPid.reset();
+                    _throttlePid.reset();
+                    return;
+                }
+
+                _offboard->_engaged = true;
+
+                Offboard::setpoint_t setpoint = {};
+
+                if (_offboard->isFresh()) {
+                    setpoint = _offboard->_setpoint;
+                }
+
+                demands.roll  = _rollPid.compute(setpoint.vy, state->bodyVel[1], dt);
+                demands.pitch = _pitchPid.compute(setpoint.vx, state->bodyVel[0], dt);
+                demands.yaw   = setpoint.yawRate;
+
+                if (_controlThrottle) {
+                    demands.throttle = _throttlePid.compute(setpoint.vz, state->inertialVel[2], dt);
+                }
+            }
+
+            // The setpoint isn't part of the state, so we run on every tick
+
+            virtual bool shouldFlashLed(void) override 
+            {
+                return true;
+            }
+
+            virtual void updateReceiver(bool throttleIsDown) override
+            {
+                _rollPid.updateReceiver(throttleIsDown);
+                _pitchPid.updateReceiver(throttleIsDown);
+                _throttlePid.updateReceiver(throttleIsDown);
+            }
+
+        public:
+
+            OffboardPid(const float Kp_xy, const float Ki_xy, const float Kp_z, const float Ki_z, bool controlThrottle=false)
+                : _controlThrottle(controlThrottle)
+            {
+                _rollPid.init(Kp_xy, Ki_xy, 0);
+                _pitchPid.init(Kp_xy, Ki_xy, 0);
+                _throttlePid.init(Kp_z, Ki_z, 0);
+            }
+
+    };  // class OffboardPid
+
+} // namespace hf
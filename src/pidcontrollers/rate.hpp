@@ -49,14 +49,14 @@ namespace hf {
                 _bigAngularVelocity = Filter::deg2rad(BIG_DEGREES_PER_SECOND);
             }
 
-            float compute(float demand, float angularVelocity)
+            float compute(float demand, float angularVelocity, float dt)
             {
                 // Reset integral on quick angular velocity change
                 if (fabs(angularVelocity) > _bigAngularVelocity) {
                     reset();
                 }
 
-                return Pid::compute(demand, angularVelocity);
+                return Pid::compute(demand, angularVelocity, dt);
             }
 
     };  // class _AngularVelocityPid
@@ -82,11 +82,11 @@ namespace hf {
                 _yawPid.init(Kp_yaw, Ki_yaw, 0);
             }
 
-            void modifyDemands(state_t * state, demands_t & demands)
+            void modifyDemands(state_t * state, demands_t & demands, float dt)
             {
-                demands.roll  = _rollPid.compute(demands.roll,  state->angularVel[0]);
-                demands.pitch = _pitchPid.compute(demands.pitch, state->angularVel[1]);
-                demands.yaw   = _yawPid.compute(demands.yaw, state->angularVel[2]);
+                demands.roll  = _rollPid.compute(demands.roll,  state->angularVel[0], dt);
+                demands.pitch = _pitchPid.compute(demands.pitch, state->angularVel[1], dt);
+                demands.yaw   = _yawPid.compute(demands.yaw, state->angularVel[2], dt);
 
                 // Prevent "yaw jump" during correction
                 demands.yaw = Filter::constrainAbs(demands.yaw, 0.1 + fabs(demands.yaw));
@@ -97,6 +97,16 @@ namespace hf {
                 }
             }
 
+            virtual uint8_t stateDependencies(void) override
+            {
+                return 1 << STATE_ANGULAR_VEL;
+            }
+
+            virtual bool isInnerLoop(void) override
+            {
+                return true;
+            }
+
             virtual void updateReceiver(bool throttleIsDown) override
             {
                 // Check throttle-down for integral reset
@@ -24,6 +24,7 @@
 #include <math.h>
 
 #include "datatypes.hpp"
+#include "fastmath.hpp"
 
 namespace hf {
 
@@ -171,8 +172,8 @@ namespace hf {
 
                 // Support headless mode
                 if (headless) {
-                    float c = cos(yawAngle);
-                    float s = sin(yawAngle);
+                    float s = 0, c = 0;
+                    FastMath::sincos(yawAngle, s, c);
                     float p = demands.pitch;
                     float r = demands.roll;
                     
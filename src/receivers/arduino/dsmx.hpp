@@ -19,6 +19,7 @@
 #pragma once
 
 #include "receiver.hpp"
+#include "spscring.hpp"
 #include <DSMRX.h>
 
 namespace hf {
@@ -27,8 +28,25 @@ namespace hf {
 
         private:
 
+            typedef struct {
+                uint8_t  value;
+                uint32_t usec;
+            } serialEvent_t;
+
             DSM2048 _rx;
 
+            // Bytes arrive in serial-event context; the frame parser runs only in the main loop
+            SpscRing<serialEvent_t, 64> _events;
+
+            void drainEvents(void)
+            {
+                serialEvent_t event = {};
+
+                while (_events.pop(event)) {
+                    _rx.handleSerialEvent(event.value, event.usec);
+                }
+            }
+
         protected:
 
             void begin(void)
@@ -37,6 +55,8 @@ namespace hf {
 
             bool gotNewFrame(void)
             {
+                drainEvents();
+
                 return _rx.gotNewFrame();
             }
 
@@ -59,7 +79,14 @@ namespace hf {
 
             void handleSerialEvent(uint8_t value, uint32_t usec)
             {
-                _rx.handleSerialEvent(value, usec);
+                serialEvent_t event = {value, usec};
+
+                _events.push(event);
+            }
+
+            uint32_t getDroppedByteCount(void)
+            {
+                return _events.getDropCount();
             }
 
     }; // class DSMX_Receiver
@@ -1,6 +1,9 @@
 /*
    ESP8266 support for Arduino flight controllers
 
+   Takes MSP over UDP (see udpmsp.hpp), so a lost packet never holds up newer
+   stick values the way a TCP retransmit does.
+
    This file is part of Hackflight.
 
    Hackflight is free software: you can redistribute it and/or modify
@@ -17,25 +20,55 @@
  */
 
 #include<ESP8266WiFi.h>
-#include "mspparser.hpp"
+#include<WiFiUdp.h>
+#include "udpmsp.hpp"
 
 namespace hf {
 
-    class ESP8266_Receiver : public Receiver, public MspParser {
+    class ESP8266_Receiver : public Receiver, public UdpMsp {
 
         private:
 
+            static const uint16_t PORT = 80;
+
+            static const uint16_t MAX_DATAGRAM = 256;
+
             char _ssid[100] = {0};
             char _passwd[100] = {0};
 
-            WiFiServer _server = WiFiServer(80);
-            WiFiClient _client;
+            WiFiUDP _udp;
+
+            uint8_t _datagram[MAX_DATAGRAM];
 
-            bool _haveClient = false;
-            bool _hadClient = false;
             bool _gotMessage = false;
             float _sixvals[6] = {0};
 
+            static float getTime(void)
+            {
+                return millis() / 1000.f;
+            }
+
+            void sendReplies(void)
+            {
+                if (UdpMsp::availableBytes() == 0) {
+                    return;
+                }
+
+                _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+
+                while (UdpMsp::availableBytes() > 0) {
+
+                    uint16_t count = 0;
+                    const uint8_t * bytes = UdpMsp::peekOutput(count);
+
+                    _udp.write(bytes, count);
+
+                    UdpMsp::consumeOutput(count);
+                }
+
+                _udp.endPacket();
+            }
+
         protected:
 
             void begin(void)
@@ -47,50 +80,28 @@ namespace hf {
                 else {
                     WiFi.softAP(_ssid); // no password
                 }
-                _server.begin();
-                _haveClient = false;
-                _hadClient = false;
+                _udp.begin(PORT);
                 _gotMessage = false;
                 memset(_sixvals, 0, 6*sizeof(float));
 
-                MspParser::init();
+                UdpMsp::init();
             }
 
             bool gotNewFrame(void)
             {
-                if (_haveClient) {
-
-                    if (_client.connected()) {
-
-                        bool retval = false;
-
-                        while (_client.available()) {
-                            _gotMessage = false;
-                            MspParser::parse(_client.read());
-                            if (_gotMessage) {
-                                retval = true;
-                            }
-                        }
+                _gotMessage = false;
 
-                        return retval;
-                    }
+                // Drain everything that has queued up, so we act on the newest values only
+                while (_udp.parsePacket() > 0) {
 
-                    else {
-                        _haveClient = false;
-                    }
-                }
+                    int count = _udp.read(_datagram, MAX_DATAGRAM);
 
-                else {
-                    _client = _server.available();
-                    if (_client) {
-                        _haveClient = true;
-                        _hadClient = true;
-                    } 
-                    else {
+                    if (count > 0 && UdpMsp::receive(_datagram, (uint16_t)count, getTime())) {
+                        sendReplies();
                     }
                 }
 
-                return false; 
+                return _gotMessage;
             }
 
             void readRawvals(void)
@@ -101,7 +112,7 @@ namespace hf {
 
             bool lostSignal(void)
             {
-                return _hadClient && !_haveClient;
+                return UdpMsp::gapTimedOut(getTime());
             }
 
             virtual void handle_SET_RC_NORMAL(float  c1, float  c2, float  c3, float  c4, float  c5, float  c6) override
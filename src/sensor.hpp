@@ -20,7 +20,10 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include "datatypes.hpp"
+#include "dataready.hpp"
 
 namespace hf {
 
@@ -28,12 +31,143 @@ namespace hf {
 
         friend class Hackflight;
 
+        private:
+
+            // Polling policy: by default, ready() is called on every update
+            float _pollPeriod = 0;
+            float _samplePeriod = 0;
+
+            DataReady _dataReady;
+
+            float _lastPollTime = 0;
+            float _lastSampleTime = 0;
+
+            // Supports reporting the number of polls (typically bus transactions) avoided
+            uint32_t _pollCount = 0;
+            uint32_t _skipCount = 0;
+            uint32_t _windowSkipCount = 0;
+            uint32_t _skipsPerSecond = 0;
+            float    _windowStartTime = 0;
+
+            bool shouldPoll(float time)
+            {
+                // An asynchronous driver must be resumed on every update until its transaction completes
+                if (transactionPending()) {
+                    return true;
+                }
+
+                // With a data-ready pin, the interrupt tells us exactly when to poll; an interrupt stays pending until a
+                // read succeeds, so a failed ready() is retried on the next update
+                if (_dataReady.inUse()) {
+                    return _dataReady.pending();
+                }
+
+                // Don't poll before the next sample is expected
+                if (time - _lastSampleTime < _samplePeriod) {
+                    return false;
+                }
+
+                // Don't poll more often than the minimum interval
+                return time - _lastPollTime >= _pollPeriod;
+            }
+
+            // Called on every poll(), so the window keeps rolling (and the rate drops to zero) once skipping stops
+            void updateSkipRate(float time, bool skipped)
+            {
+                if (skipped) {
+                    _skipCount++;
+                    _windowSkipCount++;
+                }
+
+                if (time - _windowStartTime >= 1) {
+                    _skipsPerSecond = _windowSkipCount;
+                    _windowSkipCount = 0;
+                    _windowStartTime = time;
+                }
+            }
+
+            // Called by Hackflight instead of ready(), so that expensive queries happen only when data can be ready
+            bool poll(float time)
+            {
+                bool skipped = !shouldPoll(time);
+
+                updateSkipRate(time, skipped);
+
+                if (skipped) {
+                    return false;
+                }
+
+                _pollCount++;
+                _lastPollTime = time;
+
+                if (ready(time)) {
+                    _lastSampleTime = time;
+                    _dataReady.handled();
+                    return true;
+                }
+
+                return false;
+            }
+
         protected:
 
             virtual void modifyState(state_t & state, float time) = 0;
 
             virtual bool ready(float time) = 0;
 
+            // Sensors whose readings can be skipped when the main loop is overloaded
+            virtual bool isStaleTolerant(void)
+            {
+                return false;
+            }
+
+            // Asynchronous drivers return true while waiting on a bus transaction
+            virtual bool transactionPending(void)
+            {
+                return false;
+            }
+
+            // Minimum time in seconds between calls to ready()
+            void setPollPeriod(float period)
+            {
+                _pollPeriod = period;
+            }
+
+            // Expected time in seconds between new samples; ready() is not called again until this has elapsed
+            void setSamplePeriod(float period)
+            {
+                _samplePeriod = period;
+            }
+
+        public:
+
+            // Call ready() only after handleDataReadyInterrupt() has been called from the sensor's interrupt routine
+            void useDataReadyPin(void)
+            {
+                _dataReady.use();
+            }
+
+            void handleDataReadyInterrupt(void)
+            {
+                _dataReady.interrupt();
+            }
+
+            uint32_t getPollCount(void)
+            {
+                return _pollCount;
+            }
+
+            uint32_t getSkippedPollCount(void)
+            {
+                return _skipCount;
+            }
+
+            // Polls avoided over the most recent one-second window
+            uint32_t getSkippedPollsPerSecond(void)
+            {
+                return _skipsPerSecond;
+            }
+
     };  // class Sensor
 
 } // namespace hf
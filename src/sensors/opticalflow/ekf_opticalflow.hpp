@@ -58,7 +58,7 @@ namespace hf {
             // While tracking elapsed time, store delta time
             float _deltaTime = 0;
 
-            // The quad's attitude as a rotation matrix (used by the prediction, updated by the finalization)
+            // The quad's attitude as a rotation matrix, taken from the vehicle state on each update
             float R[3][3] = {{1,0,0},{0,1,0},{0,0,1}};
 
             // The quad's state, stored as a column vector
@@ -88,9 +88,7 @@ namespace hf {
             float _measuredNX = 0;
             float _measuredNY = 0;
 
-            float q[4] = {1,0,0,0};
-
-            Matrix Pm = Matrix(STATE_DIM, STATE_DIM);
+            SymmetricMatrix<STATE_DIM> Pm;
 
             static constexpr float STDDEV = 0.25f;
 
@@ -105,6 +103,7 @@ namespace hf {
             {
                 if (std::isnan(x)) {
                     Debugger::printf("%s is NaN after %d steps\n", name, count);
+                    Debugger::flush();
                     while (true) {
                     }
                 }
@@ -117,7 +116,7 @@ namespace hf {
                         reset();
                         return;
                     }
-                    for(int j=0; j<STATE_DIM; j++) {
+                    for(int j=i; j<STATE_DIM; j++) {
                         if (std::isnan(Pm.get(i,j))) {
                             reset();
                             return;
@@ -130,47 +129,41 @@ namespace hf {
             {
                 for (uint8_t j=0; j<STATE_DIM; ++j) {
                     S[j] = 0;
-                    for (uint8_t k=0; k<STATE_DIM; ++k) {
-                        Pm.set(j,k,0);
+                }
+
+                Pm.zero();
+            }
+
+            // Ensures the covariance values stay bounded; symmetry is kept by SymmetricMatrix
+            void constrainCovariance(void)
+            {
+                for (int i=0; i<STATE_DIM; i++) {
+                    for (int j=i; j<STATE_DIM; j++) {
+                        float p = Pm.get(i,j);
+                        if (std::isnan(p) || p > MAX_COVARIANCE) {
+                            Pm.set(i, j, MAX_COVARIANCE);
+                        } else if ( i==j && p < MIN_COVARIANCE ) {
+                            Pm.set(i, j, MIN_COVARIANCE);
+                        }
                     }
                 }
             }
 
             void stateEstimatorFinalize(void)
             {
-                // Matrix to rotate the attitude covariances once updated
-                static Matrix Am(STATE_DIM, STATE_DIM);
-
-                // Temporary matrices for the covariance updates
-                static Matrix tmpNN1m(STATE_DIM, STATE_DIM);
-                static Matrix tmpNN2m(STATE_DIM, STATE_DIM);
-
                 // Incorporate the attitude error (Kalman filter state) with the attitude
                 float v0 = S[STATE_D0];
                 float v1 = S[STATE_D1];
                 float v2 = S[STATE_D2];
 
-                // Move attitude error into attitude if any of the angle errors are large enough
+                // Rotate the covariance if any of the angle errors are large enough.  The attitude itself comes from
+                // the vehicle state, so there is no quaternion of our own to correct; nor is there any error to apply.
+                // This filter has no prediction step, and the flow measurements involve only Z, PX and PY, so the
+                // covariance never couples the attitude-error states to anything the measurements observe: their
+                // Kalman gain, and so their value, stays zero.  A prediction step that couples them (as in the
+                // Crazyflie estimator) would need the correction applied to the vehicle's quaternion.
                 if ((fabsf(v0) > 0.1e-3f || fabsf(v1) > 0.1e-3f || fabsf(v2) > 0.1e-3f) && (fabsf(v0) < 10 && fabsf(v1) < 10 && fabsf(v2) < 10)) {
 
-                    float angle = sqrt(v0*v0 + v1*v1 + v2*v2);
-                    float ca = cos(angle / 2.0f);
-                    float sa = sin(angle / 2.0f);
-                    float dq[4] = {ca, sa * v0 / angle, sa * v1 / angle, sa * v2 / angle};
-
-                    // rotate the quad's attitude by the delta quaternion vector computed above
-                    float tmpq0 = dq[0] * q[0] - dq[1] * q[1] - dq[2] * q[2] - dq[3] * q[3];
-                    float tmpq1 = dq[1] * q[0] + dq[0] * q[1] + dq[3] * q[2] - dq[2] * q[3];
-                    float tmpq2 = dq[2] * q[0] - dq[3] * q[1] + dq[0] * q[2] + dq[1] * q[3];
-                    float tmpq3 = dq[3] * q[0] + dq[2] * q[1] - dq[1] * q[2] + dq[0] * q[3];
-
-                    // normalize and store the result
-                    float norm = sqrt(tmpq0 * tmpq0 + tmpq1 * tmpq1 + tmpq2 * tmpq2 + tmpq3 * tmpq3);
-                    q[0] = tmpq0 / norm;
-                    q[1] = tmpq1 / norm;
-                    q[2] = tmpq2 / norm;
-                    q[3] = tmpq3 / norm;
-
                     /** Rotate the covariance, since we've rotated the body
                      *
                      * This comes from a second order approximation to:
@@ -186,44 +179,24 @@ namespace hf {
                     float d1 = v1/2; // so we use a first order approximation to d0 = tan(|v0|/2)*v0/|v0|
                     float d2 = v2/2;
 
-                    Am.set(STATE_X,STATE_X, 1);
-                    Am.set(STATE_Y,STATE_Y, 1);
-                    Am.set(STATE_Z,STATE_Z, 1);
-
-                    Am.set(STATE_PX,STATE_PX, 1);
-                    Am.set(STATE_PY,STATE_PY, 1);
-                    Am.set(STATE_PZ,STATE_PZ, 1);
+                    // The rotation is the identity except for the attitude error block
+                    Matrix<3,3> Am;
 
-                    Am.set(STATE_D0,STATE_D0,  1 - d1*d1/2 - d2*d2/2);
-                    Am.set(STATE_D0,STATE_D1,  d2 + d0*d1/2);
-                    Am.set(STATE_D0,STATE_D2, -d1 + d0*d2/2);
+                    Am.set(0,0,  1 - d1*d1/2 - d2*d2/2);
+                    Am.set(0,1,  d2 + d0*d1/2);
+                    Am.set(0,2, -d1 + d0*d2/2);
 
-                    Am.set(STATE_D1,STATE_D0, -d2 + d0*d1/2);
-                    Am.set(STATE_D1,STATE_D1,  1 - d0*d0/2 - d2*d2/2);
-                    Am.set(STATE_D1,STATE_D2,  d0 + d1*d2/2);
+                    Am.set(1,0, -d2 + d0*d1/2);
+                    Am.set(1,1,  1 - d0*d0/2 - d2*d2/2);
+                    Am.set(1,2,  d0 + d1*d2/2);
 
-                    Am.set(STATE_D2,STATE_D0,  d1 + d0*d2/2);
-                    Am.set(STATE_D2,STATE_D1, -d0 + d1*d2/2);
-                    Am.set(STATE_D2,STATE_D2, 1 - d0*d0/2 - d1*d1/2);
+                    Am.set(2,0,  d1 + d0*d2/2);
+                    Am.set(2,1, -d0 + d1*d2/2);
+                    Am.set(2,2, 1 - d0*d0/2 - d1*d1/2);
 
-                    Matrix::trans(Am, tmpNN1m); // A'
-                    Matrix::mult(Am, Pm, tmpNN2m); // AP
-                    Matrix::mult(tmpNN2m, tmpNN1m, Pm); //APA'
+                    Pm.transform(STATE_D0, Am); // APA'
                 }
 
-                // convert the new attitude to a rotation matrix, such that we can rotate body-frame velocity and acc
-                R[0][0] = q[0] * q[0] + q[1] * q[1] - q[2] * q[2] - q[3] * q[3];
-                R[0][1] = 2 * q[1] * q[2] - 2 * q[0] * q[3];
-                R[0][2] = 2 * q[1] * q[3] + 2 * q[0] * q[2];
-
-                R[1][0] = 2 * q[1] * q[2] + 2 * q[0] * q[3];
-                R[1][1] = q[0] * q[0] - q[1] * q[1] + q[2] * q[2] - q[3] * q[3];
-                R[1][2] = 2 * q[2] * q[3] - 2 * q[0] * q[1];
-
-                R[2][0] = 2 * q[1] * q[3] - 2 * q[0] * q[2];
-                R[2][1] = 2 * q[2] * q[3] + 2 * q[0] * q[1];
-                R[2][2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
-
                 // reset the attitude error
                 S[STATE_D0] = 0;
                 S[STATE_D1] = 0;
@@ -239,49 +212,30 @@ namespace hf {
                     else if (S[STATE_PX+i] > MAX_VELOCITY) { S[STATE_PX+i] = MAX_VELOCITY; }
                 }
 
-                // enforce symmetry of the covariance matrix, and ensure the values stay bounded
-                for (int i=0; i<STATE_DIM; i++) {
-                    for (int j=i; j<STATE_DIM; j++) {
-                        float p = 0.5f*Pm.get(i,j) + 0.5f*Pm.get(j,i);
-                        if (std::isnan(p) || p > MAX_COVARIANCE) {
-                            Pm.set(i, j, MAX_COVARIANCE);
-                            Pm.set(j, i, MAX_COVARIANCE);
-                        } else if ( i==j && p < MIN_COVARIANCE ) {
-                            Pm.set(i, j, MIN_COVARIANCE);
-                            Pm.set(j, i, MIN_COVARIANCE);
-                        } else {
-                            Pm.set(i, j, p);
-                            Pm.set(j, i, p);
-                        }
-                    }
-                }
+                // ensure the covariance values stay bounded
+                constrainCovariance();
             }
 
-            void stateEstimatorScalarUpdate(Matrix & Hm, float error, float stdMeasNoise, const char * label)
+            void stateEstimatorScalarUpdate(const Matrix<1,STATE_DIM> & Hm, float error, float stdMeasNoise, const char * label)
             {
                 // The Kalman gain as a column vector
-                static Matrix Km(STATE_DIM, 1);
+                Matrix<STATE_DIM,1> Km;
 
-                // Temporary matrices for the covariance updates
-                static Matrix tmpNN1m(STATE_DIM, STATE_DIM);
-                static Matrix tmpNN2m(STATE_DIM, STATE_DIM);
-                static Matrix tmpNN3m(STATE_DIM, STATE_DIM);
-                static Matrix HTm(STATE_DIM, 1);
-                static Matrix PHTm(STATE_DIM, 1);
+                Matrix<STATE_DIM,1> PHTm;
 
                 // ====== INNOVATION COVARIANCE ======
 
-                Matrix::trans(Hm, HTm);
-
-                Matrix::mult(Pm, HTm, PHTm); // PH'
+                Pm.mult(Hm, PHTm); // PH'
                 float R = stdMeasNoise*stdMeasNoise;
-                float HPHR = R; // HPH' + R
+                float HPH = 0;
 
 
                 for (int i=0; i<STATE_DIM; i++) { // Add the element of HPH' to the above
-                    HPHR += Hm.get(0,i)*PHTm.get(i,0); // this obviously only works if the update is scalar (as in this function)
+                    HPH += Hm.get(0,i)*PHTm.get(i,0); // this obviously only works if the update is scalar (as in this function)
                 }
 
+                float HPHR = HPH + R; // HPH' + R
+
                 checkNan(HPHR, "HPHR", count++);
 
                 // ====== MEASUREMENT UPDATE ======
@@ -293,33 +247,12 @@ namespace hf {
                 stateEstimatorAssertNotNaN();
 
                 // ====== COVARIANCE UPDATE ======
-                Matrix::mult(Km, Hm, tmpNN1m); // KH
-                for (int i=0; i<STATE_DIM; i++) { 
-                    tmpNN1m.set(i,i, tmpNN1m.get(i,i)-1);// KH - I
-                }
-                Matrix::trans(tmpNN1m, tmpNN2m); // (KH - I)'
-                Matrix::mult(tmpNN1m, Pm, tmpNN3m); // (KH - I)*P
-                Matrix::mult(tmpNN3m, tmpNN2m, Pm); // (KH - I)*P*(KH - I)'
+                Pm.josephUpdate(Km, PHTm, HPH, R); // (KH - I)*P*(KH - I)' + KRK'
 
                 //stateEstimatorAssertNotNaN();
-                // add the measurement variance and ensure boundedness and symmetry
+                // ensure boundedness
                 // TODO: Why would it hit these bounds? Needs to be investigated.
-                for (int i=0; i<STATE_DIM; i++) {
-                    for (int j=i; j<STATE_DIM; j++) {
-                        float v = Km.get(i,0) * R * Km.get(j,0);
-                        float p = 0.5f*Pm.get(i,j) + 0.5f*Pm.get(j,i) + v; // add measurement noise
-                        if (std::isnan(p) || p > MAX_COVARIANCE) {
-                            Pm.set(i,j, MAX_COVARIANCE);
-                            Pm.set(j,i, MAX_COVARIANCE);
-                        } else if ( i==j && p < MIN_COVARIANCE ) {
-                            Pm.set(i,j, MIN_COVARIANCE);
-                            Pm.set(j,i, MIN_COVARIANCE);
-                        } else {
-                            Pm.set(i,j, p);
-                            Pm.set(j,i, p);
-                        }
-                    }
-                }
+                constrainCovariance();
 
                 stateEstimatorAssertNotNaN();
             }
@@ -332,6 +265,9 @@ namespace hf {
                 // Avoid time blips
                 if (_deltaTime > 0.02) return;
 
+                // Get the attitude as a rotation matrix, computed at most once per quaternion update
+                state.getRotationMatrix(R);
+
                 S[STATE_Z] = state.location[2];
                 S[STATE_PZ] = state.inertialVel[2];
 
@@ -353,7 +289,7 @@ namespace hf {
                 // ~~~ X velocity prediction and update ~~~
                 // predicts the number of accumulated pixels in the x-direction
                 float omegaFactor = 1.25f;
-                Matrix Hx(1, STATE_DIM);
+                Matrix<1,STATE_DIM> Hx;
                 _predictedNX = (_deltaTime * Npix / thetapix ) * ((_dx_g * R[2][2] / _z_g) - omegaFactor * _omegay_b);
                 _measuredNX = (float)dpixelx * FLOW_SCALE;
 
@@ -365,7 +301,7 @@ namespace hf {
                 stateEstimatorScalarUpdate(Hx, _measuredNX-_predictedNX, STDDEV, "X");
 
                 // ~~~ Y velocity prediction and update ~~~
-                Matrix Hy(1, STATE_DIM);
+                Matrix<1,STATE_DIM> Hy;
                 _predictedNY = (_deltaTime * Npix / thetapix ) * ((_dy_g * R[2][2] / _z_g) + omegaFactor * _omegax_b);
                 _measuredNY = (float)dpixely * FLOW_SCALE;
 
@@ -378,10 +314,11 @@ namespace hf {
 
                 stateEstimatorFinalize();
 
-                Debugger::printf("%+3.3f,%+3.3f\n", S[STATE_PX], S[STATE_PY]);
+                // Velocities are estimated in the body frame
+                state.bodyVel[0] = S[STATE_PX];
+                state.bodyVel[1] = S[STATE_PY];
 
-                state.inertialVel[0] = 0;
-                state.inertialVel[1] = 0;
+                state.markChanged(STATE_BODY_VEL);
             }
 
             virtual bool ready(float time) override
@@ -20,73 +20,261 @@
 
 #pragma once
 
-#include <string.h>
+#include <stdint.h>
 #include <debugger.hpp>
 
 namespace hf {
 
+    template <uint8_t N>
+    class SymmetricMatrix;
+
+    template <uint8_t R, uint8_t C>
     class Matrix {
 
-        private:
+        template <uint8_t, uint8_t>
+        friend class Matrix;
 
-            // avoid dynamic memory allocation
-            static const uint8_t MAXSIZE = 10;
+        template <uint8_t>
+        friend class SymmetricMatrix;
 
-            uint8_t _rows = 0;
-            uint8_t _cols0;
+        private:
 
-            float _vals[MAXSIZE][MAXSIZE];
+            float _vals[R][C] = {};
 
         public:
 
-            Matrix(uint8_t rows, uint8_t cols) 
-            {
-                _rows = rows;
-                _cols = cols;
-                memset(_vals, 0, rows*cols*sizeof(float));
-            }
+            static constexpr uint8_t rows = R;
+            static constexpr uint8_t cols = C;
 
-            float get(uint8_t j, uint8_t k)
+            float get(uint8_t j, uint8_t k) const
             {
                 return _vals[j][k];
             }
 
-            float set(uint8_t j, uint8_t k, float val)
+            void set(uint8_t j, uint8_t k, float val)
             {
                 _vals[j][k] = val;
             }
 
-            void dump(void)
+            void zero(void)
             {
-                for (uint8_t j=0; j<_rows; ++j) {
-                    for (uint8_t k=0; k<_cols; ++k) {
+                for (uint8_t j=0; j<R; ++j) {
+                    for (uint8_t k=0; k<C; ++k) {
+                        _vals[j][k] = 0;
+                    }
+                }
+            }
+
+            void dump(void) const
+            {
+                for (uint8_t j=0; j<R; ++j) {
+                    for (uint8_t k=0; k<C; ++k) {
                         Debugger::printf("%+2.2f ", _vals[j][k]);
                     }
                     Debugger::printf("\n");
+
+                    // A row at a time, so large matrices don't overflow the debug queue
+                    Debugger::flush();
                 }
             }
 
-            static void trans(Matrix & a, Matrix & at)
+            static void trans(const Matrix<R,C> & a, Matrix<C,R> & at)
             {
-                for (uint8_t j=0; j<a._rows; ++j) {
-                    for (uint8_t k=0; k<a._cols; ++k) {
+                for (uint8_t j=0; j<R; ++j) {
+                    for (uint8_t k=0; k<C; ++k) {
                         at._vals[k][j] = a._vals[j][k];
                     }
                 }
             }
 
-            static void mult(Matrix & a, Matrix & b, Matrix & c)
+            template <uint8_t K>
+            static void mult(const Matrix<R,K> & a, const Matrix<K,C> & b, Matrix<R,C> & c)
             {
-                for(uint8_t i=0; i<a._rows; ++i) {
-                    for(uint8_t j=0; j<b._cols; ++j) {
-                        c._vals[i][j] = 0;
-                        for(uint8_t k=0; k<a._cols; ++k) {
-                            c._vals[i][j] += a._vals[i][k] *b._vals[k][j];
+                for (uint8_t i=0; i<R; ++i) {
+                    for (uint8_t j=0; j<C; ++j) {
+                        float sum = 0;
+                        for (uint8_t k=0; k<K; ++k) {
+                            sum += a._vals[i][k] * b._vals[k][j];
                         }
+                        c._vals[i][j] = sum;
                     }
                 }
             }
 
     };  // class Matrix
 
+    // Covariance matrix: only the upper triangle is stored, so symmetry holds by construction
+    template <uint8_t N>
+    class SymmetricMatrix {
+
+        private:
+
+            static constexpr uint16_t SIZE = N * (N+1) / 2;
+
+            // Upper triangle, row by row
+            float _vals[SIZE] = {};
+
+            static uint16_t index(uint8_t j, uint8_t k)
+            {
+                if (j > k) {
+                    uint8_t tmp = j;
+                    j = k;
+                    k = tmp;
+                }
+
+                return j * (2*N - j - 1) / 2 + k;
+            }
+
+        public:
+
+            static constexpr uint8_t rows = N;
+            static constexpr uint8_t cols = N;
+
+            float get(uint8_t j, uint8_t k) const
+            {
+                return _vals[index(j, k)];
+            }
+
+            // Sets both (j,k) and (k,j)
+            void set(uint8_t j, uint8_t k, float val)
+            {
+                _vals[index(j, k)] = val;
+            }
+
+            void zero(void)
+            {
+                for (uint16_t k=0; k<SIZE; ++k) {
+                    _vals[k] = 0;
+                }
+            }
+
+            void dump(void) const
+            {
+                for (uint8_t j=0; j<N; ++j) {
+                    for (uint8_t k=0; k<N; ++k) {
+                        Debugger::printf("%+2.2f ", get(j, k));
+                    }
+                    Debugger::printf("\n");
+                    Debugger::flush();
+                }
+            }
+
+            // ph = P h', where h is a row vector; measurement rows are mostly zeros, which are skipped
+            void mult(const Matrix<1,N> & h, Matrix<N,1> & ph) const
+            {
+                ph.zero();
+
+                for (uint8_t k=0; k<N; ++k) {
+
+                    float hk = h._vals[0][k];
+
+                    if (hk == 0) {
+                        continue;
+                    }
+
+                    for (uint8_t j=0; j<N; ++j) {
+                        ph._vals[j][0] += get(j, k) * hk;
+                    }
+                }
+            }
+
+            // P = A P A'
+            void transform(const Matrix<N,N> & a)
+            {
+                // AP, reading P through its symmetry
+                Matrix<N,N> ap;
+                for (uint8_t i=0; i<N; ++i) {
+                    for (uint8_t j=0; j<N; ++j) {
+                        float sum = 0;
+                        for (uint8_t k=0; k<N; ++k) {
+                            sum += a._vals[i][k] * get(k, j);
+                        }
+                        ap._vals[i][j] = sum;
+                    }
+                }
+
+                // (AP)A', upper triangle only
+                uint16_t n = 0;
+                for (uint8_t i=0; i<N; ++i) {
+                    for (uint8_t j=i; j<N; ++j) {
+                        float sum = 0;
+                        for (uint8_t k=0; k<N; ++k) {
+                            sum += ap._vals[i][k] * a._vals[j][k];
+                        }
+                        _vals[n++] = sum;
+                    }
+                }
+            }
+
+            // P = A P A', where A is the identity except for the M x M block b starting at row and column offset
+            template <uint8_t M>
+            void transform(uint8_t offset, const Matrix<M,M> & b)
+            {
+                // Rows of the block, outside its columns: b times the block's rows of P
+                for (uint8_t j=0; j<N; ++j) {
+
+                    if (j >= offset && j < offset+M) {
+                        continue;
+                    }
+
+                    float col[M];
+                    for (uint8_t i=0; i<M; ++i) {
+                        float sum = 0;
+                        for (uint8_t k=0; k<M; ++k) {
+                            sum += b._vals[i][k] * get(offset+k, j);
+                        }
+                        col[i] = sum;
+                    }
+
+                    for (uint8_t i=0; i<M; ++i) {
+                        set(offset+i, j, col[i]);
+                    }
+                }
+
+                // The block itself: b P b', upper triangle only
+                Matrix<M,M> bp;
+                for (uint8_t i=0; i<M; ++i) {
+                    for (uint8_t j=0; j<M; ++j) {
+                        float sum = 0;
+                        for (uint8_t k=0; k<M; ++k) {
+                            sum += b._vals[i][k] * get(offset+k, offset+j);
+                        }
+                        bp._vals[i][j] = sum;
+                    }
+                }
+
+                for (uint8_t i=0; i<M; ++i) {
+                    for (uint8_t j=i; j<M; ++j) {
+                        float sum = 0;
+                        for (uint8_t k=0; k<M; ++k) {
+                            sum += bp._vals[i][k] * b._vals[j][k];
+                        }
+                        set(offset+i, offset+j, sum);
+                    }
+                }
+            }
+
+            // Joseph-form update for a scalar measurement h with gain k and noise variance r:
+            //
+            //   P = (I - kh) P (I - kh)' + k r k'
+            //     = P - k ph' - ph k' + (hph + r) k k'
+            //
+            // where ph = P h' and hph = h P h', so no N x N products are needed
+            void josephUpdate(const Matrix<N,1> & k, const Matrix<N,1> & ph, float hph, float r)
+            {
+                float s = hph + r;
+
+                uint16_t n = 0;
+                for (uint8_t i=0; i<N; ++i) {
+                    float ki = k._vals[i][0];
+                    float phi = ph._vals[i][0];
+                    for (uint8_t j=i; j<N; ++j) {
+                        float kj = k._vals[j][0];
+                        _vals[n++] += -ki * ph._vals[j][0] - phi * kj + s * ki * kj;
+                    }
+                }
+            }
+
+    };  // class SymmetricMatrix
+
 } // namespace hf
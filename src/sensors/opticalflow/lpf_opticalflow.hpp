@@ -67,6 +67,9 @@ namespace hf {
                 // Integrate velocity to get position
                 state.location[0] += state.inertialVel[0];
                 state.location[1] += state.inertialVel[1];
+
+                state.markChanged(STATE_INERTIAL_VEL);
+                state.markChanged(STATE_LOCATION);
             }
 
             virtual bool ready(float time) override
@@ -25,6 +25,7 @@
 
 #include "sensor.hpp"
 #include "filters.hpp"
+#include "fastmath.hpp"
 
 namespace hf {
 
@@ -32,10 +33,13 @@ namespace hf {
 
         private:
 
-            static constexpr float UPDATE_HZ = 25; // XXX should be using interrupt!
+            static constexpr float UPDATE_HZ = 25; // use Sensor::useDataReadyPin() if you have an interrupt line
 
             static constexpr float UPDATE_PERIOD = 1/UPDATE_HZ;
 
+            // Once a reading is due, poll for it at this fraction of the update period
+            static constexpr float POLL_PERIOD = UPDATE_PERIOD / 10;
+
             float _distance = 0;
 
             LowPassFilter _lpf = LowPassFilter(20);
@@ -49,11 +53,14 @@ namespace hf {
                 static float _altitude;
 
                 // Compensate for effect of pitch, roll on rangefinder reading
-                state.location[2] =  _distance * cos(state.rotation[0]) * cos(state.rotation[1]);
+                state.location[2] =  _distance * FastMath::cos(state.getRotation(AXIS_ROLL)) * FastMath::cos(state.getRotation(AXIS_PITCH));
 
                 // Use first-differenced, low-pass-filtered altitude as variometer
                 state.inertialVel[2] = _lpf.update((state.location[2]-_altitude) / (time-_time));
 
+                state.markChanged(STATE_LOCATION);
+                state.markChanged(STATE_INERTIAL_VEL);
+
                 // Update first-difference values
                 _time = time;
                 _altitude = state.location[2];
@@ -61,32 +68,27 @@ namespace hf {
 
             virtual bool ready(float time) override
             {
-                float newDistance;
-
-                if (distanceAvailable(newDistance)) {
-
-                    static float _time;
-
-                    if (time-_time > UPDATE_PERIOD) {
-
-                        _distance = newDistance;
-
-                        _time = time; 
+                (void)time;
 
-                        return true;
-                    }
-                }
-
-                return false; 
+                // Sensor::poll() keeps us from querying the rangefinder before its next reading is due
+                return distanceAvailable(_distance);
             }
 
-
             virtual bool distanceAvailable(float & distance) = 0;
 
+            // Altitude changes slowly and is low-pass filtered, so a late reading does little harm
+            virtual bool isStaleTolerant(void) override
+            {
+                return true;
+            }
+
         public:
 
             Rangefinder(void) 
             {
+                setSamplePeriod(UPDATE_PERIOD);
+                setPollPeriod(POLL_PERIOD);
+
                 _lpf.init();
             }
 
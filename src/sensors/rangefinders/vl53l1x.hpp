@@ -1,6 +1,10 @@
 /*
    Support for VL53L1X time-of-flight rangefinder
 
+   The library is used only to start the sensor; readings are then polled
+   through a non-blocking bus one transaction per update, so the loop never
+   waits on the sensor.
+
    Copyright (c) 2018 Simon D. Levy
 
    This file is part of Hackflight.
@@ -22,6 +26,8 @@
 
 #include <VL53L1X.h>
 #include "sensors/rangefinder.hpp"
+#include "asyncbus.hpp"
+#include "buses/wireasync.hpp"
 
 namespace hf {
 
@@ -29,17 +35,114 @@ namespace hf {
 
         private:
 
+            static const uint8_t ADDRESS = 0x29;
+
+            static const uint16_t REG_GPIO_HV_MUX_CTRL   = 0x0030;
+            static const uint16_t REG_GPIO_TIO_HV_STATUS = 0x0031;
+            static const uint16_t REG_INTERRUPT_CLEAR    = 0x0086;
+            static const uint16_t REG_RANGE_MM           = 0x0096;
+
+            // Each state names the transaction we are waiting on
+            typedef enum {
+                STATE_START,
+                STATE_POLARITY,
+                STATE_CHECK_READY,
+                STATE_READ_DISTANCE,
+                STATE_CLEAR_INTERRUPT
+            } driverState_t;
+
             VL53L1X _distanceSensor;
 
+            WireAsyncBus _wireBus;
+            AsyncBus * _bus = &_wireBus;
+
+            AsyncBus::transaction_t _transaction = {};
+            uint8_t _buffer[2] = {};
+
+            driverState_t _state = STATE_START;
+
+            uint8_t _interruptPolarity = 1;
+            float   _pendingDistance = 0;
+
+            void readRegister(uint16_t reg, uint8_t count, driverState_t next)
+            {
+                AsyncBus::setRead(_transaction, ADDRESS, reg, 2, _buffer, count);
+                submit(next);
+            }
+
+            void writeRegister(uint16_t reg, uint8_t value, driverState_t next)
+            {
+                _buffer[0] = value;
+                AsyncBus::setWrite(_transaction, ADDRESS, reg, 2, _buffer, 1);
+                submit(next);
+            }
+
+            void submit(driverState_t next)
+            {
+                _state = _bus->submit(&_transaction) ? next : STATE_START;
+            }
+
         protected:
 
+            virtual bool transactionPending(void) override
+            {
+                return _state != STATE_START && _state != STATE_CHECK_READY;
+            }
+
+            virtual bool ready(float time) override
+            {
+                _bus->update(time);
+
+                return Rangefinder::ready(time);
+            }
+
+            // Advances the state machine by at most one completed transaction
             virtual bool distanceAvailable(float & distance) override
             {
-                if (_distanceSensor.newDataReady()) {
-                    distance = _distanceSensor.getDistance() / 1000.f; // mm => m
-                    return true;
+                if (_transaction.status == AsyncBus::QUEUED || _transaction.status == AsyncBus::IN_PROGRESS) {
+                    return false;
                 }
-                return false;
+
+                if (_transaction.status == AsyncBus::FAILED) {
+                    _transaction.status = AsyncBus::IDLE;
+                    _state = STATE_START;
+                    return false;
+                }
+
+                bool haveDistance = false;
+
+                switch (_state) {
+
+                    case STATE_START:
+                        readRegister(REG_GPIO_HV_MUX_CTRL, 1, STATE_POLARITY);
+                        break;
+
+                    case STATE_POLARITY:
+                        _interruptPolarity = (_buffer[0] & 0x10) ? 0 : 1;
+                        readRegister(REG_GPIO_TIO_HV_STATUS, 1, STATE_CHECK_READY);
+                        break;
+
+                    case STATE_CHECK_READY:
+                        if ((_buffer[0] & 0x01) == _interruptPolarity) {
+                            readRegister(REG_RANGE_MM, 2, STATE_READ_DISTANCE);
+                        }
+                        else {
+                            readRegister(REG_GPIO_TIO_HV_STATUS, 1, STATE_CHECK_READY);
+                        }
+                        break;
+
+                    case STATE_READ_DISTANCE:
+                        _pendingDistance = ((_buffer[0] << 8) | _buffer[1]) / 1000.f; // mm => m
+                        writeRegister(REG_INTERRUPT_CLEAR, 0x01, STATE_CLEAR_INTERRUPT);
+                        break;
+
+                    case STATE_CLEAR_INTERRUPT:
+                        distance = _pendingDistance;
+                        haveDistance = true;
+                        readRegister(REG_GPIO_TIO_HV_STATUS, 1, STATE_CHECK_READY);
+                }
+
+                return haveDistance;
             }
 
         public:
@@ -49,6 +152,12 @@ namespace hf {
                 _distanceSensor.begin();
             }
 
+            // Use a different bus (e.g., DMA-driven or SimulatedBus) for readings
+            void useBus(AsyncBus * bus)
+            {
+                _bus = bus;
+            }
+
     }; // class VL53L1X_Rangefinder 
 
 } // namespace hf
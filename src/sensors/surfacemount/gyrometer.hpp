@@ -46,6 +46,8 @@ namespace hf {
                 state.angularVel[0] =  _x;
                 state.angularVel[1] = -_y;
                 state.angularVel[2] = -_z;
+
+                state.markChanged(STATE_ANGULAR_VEL);
             }
 
             virtual bool ready(float time) override
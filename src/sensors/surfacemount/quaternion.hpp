@@ -56,12 +56,8 @@ namespace hf {
             {
                 (void)time;
 
-                computeEulerAngles(_w, _x, _y, _z, state.rotation);
-
-                // Convert heading from [-pi,+pi] to [0,2*pi]
-                if (state.rotation[2] < 0) {
-                    state.rotation[2] += 2*M_PI;
-                }
+                // Euler angles and rotation matrix are computed on demand from the quaternion
+                state.setQuaternion(_w, _x, _y, _z);
             }
 
             virtual bool ready(float time) override
@@ -74,13 +70,10 @@ namespace hf {
             // We make this public so we can use it in different sketches
             static void computeEulerAngles(float qw, float qx, float qy, float qz, float euler[3])
             {
-                euler[0] = atan2(2.0f*(qw*qx+qy*qz),qw*qw-qx*qx-qy*qy+qz*qz);
-                euler[1] =  asin(2.0f*(qx*qz-qw*qy));
-                euler[2] = atan2(2.0f*(qx*qy+qw*qz),qw*qw+qx*qx-qy*qy-qz*qz);
-
-                euler[0] = int(euler[0]*1000)/1000.0;
-                euler[1] = int(euler[1]*1000)/1000.0;
-                euler[2] = int(euler[2]*1000)/1000.0;
+                // Kernel errors are well below the old milliradian rounding, so we no longer round
+                for (uint8_t axis=AXIS_ROLL; axis<=AXIS_YAW; ++axis) {
+                    euler[axis] = state_t::eulerAngle(qw, qx, qy, qz, axis);
+                }
             }
 
     };  // class Quaternion
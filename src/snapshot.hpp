@@ -0,0 +1,67 @@
+/*
+   Double-buffered lock-free snapshot
+
+   The writer alternates between two seqlock slots and then publishes which
+   one is newest, so a reader copying the published slot is disturbed only if
+   the writer laps it.  Used to exchange state and demands between cores.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "latestvalue.hpp"
+
+namespace hf {
+
+    template <typename T>
+    class Snapshot {
+
+        private:
+
+            LatestValue<T> _slots[2];
+
+            // Slot holding the newest value
+            uint8_t _published = 0;
+
+            // Writer only
+            uint32_t _writeCount = 0;
+
+        public:
+
+            void write(const T & value)
+            {
+                uint8_t slot = _writeCount & 1;
+
+                _slots[slot].write(value);
+
+                __atomic_store_n(&_published, slot, __ATOMIC_RELEASE);
+
+                _writeCount++;
+            }
+
+            // Copies the newest value and returns true if it has not been read before
+            bool read(T & value)
+            {
+                return _slots[__atomic_load_n(&_published, __ATOMIC_ACQUIRE)].read(value);
+            }
+
+    }; // class Snapshot
+
+} // namespace hf
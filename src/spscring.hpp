@@ -0,0 +1,165 @@
+/*
+   Wait-free single-producer / single-consumer ring buffer
+
+   Hands data from an interrupt routine (or another core) to the main loop
+   without locks: only the producer writes the head index, and only the
+   consumer writes the tail index.  Capacity N must be a power of two.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    template <typename T, uint16_t N>
+    class SpscRing {
+
+        static_assert(N > 0 && (N & (N-1)) == 0, "SpscRing size must be a power of two");
+
+        private:
+
+            T _items[N];
+
+            // Free-running indices; head - tail is the number of items in the ring
+            uint16_t _head = 0;
+            uint16_t _tail = 0;
+
+            uint32_t _dropCount = 0;
+
+        public:
+
+            // Producer side: returns false (and counts a drop) if the ring is full
+            bool push(const T & item)
+            {
+                uint16_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+                uint16_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+
+                if ((uint16_t)(head - tail) == N) {
+                    _dropCount++;
+                    return false;
+                }
+
+                _items[head & (N-1)] = item;
+
+                __atomic_store_n(&_head, (uint16_t)(head + 1), __ATOMIC_RELEASE);
+
+                return true;
+            }
+
+            // Consumer side: returns false if the ring is empty
+            bool pop(T & item)
+            {
+                uint16_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+                uint16_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+
+                if (head == tail) {
+                    return false;
+                }
+
+                item = _items[tail & (N-1)];
+
+                __atomic_store_n(&_tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+
+                return true;
+            }
+
+            // Producer side, all or nothing: returns false (and counts a drop) unless every item fits
+            bool push(const T * items, uint16_t count)
+            {
+                uint16_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+                uint16_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+
+                if ((uint16_t)(N - (uint16_t)(head - tail)) < count) {
+                    _dropCount++;
+                    return false;
+                }
+
+                for (uint16_t k=0; k<count; ++k) {
+                    _items[(uint16_t)(head + k) & (N-1)] = items[k];
+                }
+
+                __atomic_store_n(&_head, (uint16_t)(head + count), __ATOMIC_RELEASE);
+
+                return true;
+            }
+
+            // Consumer side: returns how many items were popped, up to count
+            uint16_t pop(T * items, uint16_t count)
+            {
+                uint16_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+                uint16_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+
+                uint16_t available = head - tail;
+
+                if (count > available) {
+                    count = available;
+                }
+
+                for (uint16_t k=0; k<count; ++k) {
+                    items[k] = _items[(uint16_t)(tail + k) & (N-1)];
+                }
+
+                __atomic_store_n(&_tail, (uint16_t)(tail + count), __ATOMIC_RELEASE);
+
+                return count;
+            }
+
+            // Consumer side: copies up to count items without removing them, returning how many; follow with discard()
+            uint16_t peek(T * items, uint16_t count)
+            {
+                uint16_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+                uint16_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+
+                uint16_t available = head - tail;
+
+                if (count > available) {
+                    count = available;
+                }
+
+                for (uint16_t k=0; k<count; ++k) {
+                    items[k] = _items[(uint16_t)(tail + k) & (N-1)];
+                }
+
+                return count;
+            }
+
+            // Consumer side: removes count items, which must have been peeked
+            void discard(uint16_t count)
+            {
+                uint16_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+
+                __atomic_store_n(&_tail, (uint16_t)(tail + count), __ATOMIC_RELEASE);
+            }
+
+            // Approximate when called from either side while the other is active
+            uint16_t available(void)
+            {
+                return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+            }
+
+            // Written by producer only
+            uint32_t getDropCount(void)
+            {
+                return _dropCount;
+            }
+
+    }; // class SpscRing
+
+} // namespace hf
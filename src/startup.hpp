@@ -0,0 +1,141 @@
+/*
+   Non-blocking startup sequence
+
+   Components that need time to start (LED pattern, ESC arming frames, IMU
+   bring-up) implement startupStep(), which must return quickly.  Startup steps
+   all of them on every update until each reports completion, so their waits
+   overlap instead of adding up, and reports how long each one took.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "debugger.hpp"
+#include "startupcomponent.hpp"
+
+namespace hf {
+
+    class Startup {
+
+        friend class Hackflight;
+
+        private:
+
+            static const uint8_t MAX_COMPONENTS = 8;
+
+            static constexpr float ERROR_REPORT_PERIOD = 1.0f;
+
+            StartupComponent * _components[MAX_COMPONENTS] = {NULL};
+            float _completionTimes[MAX_COMPONENTS] = {0};
+            bool  _complete[MAX_COMPONENTS] = {false};
+            uint8_t _count = 0;
+
+            float _startTime = -1;
+            float _errorReportTime = 0;
+            bool  _done = false;
+
+            void report(float time)
+            {
+                for (uint8_t k=0; k<_count; ++k) {
+                    Debugger::printf("%s started in %d msec\n", _components[k]->startupName(), 
+                            (int)(1000 * (_completionTimes[k] - _startTime)));
+                }
+
+                Debugger::printf("Ready to arm in %d msec\n", (int)(1000 * (time - _startTime)));
+            }
+
+            void reportErrors(float time)
+            {
+                if (time - _errorReportTime < ERROR_REPORT_PERIOD) {
+                    return;
+                }
+
+                for (uint8_t k=0; k<_count; ++k) {
+                    if (_components[k]->_startupError) {
+                        Debugger::printf("%s: %s\n", _components[k]->startupName(), _components[k]->_startupError);
+                    }
+                }
+
+                _errorReportTime = time;
+            }
+
+        protected:
+
+            // Lists the components that haven't started yet, with their errors
+            void reportPending(void)
+            {
+                for (uint8_t k=0; k<_count; ++k) {
+                    if (!_complete[k]) {
+                        const char * error = _components[k]->_startupError;
+                        Debugger::printf("%s has not started%s%s\n", _components[k]->startupName(), 
+                                error ? ": " : "", error ? error : "");
+                    }
+                }
+            }
+
+            void add(StartupComponent * component)
+            {
+                _complete[_count] = false;
+                _components[_count++] = component;
+                _done = false;
+            }
+
+            // Returns true once every component has started
+            bool update(float time)
+            {
+                if (done()) {
+                    return true;
+                }
+
+                if (_startTime < 0) {
+                    _startTime = time;
+                }
+
+                bool allComplete = true;
+
+                for (uint8_t k=0; k<_count; ++k) {
+
+                    if (!_complete[k] && _components[k]->startupStep(time)) {
+                        _complete[k] = true;
+                        _completionTimes[k] = time;
+                    }
+
+                    allComplete = allComplete && _complete[k];
+                }
+
+                reportErrors(time);
+
+                if (allComplete) {
+                    report(time);
+                    __atomic_store_n(&_done, true, __ATOMIC_RELEASE);
+                }
+
+                return allComplete;
+            }
+
+            // Safe to call from another core
+            bool done(void)
+            {
+                return __atomic_load_n(&_done, __ATOMIC_ACQUIRE);
+            }
+
+    }; // class Startup
+
+} // namespace hf
@@ -0,0 +1,60 @@
+/*
+   Abstract class for components that take time to start
+
+   startupStep() is called on every update until it returns true, and must
+   return quickly; see Startup.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    class StartupComponent {
+
+        friend class Startup;
+
+        private:
+
+            const char * _startupError = NULL;
+
+        protected:
+
+            // Called repeatedly until it returns true
+            virtual bool startupStep(float time)
+            {
+                (void)time;
+                return true;
+            }
+
+            virtual const char * startupName(void)
+            {
+                return "component";
+            }
+
+            // Reports an error instead of hanging; the component stays incomplete, so the vehicle can't arm
+            void startupFailed(const char * errmsg)
+            {
+                _startupError = errmsg;
+            }
+
+    }; // class StartupComponent
+
+} // namespace hf
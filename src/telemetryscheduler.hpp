@@ -0,0 +1,172 @@
+/*
+   Schedules MSP telemetry pushed to subscribers
+
+   Each subscription names a response message and the rate at which to push
+   it.  A byte budget, refilled at the port's baud rate, limits how much gets
+   pushed per serial-task tick; subscriptions take turns when it runs short.
+   Each push costs its payload plus the framing of the MSP version the
+   client last used.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace hf {
+
+    class TelemetryScheduler {
+
+        friend class SerialTask;
+
+        private:
+
+            static const uint8_t MAX_SUBSCRIPTIONS = 8;
+
+            // Unused budget carries over, up to the size of the parser's output queue
+            static constexpr float MAX_BUDGET = 256;
+
+            typedef struct {
+
+                uint8_t  messageId;
+                uint16_t payloadSize;
+                float    period;
+                float    nextTime;
+
+            } subscription_t;
+
+            subscription_t _subscriptions[MAX_SUBSCRIPTIONS];
+            uint8_t _count = 0;
+
+            // Round-robin start, so a large message can't starve the others
+            uint8_t _first = 0;
+
+            // Ten bits per byte on the line
+            float _bytesPerSecond = 0;
+
+            float _budget = 0;
+            float _lastTime = 0;
+
+            uint32_t _pushCount = 0;
+
+        protected:
+
+            void init(uint32_t baud)
+            {
+                _bytesPerSecond = baud / 10.f;
+            }
+
+            // Zero rate unsubscribes; returns false when there's no room for a new subscription
+            bool subscribe(uint8_t messageId, uint16_t payloadSize, uint16_t rate, float time)
+            {
+                for (uint8_t k=0; k<_count; ++k) {
+
+                    subscription_t & s = _subscriptions[k];
+
+                    if (s.messageId == messageId) {
+
+                        if (rate == 0) {
+                            _subscriptions[k] = _subscriptions[--_count];
+                            _first = 0;
+                        }
+                        else {
+                            s.period = 1. / rate;
+                            s.nextTime = time;
+                        }
+
+                        return true;
+                    }
+                }
+
+                if (rate == 0) {
+                    return true;
+                }
+
+                if (_count == MAX_SUBSCRIPTIONS) {
+                    return false;
+                }
+
+                subscription_t & s = _subscriptions[_count++];
+                s.messageId = messageId;
+                s.payloadSize = payloadSize;
+                s.period = 1. / rate;
+                s.nextTime = time;
+
+                return true;
+            }
+
+            // Call once per tick, before next()
+            void refill(float time)
+            {
+                if (_lastTime > 0) {
+                    _budget += (time - _lastTime) * _bytesPerSecond;
+                    if (_budget > MAX_BUDGET) {
+                        _budget = MAX_BUDGET;
+                    }
+                }
+
+                _lastTime = time;
+            }
+
+            // Returns the next due message that fits both the budget and the space available, or zero if none;
+            // overhead is the size of the frame around a payload
+            uint8_t next(float time, uint16_t space, uint8_t overhead)
+            {
+                for (uint8_t j=0; j<_count; ++j) {
+
+                    uint8_t k = (_first + j) % _count;
+
+                    subscription_t & s = _subscriptions[k];
+
+                    uint16_t size = s.payloadSize + overhead;
+
+                    if (time < s.nextTime || size > _budget || size > space) {
+                        continue;
+                    }
+
+                    // Keep the average rate, even above the tick rate, but don't try to make up for a long stall
+                    s.nextTime += s.period;
+                    if (s.nextTime < time - s.period) {
+                        s.nextTime = time;
+                    }
+
+                    _budget -= size;
+                    _first = (k + 1) % _count;
+                    _pushCount++;
+
+                    return s.messageId;
+                }
+
+                return 0;
+            }
+
+        public:
+
+            uint8_t getSubscriptionCount(void)
+            {
+                return _count;
+            }
+
+            uint32_t getPushCount(void)
+            {
+                return _pushCount;
+            }
+
+    }; // class TelemetryScheduler
+
+} // namespace hf
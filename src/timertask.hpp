@@ -32,6 +32,9 @@ namespace hf {
             float _period = 0;
             float _time = 0;
 
+            // Supports running at a fraction of the nominal rate
+            uint8_t _divisor = 1;
+
         protected:
 
             Board * _board = NULL;
@@ -49,17 +52,42 @@ namespace hf {
 
             virtual void doTask(void) = 0;
 
+            void setFrequency(float freq)
+            {
+                _period = 1 / freq;
+            }
+
+            float getFrequency(void)
+            {
+                return 1 / _period;
+            }
+
+            void setRateDivisor(uint8_t divisor)
+            {
+                _divisor = divisor;
+            }
+
         public:
 
-            void update(void)
+            // Returns true if the task ran
+            bool update(void)
             {
                 float time = _board->getTime();
 
-                if ((time - _time) > _period)
+                if ((time - _time) > _period * _divisor)
                 {
                     doTask();
                     _time = time;
+                    return true;
                 }
+
+                return false;
+            }
+
+            // Time left before the task runs again; negative if it's overdue
+            float timeUntilDue(float time)
+            {
+                return _time + _period * _divisor - time;
             }
 
     };  // TimerTask
@@ -20,7 +20,12 @@
 
 #pragma once
 
+#include <string.h>
+
 #include "timertask.hpp"
+#include "snapshot.hpp"
+#include "offboard.hpp"
+#include "blackbox.hpp"
 
 namespace hf {
 
@@ -43,6 +48,107 @@ namespace hf {
             Actuator * _actuator = NULL;
             state_t  * _state    = NULL;
 
+            // Setpoints from a companion computer, if any
+            Offboard * _offboard = NULL;
+
+            // Flight recorder, if any
+            Blackbox * _blackbox = NULL;
+
+            // Motor values requested by the GCS for when we're disarmed, if the actuator is a mixer
+            const float * _motorsDisarmed = NULL;
+
+            // Outer-loop output consumed by the rate loop when the two run on different cores.  Only the rate-loop core
+            // writes to the actuator, so cuts and disarmed motor values are passed along too.
+            typedef struct {
+                demands_t demands;
+                uint8_t   auxState;
+                bool      throttleIsDown;
+                bool      armed;
+                bool      failsafe;
+                uint32_t  cutCount;
+                float     motorsDisarmed[Actuator::MAXMOTORS];
+            } innerLoopInput_t;
+
+            bool _dualCore = false;
+
+            Snapshot<innerLoopInput_t> _innerLoopInput;
+
+            // Outer-loop core only
+            innerLoopInput_t _outerLoopOutput = {};
+
+            // Rate-loop core only
+            innerLoopInput_t _latestInnerLoopInput = {};
+            uint32_t _handledCutCount = 0;
+
+            typedef enum {
+                LOOPS_ALL,
+                LOOPS_OUTER,
+                LOOPS_INNER
+            } loops_t;
+
+            void runControllers(float time, state_t * state, demands_t & demands, uint8_t auxState, bool throttleIsDown, loops_t loops, 
+                    bool & shouldFlash)
+            {
+                for (uint8_t k=0; k<_pid_controller_count; ++k) {
+
+                    PidController * pidController = _pid_controllers[k];
+
+                    if (loops != LOOPS_ALL && pidController->isInnerLoop() != (loops == LOOPS_INNER)) {
+                        continue;
+                    }
+
+                    // Some PID controllers need to reset their integral when the throttle is down
+                    pidController->updateReceiver(throttleIsDown);
+
+                    // A reset or inactive controller can't re-use its previous output
+                    if (throttleIsDown || pidController->auxState > auxState) {
+                        pidController->_haveCache = false;
+                    }
+
+                    if (pidController->auxState <= auxState) {
+
+                        // Skips recomputation when inputs haven't changed since last time
+                        pidController->compute(state, demands, time); 
+
+                        if (pidController->shouldFlashLed()) {
+                            shouldFlash = true;
+                        }
+                    }
+                }
+            }
+
+            bool runActuator(demands_t & demands, bool armed, bool failsafe, bool throttleIsDown, const float * motorsDisarmed)
+            {
+                if (armed && !failsafe && !throttleIsDown) {
+                    _actuator->run(demands);
+                    return true;
+                }
+
+                // Support motor testing from GCS
+                if (!armed && _motorsDisarmed) {
+                    _actuator->runDisarmed(motorsDisarmed);
+                }
+
+                return false;
+            }
+
+            void publishInnerLoopInput(void)
+            {
+                _innerLoopInput.write(_outerLoopOutput);
+            }
+
+            // Offboard failsafe works like the one for a lost receiver signal
+            void checkOffboard(void)
+            {
+                if (_offboard->timedOut() && _state->armed) {
+                    cut();
+                    _state->armed = false;
+                    _state->failsafe = true;
+                    _board->showArmedStatus(false);
+                    _offboard->_timeoutCount++;
+                }
+            }
+
         protected:
 
             PidTask(void)
@@ -69,6 +175,12 @@ namespace hf {
 
             virtual void doTask(void) override
             {
+                float time = _board->getTime();
+
+                if (_offboard) {
+                    _offboard->update(time);
+                }
+
                 // Start with demands from receiver, scaling roll/pitch/yaw by constant
                 demands_t demands = {};
                 demands.throttle = _receiver->demands.throttle;
@@ -76,38 +188,113 @@ namespace hf {
                 demands.pitch    = _receiver->demands.pitch * _receiver->_demandScale;
                 demands.yaw      = _receiver->demands.yaw   * _receiver->_demandScale;
 
+                demands_t rcDemands = demands;
+
                 // Each PID controllers is associated with at least one auxiliary switch state
                 uint8_t auxState = _receiver->getAux2State();
 
                 // Some PID controllers should cause LED to flash when they're active
                 bool shouldFlash = false;
 
-                for (uint8_t k=0; k<_pid_controller_count; ++k) {
+                bool throttleIsDown = _receiver->throttleIsDown();
 
-                    PidController * pidController = _pid_controllers[k];
+                runControllers(time, _state, demands, auxState, throttleIsDown, _dualCore ? LOOPS_OUTER : LOOPS_ALL, shouldFlash);
 
-                    // Some PID controllers need to reset their integral when the throttle is down
-                    pidController->updateReceiver(_receiver->throttleIsDown());
+                // Flash LED for certain PID controllers
+                _board->flashLed(shouldFlash);
 
-                    if (pidController->auxState <= auxState) {
+                if (_offboard) {
+                    checkOffboard();
+                }
 
-                        pidController->modifyDemands(_state, demands); 
+                // On a dual-core board, hand the outer-loop demands to the rate loop on the other core
+                if (_dualCore) {
 
-                        if (pidController->shouldFlashLed()) {
-                            shouldFlash = true;
-                        }
+                    _outerLoopOutput.demands        = demands;
+                    _outerLoopOutput.auxState       = auxState;
+                    _outerLoopOutput.throttleIsDown = throttleIsDown;
+                    _outerLoopOutput.armed          = _state->armed;
+                    _outerLoopOutput.failsafe       = _state->failsafe;
+
+                    if (_motorsDisarmed) {
+                        memcpy(_outerLoopOutput.motorsDisarmed, _motorsDisarmed, sizeof(_outerLoopOutput.motorsDisarmed));
                     }
-                }
 
-                // Flash LED for certain PID controllers
-                _board->flashLed(shouldFlash);
+                    publishInnerLoopInput();
+
+                    // The recorder sees the demands handed to the rate loop, and the motor values from its last run
+                    if (_blackbox) {
+                        _blackbox->record(_board->getMicros(), _state, rcDemands, demands);
+                    }
+
+                    // Latency is measured to the handoff; the motors run at the next gyrometer reading
+                    if (_offboard) {
+                        _offboard->actuated(_board->getTime());
+                    }
+
+                    return;
+                }
 
                 // Use updated demands to run motors
-                if (_state->armed && !_state->failsafe && !_receiver->throttleIsDown()) {
-                    _actuator->run(demands);
+                bool ran = runActuator(demands, _state->armed, _state->failsafe, throttleIsDown, _motorsDisarmed);
+
+                if (_offboard && ran) {
+                    _offboard->actuated(_board->getTime());
+                }
+
+                if (_blackbox) {
+                    _blackbox->record(_board->getMicros(), _state, rcDemands, demands);
                 }
              }
 
+            void useDualCore(state_t * outerState)
+            {
+                _dualCore = true;
+                _state = outerState;
+            }
+
+            // Stops the motors.  On a dual-core board the cut is handed to the rate-loop core at once, with the throttle
+            // down so that the motors stay stopped until the outer loops publish their next demands.
+            void cut(void)
+            {
+                if (!_dualCore) {
+                    _actuator->cut();
+                    return;
+                }
+
+                _outerLoopOutput.cutCount++;
+                _outerLoopOutput.throttleIsDown = true;
+
+                publishInnerLoopInput();
+            }
+
+            // Picks up the latest outer-loop output, and carries out any cut; called on the IMU core on every update
+            void checkInnerLoopInput(void)
+            {
+                _innerLoopInput.read(_latestInnerLoopInput);
+
+                if (_latestInnerLoopInput.cutCount != _handledCutCount) {
+                    _actuator->cut();
+                    _handledCutCount = _latestInnerLoopInput.cutCount;
+                }
+            }
+
+            // Runs the rate loop on the latest outer-loop demands; called on the IMU core for each new gyrometer reading
+            void updateInnerLoop(state_t * state)
+            {
+                innerLoopInput_t & input = _latestInnerLoopInput;
+
+                state->armed = input.armed;
+                state->failsafe = input.failsafe;
+
+                demands_t demands = input.demands;
+
+                bool shouldFlash = false;
+                runControllers(_board->getTime(), state, demands, input.auxState, input.throttleIsDown, LOOPS_INNER, shouldFlash);
+
+                runActuator(demands, input.armed, input.failsafe, input.throttleIsDown, input.motorsDisarmed);
+            }
+
     };  // PidTask
 
 } // namespace hf
@@ -25,6 +25,9 @@
 #include "mspparser.hpp"
 #include "debugger.hpp"
 #include "actuators/mixer.hpp"
+#include "loadshedder.hpp"
+#include "telemetryscheduler.hpp"
+#include "offboard.hpp"
 
 namespace hf {
 
@@ -36,28 +39,142 @@ namespace hf {
 
             static constexpr float FREQ = 66;
 
+            // Independent MSP endpoints: USB, telemetry radio, companion computer
+            static const uint8_t MAX_PORTS = 3;
+
+            // Input is read from the board in blocks of up to this size
+            static const uint16_t INPUT_SIZE = 128;
+
+            // Most input bytes parsed per port per tick, so a flood can't delay the next PID update; more than a tick's worth at 115200 baud
+            static const uint16_t PARSE_BUDGET = 256;
+
+            // A frame left incomplete this long has lost bytes, as to a full receive ring; drop it so the next one parses
+            static constexpr float FRAME_TIMEOUT = 0.1;
+
             Mixer    * _mixer = NULL;
             Receiver * _receiver = NULL;
             state_t  * _state = NULL;
 
-        protected:
+            LoadShedder * _loadShedder = NULL;
 
-            // TimerTask overrides -------------------------------------------------------
+            // Receives velocity setpoints, if offboard control is in use
+            Offboard * _offboard = NULL;
 
-            virtual void doTask(void) override
+            // Each port has its own parser state, output queue, and telemetry budget; all share our handlers
+            typedef struct {
+
+                MspParser * parser;
+
+                TelemetryScheduler telemetry;
+
+                // Input read but not yet parsed, held at the front of the buffer
+                uint8_t  input[INPUT_SIZE];
+                uint16_t inputCount;
+
+                // When input last arrived
+                float inputTime;
+
+            } port_t;
+
+            port_t _ports[MAX_PORTS];
+
+            // Port 0 uses our own parser; the others get one apiece
+            MspParser _extraParsers[MAX_PORTS-1];
+
+            // Port whose input is being handled, so subscriptions go to the client that asked
+            uint8_t _currentPort = 0;
+
+            uint8_t portCount(void)
+            {
+                uint8_t count = _board->serialPortCount();
+
+                return count < MAX_PORTS ? count : MAX_PORTS;
+            }
+
+            void parseInput(uint8_t index, float time)
+            {
+                port_t & port = _ports[index];
+
+                if (port.inputCount == 0 && port.parser->frameInProgress() && time - port.inputTime > FRAME_TIMEOUT) {
+                    port.parser->resetParser();
+                }
+
+                uint16_t budget = PARSE_BUDGET;
+
+                while (true) {
+
+                    uint16_t room = INPUT_SIZE - port.inputCount;
+
+                    uint16_t count = _board->serialRead(index, &port.input[port.inputCount], room < budget ? room : budget);
+
+                    port.inputCount += count;
+                    budget -= count;
+
+                    if (count > 0) {
+                        port.inputTime = time;
+                    }
+
+                    if (port.inputCount == 0) {
+                        break;
+                    }
+
+                    uint16_t parsed = port.parser->parse(port.input, port.inputCount);
+
+                    memmove(port.input, &port.input[parsed], port.inputCount - parsed);
+                    port.inputCount -= parsed;
+
+                    // Unparsed input waits here until replies have room
+                    if (parsed == 0) {
+                        break;
+                    }
+                }
+            }
+
+            void writeOutput(uint8_t index)
             {
-                while (_board->serialAvailableBytes() > 0) {
+                MspParser * parser = _ports[index].parser;
 
-                    MspParser::parse(_board->serialReadByte());
+                while (parser->availableBytes() > 0) {
+
+                    uint16_t count = 0;
+                    const uint8_t * bytes = parser->peekOutput(count);
+
+                    _board->serialWrite(index, bytes, count);
+
+                    parser->consumeOutput(count);
                 }
+            }
+
+            void pushTelemetry(uint8_t index, float time)
+            {
+                port_t & port = _ports[index];
+
+                port.telemetry.refill(time);
+
+                while (true) {
+
+                    uint8_t messageId = port.telemetry.next(time, port.parser->outputSpace(), port.parser->frameOverhead());
+
+                    if (messageId == 0) {
+                        break;
+                    }
 
-                while (MspParser::availableBytes() > 0) {
-                    _board->serialWriteByte(MspParser::readByte());
+                    port.parser->pushResponse(messageId);
                 }
+            }
+
+        protected:
+
+            // TimerTask overrides -------------------------------------------------------
 
-                // Support motor testing from GCS
-                if (!_state->armed) {
-                    _mixer->runDisarmed();
+            virtual void doTask(void) override
+            {
+                float time = _board->getTime();
+
+                for (_currentPort=0; _currentPort<portCount(); ++_currentPort) {
+                    parseInput(_currentPort, time);
+                    pushTelemetry(_currentPort, time);
+                    writeOutput(_currentPort);
                 }
             }
 
@@ -71,7 +188,7 @@ namespace hf {
                 variometer = 0;
                 positionX = 0;
                 positionY = 0;
-                heading = -_state->rotation[AXIS_YAW]; // NB: Angle negated for remote visualization
+                heading = -_state->getRotation(AXIS_YAW); // NB: Angle negated for remote visualization
                 velocityForward = 0;
                 velocityRightward = 0;
             }
@@ -100,9 +217,39 @@ namespace hf {
 
             virtual void handle_ATTITUDE_RADIANS_Request(float & roll, float & pitch, float & yaw) override
             {
-                roll  = _state->rotation[AXIS_ROLL];
-                pitch = _state->rotation[AXIS_PITCH];
-                yaw   = _state->rotation[AXIS_YAW];
+                roll  = _state->getRotation(AXIS_ROLL);
+                pitch = _state->getRotation(AXIS_PITCH);
+                yaw   = _state->getRotation(AXIS_YAW);
+            }
+
+            virtual void handle_LOAD_SHEDDING_Request(int32_t & level, int32_t & overruns, int32_t & serialDeferrals, 
+                    int32_t & sensorSkips, int32_t & telemetryReductions) override
+            {
+                level               = _loadShedder->_level;
+                overruns            = _loadShedder->_overrunCount;
+                serialDeferrals     = _loadShedder->_serialDeferCount;
+                sensorSkips         = _loadShedder->_sensorSkipCount;
+                telemetryReductions = _loadShedder->_telemetryReduceCount;
+            }
+
+            // Refused with an error response for a bad message or rate, or when the subscription table is full
+            virtual void handle_SET_TELEMETRY_SUBSCRIPTION(int32_t messageId, int32_t rate) override
+            {
+                port_t & port = _ports[_currentPort];
+
+                int32_t payloadSize = messageId < 0 || messageId > 255 ? -1 : responsePayloadSize((uint16_t)messageId);
+
+                if (payloadSize < 0 || rate < 0 || rate > 65535 ||
+                        !port.telemetry.subscribe((uint8_t)messageId, (uint16_t)payloadSize, (uint16_t)rate, _board->getTime())) {
+                    port.parser->sendErrorResponse();
+                }
+            }
+
+            virtual void handle_SET_VELOCITY_SETPOINTS(float vx, float vy, float vz, float yaw_rate) override
+            {
+                if (_offboard) {
+                    _offboard->set(vx, vy, vz, yaw_rate, _board->getTime());
+                }
             }
 
             virtual void handle_SET_MOTOR_NORMAL(float  m1, float  m2, float  m3, float  m4) override
@@ -118,15 +265,33 @@ namespace hf {
             {
             }
 
-            void init(Board * board, state_t * state, Mixer * mixer, Receiver * receiver) 
+            void init(Board * board, state_t * state, Mixer * mixer, Receiver * receiver, LoadShedder * loadShedder) 
             {
                 TimerTask::init(board);
 
                 MspParser::init();
 
+                for (uint8_t k=0; k<MAX_PORTS; ++k) {
+
+                    MspParser * parser = this;
+
+                    if (k > 0) {
+                        parser = &_extraParsers[k-1];
+                        parser->init();
+                        parser->setHandler(this);
+                    }
+
+                    _ports[k].parser = parser;
+                    _ports[k].inputCount = 0;
+                    _ports[k].inputTime = 0;
+
+                    _ports[k].telemetry.init(board->serialBaud(k));
+                }
+
                 _state = state;
                 _mixer = mixer;
                 _receiver = receiver;
+                _loadShedder = loadShedder;
             }
 
     };  // SerialTask
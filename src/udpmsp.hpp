@@ -0,0 +1,170 @@
+/*
+   MSP over UDP, independent of the socket library
+
+   Each datagram holds a little-endian sequence number followed by one or more
+   MSP frames.  Datagrams older than the newest one are dropped whole, so the
+   latest values (e.g. from SET_RC_NORMAL) always win, and a late retransmit
+   can never stall the link the way it does over TCP.
+
+   Copyright (c) 2020 Simon D. Levy
+
+   This file is part of Hackflight.
+
+   Hackflight is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Hackflight is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with Hackflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "mspparser.hpp"
+
+namespace hf {
+
+    class UdpMsp : public MspParser {
+
+        private:
+
+            static const uint8_t HEADER_SIZE = 2;
+
+            // A datagram this far behind the newest one, or any datagram after a gap longer than GAP_TIMEOUT, means the
+            // sender restarted its count
+            static const uint16_t RESTART_WINDOW = 1024;
+
+            // Signal is lost after this long without a datagram
+            static constexpr float GAP_TIMEOUT = 0.25f;
+
+            bool     _haveSequence = false;
+            uint16_t _sequence = 0;
+            float    _lastTime = 0;
+            float    _maxGap = 0;
+
+            // Link statistics
+            uint32_t _receivedCount = 0;
+            uint32_t _lostCount = 0;     // skipped sequence numbers
+            uint32_t _staleCount = 0;    // late or duplicate, so dropped
+            uint32_t _restartCount = 0;
+            uint32_t _malformedCount = 0;
+
+        protected:
+
+            void init(void)
+            {
+                MspParser::init();
+
+                _haveSequence = false;
+                _sequence = 0;
+                _lastTime = 0;
+                _maxGap = 0;
+                _receivedCount = 0;
+                _lostCount = 0;
+                _staleCount = 0;
+                _restartCount = 0;
+                _malformedCount = 0;
+            }
+
+            // Parses the frames in a datagram, queueing any replies; returns false if the datagram was dropped
+            bool receive(const uint8_t * datagram, uint16_t size, float time)
+            {
+                if (size < HEADER_SIZE) {
+                    _malformedCount++;
+                    return false;
+                }
+
+                uint16_t sequence = datagram[0] | (datagram[1] << 8);
+
+                if (_haveSequence) {
+
+                    int32_t ahead = (int16_t)(sequence - _sequence);
+
+                    // Otherwise a sender restarted just behind its old count would be dropped as stale until failsafe
+                    bool resync = time - _lastTime > GAP_TIMEOUT;
+
+                    if (ahead <= 0 && -ahead < RESTART_WINDOW && !resync) {
+                        _staleCount++;
+                        return false;
+                    }
+
+                    if (ahead > 0) {
+                        _lostCount += ahead - 1;
+                    }
+                    else {
+                        _restartCount++;
+                    }
+
+                    if (time - _lastTime > _maxGap) {
+                        _maxGap = time - _lastTime;
+                    }
+                }
+
+                _haveSequence = true;
+                _sequence = sequence;
+                _lastTime = time;
+                _receivedCount++;
+
+                // Frames never span datagrams
+                MspParser::resetParser();
+                MspParser::parse(&datagram[HEADER_SIZE], size - HEADER_SIZE);
+
+                return true;
+            }
+
+            // Nothing is lost until the first datagram arrives
+            bool gapTimedOut(float time)
+            {
+                return _haveSequence && time - _lastTime > GAP_TIMEOUT;
+            }
+
+        public:
+
+            uint32_t getReceivedCount(void)
+            {
+                return _receivedCount;
+            }
+
+            uint32_t getLostCount(void)
+            {
+                return _lostCount;
+            }
+
+            uint32_t getStaleCount(void)
+            {
+                return _staleCount;
+            }
+
+            uint32_t getRestartCount(void)
+            {
+                return _restartCount;
+            }
+
+            uint32_t getMalformedCount(void)
+            {
+                return _malformedCount;
+            }
+
+            // Percent of datagrams sent that arrived in order
+            uint8_t getLinkQuality(void)
+            {
+                uint32_t total = _receivedCount + _lostCount;
+
+                return total ? (uint8_t)(100 * (uint64_t)_receivedCount / total) : 0;
+            }
+
+            uint32_t getMaxGapUsec(void)
+            {
+                return (uint32_t)(1e6f * _maxGap);
+            }
+
+    }; // class UdpMsp
+
+} // namespace hf